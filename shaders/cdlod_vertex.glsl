@@ -0,0 +1,74 @@
+// vertex shader for the CDLOD backend (no tessellation)
+#version 410 core
+
+layout (location = 0) in vec2 aGridPos;   // 0..CDLOD_GRID_SIZE
+
+out float heightVal;
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+uniform sampler2D heightmap;   // R8, R16 or R32F, full resolution
+uniform vec2 heightmapSize;    // In texels
+uniform vec2 heightRange;      // Texture value to height: (value - x) * y
+uniform float normalStep;      // Texel offset of the normal taps (HEIGHTMAP_STEP)
+
+// Current node (see CdlodTerrainRenderer::render)
+uniform vec2 nodeOrigin;       // Texel coordinate of grid vertex (0, 0)
+uniform float nodeScale;       // Texels per grid quad
+uniform vec2 morphRange;       // Morph start distance, 1 / morph length
+
+float sampleHeight(vec2 texel)
+{
+    texel = clamp(texel, vec2(0.0), heightmapSize - 1.0);
+    float value = textureLod(heightmap, (texel + 0.5) / heightmapSize, 0.0).r;
+    return (value - heightRange.x) * heightRange.y;
+}
+
+vec2 nodeTexel(vec2 gridPos)
+{
+    // Nodes on the far edges overhang the map; those vertices collapse onto it
+    return clamp(nodeOrigin + gridPos * nodeScale, vec2(0.0), heightmapSize - 1.0);
+}
+
+vec3 texelToWorld(vec2 texel, float height)
+{
+    // World: -30 to 30 (60x60 world), same mapping as generateTerrainMesh
+    vec2 uv = texel / (heightmapSize - 1.0);
+    return vec3(uv.x * 60.0 - 30.0, height, uv.y * 60.0 - 30.0);
+}
+
+void main()
+{
+    // Morph odd grid vertices onto their even neighbours as the camera
+    // distance approaches the end of this level's range, so the patch
+    // matches the next coarser level exactly where that level takes over
+    vec2 texel = nodeTexel(aGridPos);
+    float distanceToCamera = distance(viewPos, texelToWorld(texel, sampleHeight(texel)));
+    float morphK = clamp((distanceToCamera - morphRange.x) * morphRange.y, 0.0, 1.0);
+    vec2 gridPos = aGridPos - fract(aGridPos * 0.5) * 2.0 * morphK;
+
+    texel = nodeTexel(gridPos);
+    float height = sampleHeight(texel);
+    vec3 pos = texelToWorld(texel, height);
+
+    // Same central differences as the mesh generator at HEIGHTMAP_STEP
+    float hLeft  = sampleHeight(texel - vec2(normalStep, 0.0));
+    float hRight = sampleHeight(texel + vec2(normalStep, 0.0));
+    float hDown  = sampleHeight(texel - vec2(0.0, normalStep));
+    float hUp    = sampleHeight(texel + vec2(0.0, normalStep));
+    vec3 tangentX = vec3(2.0, hRight - hLeft, 0.0);
+    vec3 tangentZ = vec3(0.0, hUp - hDown, 2.0);
+    Normal = normalize(cross(tangentZ, tangentX));
+
+    FragPos = pos;
+    TexCoord = texel / (heightmapSize - 1.0);
+    gl_Position = projection * view * vec4(pos, 1.0);
+
+    // Pass normalized height (0-1) to fragment shader, as tess_eval.glsl does
+    heightVal = pos.y / 2.5;
+}
@@ -0,0 +1,96 @@
+// vertex shader for the geometry clipmap backend (no tessellation)
+#version 410 core
+
+layout (location = 0) in vec2 aGridPos;   // 0..CLIPMAP_GRID_SIZE
+
+out float heightVal;
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+// One toroidally addressed layer per level; level texel (x, z) lives at
+// (x, z) modulo the texture size
+uniform sampler2DArray heightLevels;
+uniform vec2 heightmapSize;    // Full heightmap, in texels
+uniform vec2 heightRange;      // Texture value to height: (value - x) * y
+uniform float normalStep;      // HEIGHTMAP_STEP, keeps shading in line with the mesh path
+uniform int gridSize;
+uniform float blendWidth;
+
+// Current level (see ClipmapTerrainRenderer::render)
+uniform int level;
+uniform int levelOriginX;      // Level texel of grid vertex (0, 0)
+uniform int levelOriginZ;
+uniform float levelSpacing;    // Heightmap texels per level texel
+uniform int blendToCoarser;
+
+float fetchHeight(ivec2 levelTexel, int layer)
+{
+    ivec2 wrapped = levelTexel & (textureSize(heightLevels, 0).xy - 1);
+    float value = texelFetch(heightLevels, ivec3(wrapped, layer), 0).r;
+    return (value - heightRange.x) * heightRange.y;
+}
+
+void main()
+{
+    ivec2 grid = ivec2(aGridPos);
+    ivec2 levelTexel = ivec2(levelOriginX, levelOriginZ) + grid;
+    float height = fetchHeight(levelTexel, level);
+
+    // Central differences over one level texel, scaled so slopes shade the
+    // same as the mesh generator's normals at HEIGHTMAP_STEP
+    float hLeft  = fetchHeight(levelTexel - ivec2(1, 0), level);
+    float hRight = fetchHeight(levelTexel + ivec2(1, 0), level);
+    float hDown  = fetchHeight(levelTexel - ivec2(0, 1), level);
+    float hUp    = fetchHeight(levelTexel + ivec2(0, 1), level);
+    float run = 2.0 * levelSpacing / normalStep;
+    vec3 tangentX = vec3(run, hRight - hLeft, 0.0);
+    vec3 tangentZ = vec3(0.0, hUp - hDown, run);
+    Normal = normalize(cross(tangentZ, tangentX));
+
+    // Blend towards the coarser level across the outer band, reaching it
+    // exactly on the edge so the two levels meet without cracks. Edge
+    // vertices sit on even level texels along the edge, so the coarse
+    // height there is one sample or the average of two.
+    if (blendToCoarser != 0)
+    {
+        ivec2 edgeDistance = min(grid, ivec2(gridSize) - grid);
+        float alpha = clamp((blendWidth - float(min(edgeDistance.x, edgeDistance.y))) / blendWidth,
+                            0.0, 1.0);
+        if (alpha > 0.0)
+        {
+            ivec2 coarse = levelTexel >> 1;
+            ivec2 odd = levelTexel & 1;
+            float coarseHeight;
+            if (odd.x == 1 && odd.y == 1)
+            {
+                // Quad centre: on the coarse top-right to bottom-left diagonal
+                coarseHeight = 0.5 * (fetchHeight(coarse + ivec2(1, 0), level + 1) +
+                                      fetchHeight(coarse + ivec2(0, 1), level + 1));
+            }
+            else
+            {
+                coarseHeight = 0.5 * (fetchHeight(coarse, level + 1) +
+                                      fetchHeight(coarse + odd, level + 1));
+            }
+            height = mix(height, coarseHeight, alpha);
+        }
+    }
+
+    // World: -30 to 30 (60x60 world), same mapping as generateTerrainMesh.
+    // Vertices past the map edge collapse onto it.
+    vec2 texel = clamp(vec2(levelTexel) * levelSpacing, vec2(0.0), heightmapSize - 1.0);
+    vec2 uv = texel / (heightmapSize - 1.0);
+    vec3 pos = vec3(uv.x * 60.0 - 30.0, height, uv.y * 60.0 - 30.0);
+
+    FragPos = pos;
+    TexCoord = uv;
+    gl_Position = projection * view * vec4(pos, 1.0);
+
+    // Pass normalized height (0-1) to fragment shader, as tess_eval.glsl does
+    heightVal = pos.y / 2.5;
+}
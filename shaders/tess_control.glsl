@@ -12,17 +12,71 @@ out vec3 tcNormal[];
 out vec2 tcTexCoord[];
 
 uniform vec3 viewPos;
+uniform mat4 projection;
 uniform float minTessLevel = 1.0;
 uniform float maxTessLevel = 8.0;
 uniform float minDistance = 2.0;   // Adjusted for 60x60 map
 uniform float maxDistance = 50.0;  // Adjusted for 60x60 map
 
+// Patch culling: frustum planes in model space (normals pointing inward),
+// padded by the largest displacement tess_eval.glsl can add
+uniform bool patchCulling = true;
+uniform vec4 frustumPlanes[6];
+uniform float displacementBound = 0.01;
+
+bool patchOutsideFrustum()
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        vec4 plane = frustumPlanes[p];
+        if (dot(plane, vec4(vPos[0], 1.0)) < -displacementBound &&
+            dot(plane, vec4(vPos[1], 1.0)) < -displacementBound &&
+            dot(plane, vec4(vPos[2], 1.0)) < -displacementBound)
+            return true;
+    }
+    return false;
+}
+
+// Backface/horizon test. The terrain is a heightfield seen from above, so a
+// triangle facing away from the camera sits behind a slope that faces it.
+// Degenerate patches (chunk padding) have no area and are dropped as well.
+bool patchFacingAway()
+{
+    vec3 faceNormal = cross(vPos[1] - vPos[0], vPos[2] - vPos[0]);
+    float area = length(faceNormal);
+    if (area == 0.0)
+        return true;
+
+    // Margin covers the slight tilt the displacement can add
+    float eyeDistance = dot(faceNormal / area, viewPos - vPos[0]);
+    return eyeDistance < -2.0 * displacementBound;
+}
+
+// Tessellation mode: 0 = distance ramp between minDistance and maxDistance,
+// 1 = screen-space edge length
+uniform int tessMode = 1;
+uniform vec2 viewportSize = vec2(800.0, 600.0);   // Framebuffer size in pixels
+uniform float targetPixelsPerEdge = 8.0;
+uniform float maxScreenTessLevel = 64.0;
+
 float calcTessLevel(vec3 p0, vec3 p1)
 {
     // Calculate distance from camera to edge midpoint
     vec3 midpoint = (p0 + p1) * 0.5;
     float distance = length(viewPos - midpoint);
     
+    if (tessMode == 1)
+    {
+        // Project the edge's bounding sphere: its diameter in pixels is
+        // diameter * focal length / distance, with the focal length in
+        // pixels taken from the projection. Only the edge itself is used,
+        // so both patches sharing an edge agree and no cracks appear.
+        float diameter = length(p1 - p0);
+        float focalPixels = projection[1][1] * 0.5 * viewportSize.y;
+        float edgePixels = diameter * focalPixels / max(distance, 1e-4);
+        return clamp(edgePixels / targetPixelsPerEdge, minTessLevel, maxScreenTessLevel);
+    }
+    
     // Map distance to tessellation level
     float t = clamp((distance - minDistance) / (maxDistance - minDistance), 0.0, 1.0);
     float tessLevel = mix(maxTessLevel, minTessLevel, t);
@@ -40,6 +94,16 @@ void main()
     // Only first invocation per patch sets tessellation levels
     if (gl_InvocationID == 0)
     {
+        // Zero outer levels discard the patch before the tessellator runs
+        if (patchCulling && (patchOutsideFrustum() || patchFacingAway()))
+        {
+            gl_TessLevelOuter[0] = 0.0;
+            gl_TessLevelOuter[1] = 0.0;
+            gl_TessLevelOuter[2] = 0.0;
+            gl_TessLevelInner[0] = 0.0;
+            return;
+        }
+
         // Outer tessellation levels (edges of triangle)
         gl_TessLevelOuter[0] = calcTessLevel(vPos[1], vPos[2]);
         gl_TessLevelOuter[1] = calcTessLevel(vPos[2], vPos[0]);
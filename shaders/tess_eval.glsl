@@ -16,6 +16,21 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Displaced grid backend: heights and normals come from the height texture
+// at every tessellated vertex instead of from the patch corners
+uniform bool displaceFromTexture = false;
+uniform sampler2D heightmap;
+uniform vec2 heightmapSize;
+uniform vec2 heightRange;
+uniform float normalStep;
+
+float sampleHeight(vec2 texel)
+{
+    texel = clamp(texel, vec2(0.0), heightmapSize - 1.0);
+    float value = textureLod(heightmap, (texel + 0.5) / heightmapSize, 0.0).r;
+    return (value - heightRange.x) * heightRange.y;
+}
+
 // Simple noise function for displacement detail
 float hash(vec2 p)
 {
@@ -67,6 +82,24 @@ void main()
     vec2 uv1 = gl_TessCoord.y * tcTexCoord[1];
     vec2 uv2 = gl_TessCoord.z * tcTexCoord[2];
     TexCoord = uv0 + uv1 + uv2;
+
+    // Interpolate normal using barycentric coordinates
+    vec3 n0 = gl_TessCoord.x * tcNormal[0];
+    vec3 n1 = gl_TessCoord.y * tcNormal[1];
+    vec3 n2 = gl_TessCoord.z * tcNormal[2];
+    vec3 normal = normalize(n0 + n1 + n2);
+
+    if (displaceFromTexture)
+    {
+        // Same taps as vertex_displaced.glsl, at the tessellated vertex
+        vec2 texel = TexCoord * (heightmapSize - 1.0);
+        pos.y = sampleHeight(texel);
+        float hLeft  = sampleHeight(texel - vec2(normalStep, 0.0));
+        float hRight = sampleHeight(texel + vec2(normalStep, 0.0));
+        float hDown  = sampleHeight(texel - vec2(0.0, normalStep));
+        float hUp    = sampleHeight(texel + vec2(0.0, normalStep));
+        normal = normalize(cross(vec3(0.0, hUp - hDown, 2.0), vec3(2.0, hRight - hLeft, 0.0)));
+    }
     
     // Add procedural displacement for terrain detail
     float detailScale = 12.0; // Reduced for less detail
@@ -79,12 +112,6 @@ void main()
     // Add subtle vertical displacement - reduced for less spikiness
     pos.y += detailNoise * 0.01 * displacementAmount; // Reduced from 0.015
     
-    // Interpolate normal using barycentric coordinates
-    vec3 n0 = gl_TessCoord.x * tcNormal[0];
-    vec3 n1 = gl_TessCoord.y * tcNormal[1];
-    vec3 n2 = gl_TessCoord.z * tcNormal[2];
-    vec3 normal = normalize(n0 + n1 + n2);
-    
     // Transform to world space
     vec4 worldPos = model * vec4(pos, 1.0);
     FragPos = worldPos.xyz;
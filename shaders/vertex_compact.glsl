@@ -0,0 +1,42 @@
+// vertex shader for the compact 8-byte vertex format (tessellation pipeline)
+#version 410 core
+
+layout (location = 0) in float aHeight;      // R16 unorm, 0-1
+layout (location = 1) in vec2 aOctNormal;    // snorm16 pair, unnormalized
+
+out vec3 vPos;
+out vec3 vNormal;
+out vec2 vTexCoord;
+
+uniform int gridWidth;
+uniform int gridHeight;
+uniform float heightScale;
+
+// Current chunk (see TerrainChunk); chunk rows have a fixed 256-vertex stride
+uniform int chunkOriginX;
+uniform int chunkOriginZ;
+uniform int chunkBaseVertex;
+
+vec3 decodeOctNormal(vec2 e)
+{
+    // Octahedral encoding around +Y, lower hemisphere folded over the diagonals
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    if (n.y < 0.0)
+        n.xz = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    // Recover the grid coordinate from the vertex index. gl_VertexID includes
+    // the draw's base vertex. Padding columns clamp to the last grid column.
+    int local = gl_VertexID - chunkBaseVertex;
+    int i = min(chunkOriginX + (local & 255), gridWidth - 1);
+    int j = chunkOriginZ + (local >> 8);
+    vec2 uv = vec2(float(i) / float(gridWidth - 1), float(j) / float(gridHeight - 1));
+
+    // World: -30 to 30 (60x60 world), same mapping as generateTerrainMesh
+    vPos = vec3(uv.x * 60.0 - 30.0, aHeight * heightScale, uv.y * 60.0 - 30.0);
+    vNormal = decodeOctNormal(aOctNormal / 32767.0);
+    vTexCoord = uv;
+}
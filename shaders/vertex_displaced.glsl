@@ -0,0 +1,47 @@
+// vertex shader for the displaced grid (tessellation pipeline, no vertex buffer)
+#version 410 core
+
+out vec3 vPos;
+out vec3 vNormal;
+out vec2 vTexCoord;
+
+uniform int gridWidth;
+uniform int gridHeight;
+
+// Current chunk; chunk rows have a fixed 256-vertex stride, as in the mesh
+uniform int chunkOriginX;
+uniform int chunkOriginZ;
+
+uniform sampler2D heightmap;   // R8, R16 or R32F, full resolution
+uniform vec2 heightmapSize;    // In texels
+uniform vec2 heightRange;      // Texture value to height: (value - x) * y
+uniform float normalStep;      // Texel offset of the normal taps
+
+float sampleHeight(vec2 texel)
+{
+    texel = clamp(texel, vec2(0.0), heightmapSize - 1.0);
+    float value = textureLod(heightmap, (texel + 0.5) / heightmapSize, 0.0).r;
+    return (value - heightRange.x) * heightRange.y;
+}
+
+void main()
+{
+    // Recover the grid coordinate from the vertex index. Padding columns
+    // clamp to the last grid column.
+    int i = min(chunkOriginX + (gl_VertexID & 255), gridWidth - 1);
+    int j = chunkOriginZ + (gl_VertexID >> 8);
+    vec2 uv = vec2(float(i) / float(gridWidth - 1), float(j) / float(gridHeight - 1));
+    vec2 texel = uv * (heightmapSize - 1.0);
+
+    // World: -30 to 30 (60x60 world). The grid spans the whole texture, as
+    // in the CDLOD backend and collision, so vertices may fall between texels.
+    vPos = vec3(uv.x * 60.0 - 30.0, sampleHeight(texel), uv.y * 60.0 - 30.0);
+
+    // Same central differences as the mesh generator at HEIGHTMAP_STEP
+    float hLeft  = sampleHeight(texel - vec2(normalStep, 0.0));
+    float hRight = sampleHeight(texel + vec2(normalStep, 0.0));
+    float hDown  = sampleHeight(texel - vec2(0.0, normalStep));
+    float hUp    = sampleHeight(texel + vec2(0.0, normalStep));
+    vNormal = normalize(cross(vec3(0.0, hUp - hDown, 2.0), vec3(2.0, hRight - hLeft, 0.0)));
+    vTexCoord = uv;
+}
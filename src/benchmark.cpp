@@ -0,0 +1,1243 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <stb_image.h>
+
+#include "collision_grid.h"
+#include "frustum_culling.h"
+#include "heightmap.h"
+#include "process_memory.h"
+#include "sample_rows.h"
+#include "terrain_cache.h"
+#include "terrain_collision.h"
+#include "terrain_mesh.h"
+#include "terrain_normals.h"
+#include "terrain_raycast.h"
+#include "thread_pool.h"
+#include "tile_streamer.h"
+#include "tiled_heightmap.h"
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+double elapsedMs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// Checks that the chunked mesh holds exactly the reference vertices and
+// triangles once chunk-local indices are mapped back to grid vertices
+bool meshMatchesReference(const TerrainMesh& mesh, const ReferenceTerrainMesh& reference)
+{
+    if (mesh.gridWidth != reference.gridWidth || mesh.gridHeight != reference.gridHeight ||
+        mesh.triangleCount() * 3 != reference.indices.size())
+        return false;
+
+    for (int j = 0; j < mesh.gridHeight; ++j)
+    {
+        for (int i = 0; i < mesh.gridWidth; ++i)
+        {
+            const TerrainVertex& a = mesh.vertices[mesh.vertexIndex(i, j)];
+            const TerrainVertex& b = reference.vertices[static_cast<size_t>(j) * mesh.gridWidth + i];
+            if (std::memcmp(&a, &b, sizeof(TerrainVertex)) != 0)
+                return false;
+        }
+    }
+
+    for (const TerrainChunk& chunk : mesh.chunks)
+    {
+        for (int qj = 0; qj < chunk.quadsZ; ++qj)
+        {
+            for (int qi = 0; qi < chunk.quadsX; ++qi)
+            {
+                size_t quad = static_cast<size_t>(qj) * TERRAIN_CHUNK_QUADS + qi;
+                size_t refQuad = static_cast<size_t>(chunk.originZ + qj) * (mesh.gridWidth - 1) +
+                                 (chunk.originX + qi);
+                for (int k = 0; k < 6; ++k)
+                {
+                    int local = mesh.indices[quad * 6 + k];
+                    int i = chunk.originX + local % TERRAIN_CHUNK_SIZE;
+                    int j = chunk.originZ + local / TERRAIN_CHUNK_SIZE;
+                    if (static_cast<unsigned int>(j * mesh.gridWidth + i) != reference.indices[refQuad * 6 + k])
+                        return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// MESH GENERATION SCALING
+// ============================================================================
+
+// Mesh generation runs at full resolution, the case that stalls startup
+const int BENCH_STEP = 1;
+
+void benchMeshGeneration(const unsigned char* data, int width, int height,
+                         const ReferenceTerrainMesh& reference, double serialMs)
+{
+    const int repeats = 3;
+
+    std::cout << "\n[Mesh generation] " << width << " x " << height
+              << " heightmap, step " << BENCH_STEP << "\n";
+    std::cout << "  serial reference: " << std::fixed << std::setprecision(1)
+              << serialMs << " ms\n";
+
+    unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int t = 1; t < maxThreads; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    double oneThreadMs = 0.0;
+    for (unsigned int threads : threadCounts)
+    {
+        ThreadPool pool(threads);
+        double bestMs = 0.0;
+        bool identical = true;
+        for (int r = 0; r < repeats; ++r)
+        {
+            auto start = BenchClock::now();
+            TerrainMesh mesh = generateTerrainMesh(data, width, height, BENCH_STEP,
+                                                   TerrainVertexFormat::Full, pool);
+            double ms = elapsedMs(start);
+            if (r == 0 || ms < bestMs)
+                bestMs = ms;
+            identical = identical && meshMatchesReference(mesh, reference);
+        }
+        if (threads == 1)
+            oneThreadMs = bestMs;
+
+        std::cout << "  threads " << std::setw(3) << threads << ": "
+                  << std::setw(8) << bestMs << " ms  speedup x"
+                  << std::setprecision(2) << oneThreadMs / bestMs
+                  << std::setprecision(1)
+                  << (identical ? "  (bit-identical)" : "  (MISMATCH)") << "\n";
+    }
+}
+
+// ============================================================================
+// NORMAL KERNELS
+// ============================================================================
+
+// Times each normal kernel over the whole reference grid and compares its
+// output against the glm normals of the serial generator
+void benchNormalKernels(const ReferenceTerrainMesh& reference)
+{
+    const int repeats = 5;
+    const int width = reference.gridWidth;
+    const int height = reference.gridHeight;
+    const size_t count = reference.vertices.size();
+
+    std::vector<float> heights(count);
+    for (size_t v = 0; v < count; ++v)
+        heights[v] = reference.vertices[v].position.y;
+
+    std::vector<float> normalX(count), normalY(count), normalZ(count);
+
+    std::cout << "\n[Normal kernels] " << width << " x " << height
+              << " grid, active kernel: " << normalKernelName(activeNormalKernel()) << "\n";
+
+    for (NormalKernel kernel : { NormalKernel::Scalar, NormalKernel::SSE42, NormalKernel::AVX2 })
+    {
+        if (!normalKernelSupported(kernel))
+        {
+            std::cout << "  " << std::setw(7) << normalKernelName(kernel) << ": not supported\n";
+            continue;
+        }
+
+        double bestMs = 0.0;
+        for (int r = 0; r < repeats; ++r)
+        {
+            auto start = BenchClock::now();
+            for (int j = 0; j < height; ++j)
+            {
+                const float* rowHere = &heights[static_cast<size_t>(j) * width];
+                const float* rowDown = j > 0 ? rowHere - width : rowHere;
+                const float* rowUp = j < height - 1 ? rowHere + width : rowHere;
+                size_t offset = static_cast<size_t>(j) * width;
+                computeNormalRowWith(kernel, rowDown, rowHere, rowUp, width,
+                                     &normalX[offset], &normalY[offset], &normalZ[offset]);
+            }
+            double ms = elapsedMs(start);
+            if (r == 0 || ms < bestMs)
+                bestMs = ms;
+        }
+
+        float maxError = 0.0f;
+        size_t mismatches = 0;
+        for (size_t v = 0; v < count; ++v)
+        {
+            glm::vec3 expected = reference.vertices[v].normal;
+            glm::vec3 actual(normalX[v], normalY[v], normalZ[v]);
+            glm::vec3 diff = glm::abs(actual - expected);
+            maxError = std::max(maxError, std::max(diff.x, std::max(diff.y, diff.z)));
+            if (std::memcmp(&actual, &expected, sizeof(glm::vec3)) != 0)
+                ++mismatches;
+        }
+
+        std::cout << "  " << std::setw(7) << normalKernelName(kernel) << ": "
+                  << std::setw(8) << std::setprecision(2) << bestMs << " ms  "
+                  << std::setw(8) << std::setprecision(1) << count / (bestMs * 1000.0)
+                  << " Mvert/s  max error " << std::scientific << maxError << std::fixed
+                  << ", " << mismatches << " inexact\n";
+    }
+}
+
+// ============================================================================
+// SAMPLE CONVERSION
+// ============================================================================
+
+// Times each sample kernel converting every row of one sample type to
+// heights, unit stride and at HEIGHTMAP_STEP, and compares against scalar
+template <typename Sample>
+void benchSampleType(const char* label, const std::vector<Sample>& samples, int width, int height)
+{
+    const int repeats = 5;
+    const SampleRange range = defaultSampleRange(HeightmapSampleTraits<Sample>::format);
+
+    for (int stride : { 1, HEIGHTMAP_STEP })
+    {
+        const int count = (width + stride - 1) / stride;
+        const size_t total = static_cast<size_t>(count) * height;
+        std::vector<float> expected(total), actual(total);
+        for (int j = 0; j < height; ++j)
+            convertSampleRowWith(SampleKernel::Scalar, &samples[static_cast<size_t>(j) * width],
+                                 stride, count, range, HEIGHT_SCALE,
+                                 &expected[static_cast<size_t>(j) * count]);
+
+        std::cout << "  " << std::setw(5) << label << ", stride " << stride << ":";
+        for (SampleKernel kernel : { SampleKernel::Scalar, SampleKernel::SSE42, SampleKernel::AVX2 })
+        {
+            if (!sampleKernelSupported(kernel))
+                continue;
+
+            double bestMs = 0.0;
+            for (int r = 0; r < repeats; ++r)
+            {
+                auto start = BenchClock::now();
+                for (int j = 0; j < height; ++j)
+                    convertSampleRowWith(kernel, &samples[static_cast<size_t>(j) * width],
+                                         stride, count, range, HEIGHT_SCALE,
+                                         &actual[static_cast<size_t>(j) * count]);
+                double ms = elapsedMs(start);
+                if (r == 0 || ms < bestMs)
+                    bestMs = ms;
+            }
+
+            bool exact = std::memcmp(expected.data(), actual.data(), total * sizeof(float)) == 0;
+            std::cout << "  " << sampleKernelName(kernel) << " " << std::setprecision(2)
+                      << bestMs << " ms" << (exact ? "" : " (inexact)");
+        }
+        std::cout << "\n";
+    }
+}
+
+// Same heights stored at 8, 16 and 32 bits
+void benchSampleKernels(const unsigned char* data, int width, int height)
+{
+    const size_t count = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> samples8(data, data + count);
+    std::vector<uint16_t> samples16(count);
+    std::vector<float> samples32(count);
+    for (size_t s = 0; s < count; ++s)
+    {
+        samples16[s] = static_cast<uint16_t>(data[s] * 257);
+        samples32[s] = data[s] / 255.0f;
+    }
+
+    std::cout << "\n[Sample conversion] " << width << " x " << height
+              << ", active kernel: " << sampleKernelName(activeSampleKernel()) << "\n";
+    benchSampleType("u8", samples8, width, height);
+    benchSampleType("u16", samples16, width, height);
+    benchSampleType("f32", samples32, width, height);
+}
+
+// ============================================================================
+// FRUSTUM CULLING
+// ============================================================================
+
+// Culls 100k random chunk boxes spread over a large map with each kernel
+void benchFrustumCulling()
+{
+    const size_t boxCount = 100000;
+    const int repeats = 20;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> height(0.0f, 3.0f);
+
+    AabbSoA boxes;
+    for (size_t b = 0; b < boxCount; ++b)
+    {
+        glm::vec3 corner(position(rng), 0.0f, position(rng));
+        float top = height(rng);
+        boxes.push(glm::vec3(corner.x, top * 0.5f, corner.z),
+                   glm::vec3(corner.x + 2.0f, top, corner.z + 2.0f));
+    }
+
+    // Same projection as the renderer, looking across the map
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 20.0f),
+                                 glm::vec3(0.0f, 7.0f, 10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 180.0f);
+    Frustum frustum = extractFrustum(projection * view);
+
+    std::cout << "\n[Frustum culling] " << boxCount << " chunk AABBs, active kernel: "
+              << cullKernelName(activeCullKernel()) << "\n";
+
+    std::vector<uint32_t> reference;
+    cullAabbsWith(CullKernel::Scalar, frustum, boxes, reference);
+
+    std::vector<uint32_t> visible;
+    visible.reserve(boxCount);
+    for (CullKernel kernel : { CullKernel::Scalar, CullKernel::SSE42, CullKernel::AVX2 })
+    {
+        if (!cullKernelSupported(kernel))
+        {
+            std::cout << "  " << std::setw(7) << cullKernelName(kernel) << ": not supported\n";
+            continue;
+        }
+
+        double bestMs = 0.0;
+        for (int r = 0; r < repeats; ++r)
+        {
+            visible.clear();
+            auto start = BenchClock::now();
+            cullAabbsWith(kernel, frustum, boxes, visible);
+            double ms = elapsedMs(start);
+            if (r == 0 || ms < bestMs)
+                bestMs = ms;
+        }
+
+        std::cout << "  " << std::setw(7) << cullKernelName(kernel) << ": "
+                  << std::setw(8) << std::setprecision(3) << bestMs << " ms  "
+                  << std::setw(6) << std::setprecision(2) << bestMs * 1.0e6 / boxCount
+                  << " ns/box  visible " << visible.size() << " / " << boxCount
+                  << (visible == reference ? "" : "  (MISMATCH vs scalar)") << "\n";
+    }
+}
+
+// ============================================================================
+// HEIGHTMAP LOADING
+// ============================================================================
+
+// Startup path (load + mesh at HEIGHTMAP_STEP) for the source image against
+// the same heights written out as a memory-mapped .r16 file
+void benchHeightmapLoading(const char* heightmapPath, const unsigned char* data,
+                           int width, int height)
+{
+    const int repeats = 3;
+
+    // 8-bit heights widened to 16 bits (x257 maps 255 to 65535), so both
+    // paths build the same terrain
+    std::string rawPath = std::string(heightmapPath) + ".bench.r16";
+    {
+        std::vector<uint16_t> samples(static_cast<size_t>(width) * height);
+        for (size_t s = 0; s < samples.size(); ++s)
+            samples[s] = static_cast<uint16_t>(data[s] * 257);
+        std::ofstream raw(rawPath, std::ios::binary);
+        raw.write(reinterpret_cast<const char*>(samples.data()),
+                  static_cast<std::streamsize>(samples.size() * sizeof(uint16_t)));
+        std::ofstream sidecar(rawPath + ".hdr");
+        sidecar << "width = " << width << "\nheight = " << height << "\n";
+        if (!raw || !sidecar)
+        {
+            std::cout << "\n[Heightmap loading] cannot write " << rawPath << ", skipped\n";
+            return;
+        }
+    }
+
+    std::cout << "\n[Heightmap loading] " << width << " x " << height
+              << ", load + mesh at step " << HEIGHTMAP_STEP << " (best of " << repeats << ")\n";
+
+    ThreadPool pool;
+    for (const std::string& path : { std::string(heightmapPath), rawPath })
+    {
+        double bestLoadMs = 0.0, bestTotalMs = 0.0;
+        bool mapped = false;
+        for (int r = 0; r < repeats; ++r)
+        {
+            auto start = BenchClock::now();
+            Heightmap heightmap = Heightmap::load(path.c_str());
+            double loadMs = elapsedMs(start);
+            if (!heightmap.isValid())
+            {
+                std::cout << "  " << path << ": " << heightmap.error() << "\n";
+                break;
+            }
+            TerrainMesh mesh = generateTerrainMesh(heightmap.view(), HEIGHTMAP_STEP,
+                                                   TerrainVertexFormat::Compact, pool);
+            double totalMs = elapsedMs(start);
+            mapped = heightmap.isMapped();
+            if (r == 0 || loadMs < bestLoadMs)
+                bestLoadMs = loadMs;
+            if (r == 0 || totalMs < bestTotalMs)
+                bestTotalMs = totalMs;
+        }
+
+        std::cout << "  " << std::setw(6) << (mapped ? "r16" : "image") << ": load "
+                  << std::setw(8) << std::setprecision(2) << bestLoadMs << " ms, load + mesh "
+                  << std::setw(8) << bestTotalMs << " ms"
+                  << (mapped ? "  (memory-mapped)" : "  (stb_image decode)") << "\n";
+    }
+
+    std::remove((rawPath + ".hdr").c_str());
+    std::remove(rawPath.c_str());
+}
+
+// Full decode + mesh at HEIGHTMAP_STEP against streaming the map through
+// each downsample filter + mesh at step 1
+void benchDownsampledLoading(const char* heightmapPath)
+{
+    const int repeats = 3;
+    ThreadPool pool;
+
+    std::cout << "\n[Downsampled loading] step " << HEIGHTMAP_STEP
+              << ", load + mesh (best of " << repeats << ")\n";
+
+    struct Variant
+    {
+        const char* name;
+        bool streamed;
+        DownsampleFilter filter;
+    };
+    const Variant variants[] = {
+        { "full", false, DownsampleFilter::Point },
+        { "point", true, DownsampleFilter::Point },
+        { "box", true, DownsampleFilter::Box },
+        { "max", true, DownsampleFilter::Max },
+    };
+
+    for (const Variant& variant : variants)
+    {
+        double bestMs = 0.0;
+        size_t peakBytes = 0;
+        for (int r = 0; r < repeats; ++r)
+        {
+            auto start = BenchClock::now();
+            Heightmap heightmap = variant.streamed
+                ? Heightmap::loadDownsampled(heightmapPath, HEIGHTMAP_STEP, variant.filter)
+                : Heightmap::load(heightmapPath);
+            if (!heightmap.isValid())
+            {
+                std::cout << "  " << variant.name << ": " << heightmap.error() << "\n";
+                return;
+            }
+            TerrainMesh mesh = generateTerrainMesh(heightmap.view(),
+                                                   variant.streamed ? 1 : HEIGHTMAP_STEP,
+                                                   TerrainVertexFormat::Compact, pool);
+            double ms = elapsedMs(start);
+            peakBytes = heightmap.peakLoadBytes();
+            if (r == 0 || ms < bestMs)
+                bestMs = ms;
+        }
+
+        std::cout << "  " << std::setw(6) << variant.name << ": " << std::setw(8)
+                  << std::setprecision(2) << bestMs << " ms, loader peak "
+                  << std::setw(8) << peakBytes / 1024.0 << " KB"
+                  << (variant.streamed ? "" : "  (whole image decoded)") << "\n";
+    }
+}
+
+// ============================================================================
+// BAKED TERRAIN CACHE
+// ============================================================================
+
+// Cold start (stream + downsample + mesh + bake) against a warm start (hash
+// the heightmap + map the cache). The warm path also copies the vertex and
+// index blobs once, standing in for glBufferData, so pages really are read.
+void benchTerrainCache(const char* heightmapPath)
+{
+    const int repeats = 3;
+    const std::string cacheDir = std::string(heightmapPath) + ".bench-cache";
+    ThreadPool pool;
+
+    std::cout << "\n[Terrain cache] mesh backend startup (best of " << repeats << ")\n";
+
+    TerrainCacheKey key;
+    if (!terrainCacheKey(heightmapPath, TerrainVertexFormat::Compact, DownsampleFilter::Box, key))
+    {
+        std::cout << "  cannot read " << heightmapPath << ", skipped\n";
+        return;
+    }
+    const std::string cachePath = terrainCachePath(cacheDir, key);
+
+    double bestColdMs = 0.0;
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto start = BenchClock::now();
+        Heightmap heightmap = Heightmap::loadDownsampled(heightmapPath, HEIGHTMAP_STEP,
+                                                         DownsampleFilter::Box);
+        if (!heightmap.isValid())
+        {
+            std::cout << "  " << heightmap.error() << "\n";
+            return;
+        }
+        TerrainMesh mesh = generateTerrainMesh(heightmap.view(), 1, TerrainVertexFormat::Compact, pool);
+        std::string error;
+        if (!writeTerrainCache(cachePath, key, mesh, heightmap.view(), error))
+        {
+            std::cout << "  " << error << ", skipped\n";
+            return;
+        }
+        double ms = elapsedMs(start);
+        if (r == 0 || ms < bestColdMs)
+            bestColdMs = ms;
+    }
+
+    double bestWarmMs = 0.0, bestHashMs = 0.0;
+    size_t fileBytes = 0;
+    std::vector<unsigned char> upload;
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto start = BenchClock::now();
+        TerrainCacheKey warmKey;
+        terrainCacheKey(heightmapPath, TerrainVertexFormat::Compact, DownsampleFilter::Box, warmKey);
+        double hashMs = elapsedMs(start);
+        TerrainCache cache;
+        if (!cache.open(terrainCachePath(cacheDir, warmKey), warmKey))
+        {
+            std::cout << "  cache did not reopen, skipped\n";
+            break;
+        }
+        const TerrainMeshBuffers& buffers = cache.buffers();
+        const unsigned char* vertices = static_cast<const unsigned char*>(buffers.vertexData);
+        const unsigned char* indices = reinterpret_cast<const unsigned char*>(buffers.indices);
+        upload.assign(vertices, vertices + buffers.vertexBytes);
+        upload.insert(upload.end(), indices, indices + buffers.indexCount * sizeof(uint16_t));
+        double ms = elapsedMs(start);
+        fileBytes = cache.fileBytes();
+        if (r == 0 || ms < bestWarmMs)
+            bestWarmMs = ms;
+        if (r == 0 || hashMs < bestHashMs)
+            bestHashMs = hashMs;
+    }
+
+    std::cout << "  cold: " << std::setw(8) << std::setprecision(2) << bestColdMs
+              << " ms  (load + downsample + mesh + bake)\n";
+    std::cout << "  warm: " << std::setw(8) << bestWarmMs << " ms  (hash " << bestHashMs
+              << " ms + map + read " << fileBytes / (1024.0 * 1024.0) << " MB)\n";
+
+    std::error_code ec;
+    std::filesystem::remove_all(cacheDir, ec);
+}
+
+// ============================================================================
+// COLLISION GRID
+// ============================================================================
+
+// Bilinear height from the mesh vertices, as collision used to read it
+float meshHeightAt(const TerrainMesh& mesh, float worldX, float worldZ)
+{
+    float gridX = (worldX + 30.0f) / 60.0f * (mesh.gridWidth - 1);
+    float gridZ = (worldZ + 30.0f) / 60.0f * (mesh.gridHeight - 1);
+    if (gridX < 0 || gridX >= mesh.gridWidth - 1 || gridZ < 0 || gridZ >= mesh.gridHeight - 1)
+        return 0.0f;
+    int x0 = static_cast<int>(gridX);
+    int z0 = static_cast<int>(gridZ);
+    float fx = gridX - x0;
+    float fz = gridZ - z0;
+    float h0 = mesh.heightAt(x0, z0) * (1 - fx) + mesh.heightAt(x0 + 1, z0) * fx;
+    float h1 = mesh.heightAt(x0, z0 + 1) * (1 - fx) + mesh.heightAt(x0 + 1, z0 + 1) * fx;
+    return h0 * (1 - fz) + h1 * fz;
+}
+
+// Memory the mesh backend holds for collision before and after the CPU mesh
+// is dropped in favour of the collision grid, plus query cost and the grid's
+// quantization error against the mesh heights
+void benchCollisionGrid(const char* heightmapPath)
+{
+    const int queries = 1000000;
+    ThreadPool pool;
+
+    Heightmap heightmap = Heightmap::loadDownsampled(heightmapPath, HEIGHTMAP_STEP,
+                                                     DownsampleFilter::Box);
+    if (!heightmap.isValid())
+    {
+        std::cout << "\n[Collision grid] " << heightmap.error() << ", skipped\n";
+        return;
+    }
+    const HeightmapView& view = heightmap.view();
+    std::cout << "\n[Collision grid] " << view.width << " x " << view.height
+              << " grid, RSS relative to the loaded heightmap\n";
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coordinate(-30.0f, 30.0f);
+    std::vector<glm::vec2> points(queries);
+    for (glm::vec2& point : points)
+        point = glm::vec2(coordinate(rng), coordinate(rng));
+
+    const TerrainVertexFormat formats[] = { TerrainVertexFormat::Full, TerrainVertexFormat::Compact };
+    for (TerrainVertexFormat format : formats)
+    {
+        releaseFreedMemory();
+        size_t baseBytes = processResidentBytes();
+        auto mesh = std::make_unique<TerrainMesh>(generateTerrainMesh(view, 1, format, pool));
+        size_t meshBytes = mesh->vertexBytes() + mesh->indices.size() * sizeof(uint16_t);
+        size_t withMesh = processResidentBytes();
+
+        CollisionGrid grid(view);
+
+        double meshNs = 0.0, gridNs = 0.0;
+        float maxError = 0.0f;
+        {
+            // Results are kept, both to compare and so the loops are not dropped
+            std::vector<float> meshHeights(queries);
+            std::vector<float> gridHeights(queries);
+            auto start = BenchClock::now();
+            for (int q = 0; q < queries; ++q)
+                meshHeights[q] = meshHeightAt(*mesh, points[q].x, points[q].y);
+            meshNs = elapsedMs(start) * 1.0e6 / queries;
+            start = BenchClock::now();
+            for (int q = 0; q < queries; ++q)
+                gridHeights[q] = grid.heightAt(points[q].x, points[q].y);
+            gridNs = elapsedMs(start) * 1.0e6 / queries;
+
+            for (int q = 0; q < queries; ++q)
+                maxError = std::max(maxError, std::abs(gridHeights[q] - meshHeights[q]));
+        }
+
+        mesh.reset();
+        releaseFreedMemory();
+        size_t withGrid = processResidentBytes();
+
+        auto residentMb = [baseBytes](size_t bytes) {
+            return (static_cast<double>(bytes) - static_cast<double>(baseBytes)) / (1024.0 * 1024.0);
+        };
+        std::cout << std::setprecision(3)
+                  << "  " << std::setw(7) << (format == TerrainVertexFormat::Compact ? "compact" : "full")
+                  << ": mesh " << meshBytes / (1024.0 * 1024.0) << " MB, RSS +" << residentMb(withMesh)
+                  << " MB; grid " << grid.bytes() / 1024.0 << " KB, RSS +" << residentMb(withGrid)
+                  << " MB after freeing the mesh\n";
+        std::cout << "           query " << std::setprecision(2) << meshNs << " ns (mesh) vs " << gridNs
+                  << " ns (grid), max difference " << std::setprecision(3) << maxError << "\n";
+    }
+}
+
+// Throughput of the batched height queries against one heightAt call per
+// point, for ground-following agents. Points spread slightly past the map
+// edge so the bounds handling is exercised too.
+void benchHeightQueries(const char* heightmapPath)
+{
+    const int queries = 1 << 20;
+    const int batch = 4096;         // Points per parallelFor work item
+    const int repeats = 5;
+
+    Heightmap heightmap = Heightmap::loadDownsampled(heightmapPath, HEIGHTMAP_STEP,
+                                                     DownsampleFilter::Box);
+    if (!heightmap.isValid())
+    {
+        std::cout << "\n[Height queries] " << heightmap.error() << ", skipped\n";
+        return;
+    }
+    CollisionGrid grid(heightmap.view());
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> coordinate(-31.0f, 31.0f);
+    std::vector<float> worldX(queries), worldZ(queries);
+    for (int q = 0; q < queries; ++q)
+    {
+        worldX[q] = coordinate(rng);
+        worldZ[q] = coordinate(rng);
+    }
+
+    std::cout << "\n[Height queries] " << queries << " points on a " << grid.width() << " x "
+              << grid.height() << " collision grid, active kernel: "
+              << heightQueryKernelName(activeHeightQueryKernel()) << "\n";
+
+    auto report = [&](const char* label, double bestMs, const char* note) {
+        std::cout << "  " << std::setw(20) << label << ": " << std::setw(8) << std::setprecision(3)
+                  << bestMs << " ms  " << std::setw(7) << std::setprecision(1)
+                  << queries / (bestMs * 1.0e3) << " M queries/s" << note << "\n";
+    };
+
+    std::vector<float> reference(queries);
+    double bestMs = 0.0;
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto start = BenchClock::now();
+        for (int q = 0; q < queries; ++q)
+            reference[q] = grid.heightAt(worldX[q], worldZ[q]);
+        double ms = elapsedMs(start);
+        if (r == 0 || ms < bestMs)
+            bestMs = ms;
+    }
+    report("heightAt per point", bestMs, "");
+
+    std::vector<float> heights(queries), normalX(queries), normalY(queries), normalZ(queries);
+    std::vector<float> scalarNormalY(queries);
+    for (HeightQueryKernel kernel : { HeightQueryKernel::Scalar, HeightQueryKernel::AVX2 })
+    {
+        std::string name = heightQueryKernelName(kernel);
+        if (!heightQueryKernelSupported(kernel))
+        {
+            std::cout << "  " << std::setw(20) << name << ": not supported\n";
+            continue;
+        }
+
+        for (bool withNormals : { false, true })
+        {
+            for (int r = 0; r < repeats; ++r)
+            {
+                auto start = BenchClock::now();
+                if (withNormals)
+                    grid.heightsAtWith(kernel, worldX.data(), worldZ.data(), queries, heights.data(),
+                                       normalX.data(), normalY.data(), normalZ.data());
+                else
+                    grid.heightsAtWith(kernel, worldX.data(), worldZ.data(), queries, heights.data());
+                double ms = elapsedMs(start);
+                if (r == 0 || ms < bestMs)
+                    bestMs = ms;
+            }
+
+            float maxError = 0.0f;
+            for (int q = 0; q < queries; ++q)
+                maxError = std::max(maxError, std::abs(heights[q] - reference[q]));
+            if (withNormals && kernel == HeightQueryKernel::Scalar)
+                scalarNormalY = normalY;
+            float normalError = 0.0f;
+            if (withNormals)
+            {
+                for (int q = 0; q < queries; ++q)
+                    normalError = std::max(normalError, std::abs(normalY[q] - scalarNormalY[q]));
+            }
+
+            std::ostringstream note;
+            note << std::setprecision(2) << "  max height diff " << maxError;
+            if (withNormals)
+                note << ", normal.y diff " << normalError;
+            report((name + (withNormals ? " + normals" : " batch")).c_str(), bestMs, note.str().c_str());
+        }
+    }
+
+    // Concurrent readers, as a simulation spread over the pool would query
+    ThreadPool pool;
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto start = BenchClock::now();
+        pool.parallelFor(queries / batch, [&](int b) {
+            size_t first = static_cast<size_t>(b) * batch;
+            grid.heightsAt(worldX.data() + first, worldZ.data() + first, batch, heights.data() + first);
+        });
+        double ms = elapsedMs(start);
+        if (r == 0 || ms < bestMs)
+            bestMs = ms;
+    }
+    std::ostringstream threads;
+    threads << "  (" << pool.size() << " threads)";
+    report("batch on pool", bestMs, threads.str().c_str());
+}
+
+// ============================================================================
+// RAYCASTS
+// ============================================================================
+
+// Height of the grid's triangulated surface, split the way the mesh and the
+// raycaster split each cell. Returns false outside the grid.
+bool gridSurfaceHeight(const CollisionGrid& grid, float worldX, float worldZ, float& height)
+{
+    float gridX = (worldX + 30.0f) / 60.0f * (grid.width() - 1);
+    float gridZ = (worldZ + 30.0f) / 60.0f * (grid.height() - 1);
+    if (!(gridX >= 0 && gridX < grid.width() - 1 && gridZ >= 0 && gridZ < grid.height() - 1))
+        return false;
+    int x0 = static_cast<int>(gridX);
+    int z0 = static_cast<int>(gridZ);
+    float fx = gridX - x0;
+    float fz = gridZ - z0;
+    if (fx + fz <= 1.0f)
+    {
+        float corner = grid.sampleHeight(x0, z0);
+        height = corner + (grid.sampleHeight(x0 + 1, z0) - corner) * fx +
+                 (grid.sampleHeight(x0, z0 + 1) - corner) * fz;
+    }
+    else
+    {
+        float corner = grid.sampleHeight(x0 + 1, z0 + 1);
+        height = corner + (grid.sampleHeight(x0, z0 + 1) - corner) * (1.0f - fx) +
+                 (grid.sampleHeight(x0 + 1, z0) - corner) * (1.0f - fz);
+    }
+    return true;
+}
+
+// Fixed-step march along the ray, refined by bisection once the ray crosses
+// the surface. Steps are a quarter cell, so it can only miss crossings
+// thinner than that.
+bool marchRay(const CollisionGrid& grid, const glm::vec3& origin, const glm::vec3& direction,
+              float maxDistance, float& distance)
+{
+    const float step = 0.25f * std::min(60.0f / (grid.width() - 1), 60.0f / (grid.height() - 1));
+    auto side = [&](float t, int& result) {
+        glm::vec3 p = origin + direction * t;
+        float surface;
+        if (!gridSurfaceHeight(grid, p.x, p.z, surface))
+            return false;
+        result = p.y >= surface ? 1 : -1;
+        return true;
+    };
+
+    int previous = 0;
+    for (float t = 0.0f; t <= maxDistance; t += step)
+    {
+        int current;
+        if (!side(t, current))
+        {
+            previous = 0;
+            continue;
+        }
+        if (previous != 0 && current != previous)
+        {
+            float lo = t - step, hi = t;
+            for (int i = 0; i < 24; ++i)
+            {
+                float mid = 0.5f * (lo + hi);
+                int midSide;
+                if (side(mid, midSide) && midSide == previous)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            distance = 0.5f * (lo + hi);
+            return true;
+        }
+        previous = current;
+    }
+    return false;
+}
+
+// Pyramid traversal against a plain march for steep picking rays from above
+// and for rays skimming the surface from one edge of the map, the worst case
+// for both. The march runs on a subset of the rays, since it is far slower.
+void benchRaycasts(const char* heightmapPath)
+{
+    const int rays = 100000;
+    const int marchedRays = 1000;
+    const int repeats = 3;
+    const float maxDistance = 200.0f;
+
+    Heightmap heightmap = Heightmap::loadDownsampled(heightmapPath, HEIGHTMAP_STEP,
+                                                     DownsampleFilter::Box);
+    if (!heightmap.isValid())
+    {
+        std::cout << "\n[Raycasts] " << heightmap.error() << ", skipped\n";
+        return;
+    }
+    CollisionGrid grid(heightmap.view());
+    auto start = BenchClock::now();
+    TerrainRaycaster raycaster(grid);
+    double buildMs = elapsedMs(start);
+
+    std::cout << "\n[Raycasts] " << grid.width() << " x " << grid.height() << " grid, "
+              << raycaster.levelCount() << " pyramid levels, " << raycaster.bytes() / 1024.0
+              << " KB, built in " << std::setprecision(3) << buildMs << " ms\n";
+
+    const float lowest = grid.offset();
+    const float highest = grid.offset() + 65535.0f * grid.scale();
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto between = [&](float a, float b) { return a + (b - a) * unit(rng); };
+
+    std::vector<glm::vec3> pickOrigins(rays), pickDirections(rays);
+    for (int r = 0; r < rays; ++r)
+    {
+        pickOrigins[r] = glm::vec3(between(-30.0f, 30.0f), highest + between(2.0f, 20.0f),
+                                   between(-30.0f, 30.0f));
+        glm::vec3 target(between(-30.0f, 30.0f), lowest, between(-30.0f, 30.0f));
+        pickDirections[r] = glm::normalize(target - pickOrigins[r]);
+    }
+
+    std::vector<glm::vec3> grazeOrigins(rays), grazeDirections(rays);
+    for (int r = 0; r < rays; ++r)
+    {
+        float z = between(-29.0f, 29.0f);
+        float surface = 0.0f;
+        gridSurfaceHeight(grid, -29.99f, z, surface);
+        grazeOrigins[r] = glm::vec3(-29.99f, surface + between(0.05f, 0.5f) * (highest - lowest), z);
+        grazeDirections[r] = glm::normalize(glm::vec3(1.0f, between(-0.05f, 0.01f), between(-0.5f, 0.5f)));
+    }
+
+    auto run = [&](const char* label, const std::vector<glm::vec3>& origins,
+                   const std::vector<glm::vec3>& directions) {
+        std::vector<float> distances(rays, -1.0f);
+        double bestMs = 0.0;
+        int hits = 0;
+        for (int rep = 0; rep < repeats; ++rep)
+        {
+            hits = 0;
+            auto repStart = BenchClock::now();
+            for (int r = 0; r < rays; ++r)
+            {
+                TerrainRayHit hit;
+                if (raycaster.raycast(origins[r], directions[r], maxDistance, hit))
+                {
+                    distances[r] = hit.distance;
+                    ++hits;
+                }
+            }
+            double ms = elapsedMs(repStart);
+            if (rep == 0 || ms < bestMs)
+                bestMs = ms;
+        }
+
+        // Any crossing the march finds is on the surface, so one nearer than
+        // the raycast hit means the traversal skipped something. The march
+        // in turn can step over ridges thinner than its step.
+        int missed = 0;
+        int skipped = 0;
+        float maxDifference = 0.0f;
+        auto marchStart = BenchClock::now();
+        for (int r = 0; r < marchedRays; ++r)
+        {
+            float distance = -1.0f;
+            bool marched = marchRay(grid, origins[r], directions[r], maxDistance, distance);
+            bool traced = distances[r] >= 0.0f;
+            if (marched && (!traced || distance < distances[r] - 1.0e-3f))
+                ++missed;
+            else if (traced && (!marched || distance > distances[r] + 1.0e-3f))
+                ++skipped;
+            else if (marched)
+                maxDifference = std::max(maxDifference, std::abs(distance - distances[r]));
+        }
+        double marchUs = elapsedMs(marchStart) * 1.0e3 / marchedRays;
+
+        std::cout << "  " << std::setw(8) << label << ": " << std::setw(7) << std::setprecision(3)
+                  << bestMs * 1.0e3 / rays << " us/ray (" << std::setprecision(3)
+                  << rays / (bestMs * 1.0e3) << " M rays/s, " << hits << " / " << rays << " hit), march "
+                  << std::setprecision(4) << marchUs << " us/ray\n";
+        std::cout << "            of " << marchedRays << " marched: " << missed
+                  << " nearer hits missed, " << skipped << " hits the march stepped over, max distance diff "
+                  << std::setprecision(2) << maxDifference << "\n";
+    };
+    run("picking", pickOrigins, pickDirections);
+    run("grazing", grazeOrigins, grazeDirections);
+}
+
+// Camera moves at the viewer's 20 units/s for one 60 Hz frame and for a
+// 250 ms hitch, checked the old way (height at the destination only)
+// and swept. A move tunnels if the straight path to where the camera ends
+// up passes through the surface.
+void benchCameraSweep(const char* heightmapPath)
+{
+    const int moves = 100000;
+    const float radius = 0.15f;     // The viewer's CAMERA_HEIGHT_OFFSET
+
+    Heightmap heightmap = Heightmap::loadDownsampled(heightmapPath, HEIGHTMAP_STEP,
+                                                     DownsampleFilter::Box);
+    if (!heightmap.isValid())
+    {
+        std::cout << "\n[Camera sweep] " << heightmap.error() << ", skipped\n";
+        return;
+    }
+    CollisionGrid grid(heightmap.view());
+    TerrainRaycaster raycaster(grid);
+    std::cout << "\n[Camera sweep] " << moves << " moves on a " << grid.width() << " x "
+              << grid.height() << " collision grid, sphere radius " << radius << "\n";
+
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<glm::vec3> starts(moves), directions(moves);
+    for (int m = 0; m < moves; ++m)
+    {
+        float x = -25.0f + 50.0f * unit(rng);
+        float z = -25.0f + 50.0f * unit(rng);
+        starts[m] = glm::vec3(x, grid.heightAt(x, z) + radius + 0.05f + unit(rng), z);
+        float angle = 6.2831853f * unit(rng);
+        directions[m] = glm::normalize(glm::vec3(std::cos(angle), -0.6f * unit(rng), std::sin(angle)));
+    }
+
+    auto tunnels = [&](const glm::vec3& from, const glm::vec3& to) {
+        glm::vec3 path = to - from;
+        float length = glm::length(path);
+        TerrainRayHit hit;
+        return length > 1.0e-6f && raycaster.raycast(from, path / length, length, hit);
+    };
+
+    std::vector<glm::vec3> ends(moves);
+    for (float distance : { 20.0f / 60.0f, 20.0f * 0.25f })
+    {
+        auto start = BenchClock::now();
+        for (int m = 0; m < moves; ++m)
+        {
+            glm::vec3 proposed = starts[m] + directions[m] * distance;
+            float ground = grid.heightAt(proposed.x, proposed.z) + radius;
+            ends[m] = proposed.y >= ground ? proposed : glm::vec3(starts[m].x, ground, starts[m].z);
+        }
+        double pointUs = elapsedMs(start) * 1.0e3 / moves;
+        int pointTunnels = 0;
+        for (int m = 0; m < moves; ++m)
+            pointTunnels += tunnels(starts[m], ends[m]) ? 1 : 0;
+
+        start = BenchClock::now();
+        for (int m = 0; m < moves; ++m)
+            ends[m] = moveSphere(grid, starts[m], directions[m] * distance, radius);
+        double sweepUs = elapsedMs(start) * 1.0e3 / moves;
+
+        // Slides follow the surface, so only the stretch up to first contact
+        // is a straight path
+        int sweepTunnels = 0;
+        for (int m = 0; m < moves; ++m)
+        {
+            TerrainSweepHit hit;
+            glm::vec3 motion = directions[m] * distance;
+            glm::vec3 reached = sweepSphere(grid, starts[m], motion, radius, hit) ? hit.position
+                                                                                   : starts[m] + motion;
+            sweepTunnels += tunnels(starts[m], reached) ? 1 : 0;
+        }
+
+        std::cout << "  " << std::setw(5) << std::setprecision(3) << distance << " units: destination check "
+                  << std::setprecision(3) << pointUs << " us, " << pointTunnels << " tunnelled; sweep "
+                  << sweepUs << " us, " << sweepTunnels << " tunnelled\n";
+    }
+}
+
+// ============================================================================
+// TILED HEIGHTMAPS
+// ============================================================================
+
+// The source image decoded by stb_image (one core) against the same samples
+// in a .hmt file decoded on one and on all threads, plus compressed size and
+// random access to a single tile
+void benchTiledDecode(const char* heightmapPath)
+{
+    const int repeats = 3;
+
+    auto start = BenchClock::now();
+    Heightmap source = Heightmap::load(heightmapPath);
+    double sourceMs = elapsedMs(start);
+    if (!source.isValid() || source.view().format == HeightmapFormat::F32)
+    {
+        std::cout << "\n[Tiled heightmap] needs an 8- or 16-bit heightmap, skipped\n";
+        return;
+    }
+    for (int r = 1; r < repeats; ++r)
+    {
+        start = BenchClock::now();
+        Heightmap again = Heightmap::load(heightmapPath);
+        sourceMs = std::min(sourceMs, elapsedMs(start));
+    }
+
+    const HeightmapView& view = source.view();
+    const std::string tiledPath = std::string(heightmapPath) + ".bench.hmt";
+    ThreadPool pool;
+    std::string error;
+    start = BenchClock::now();
+    if (!writeTiledHeightmap(tiledPath.c_str(), view, TILED_HEIGHTMAP_TILE_SIZE, pool, error))
+    {
+        std::cout << "\n[Tiled heightmap] " << error << ", skipped\n";
+        return;
+    }
+    double encodeMs = elapsedMs(start);
+
+    TiledHeightmap tiled;
+    if (!tiled.open(tiledPath.c_str()))
+    {
+        std::cout << "\n[Tiled heightmap] " << tiled.error() << ", skipped\n";
+        std::remove(tiledPath.c_str());
+        return;
+    }
+
+    const double samples = static_cast<double>(view.width) * view.height;
+    const size_t sampleBytes = heightmapSampleBytes(view.format);
+    std::ifstream sourceFile(heightmapPath, std::ios::binary | std::ios::ate);
+    const double sourceBytes = static_cast<double>(sourceFile.tellg());
+
+    std::cout << "\n[Tiled heightmap] " << view.width << " x " << view.height << " "
+              << heightmapFormatName(view.format) << ", " << tiled.tilesX() << " x " << tiled.tilesZ()
+              << " tiles of " << tiled.tileSize() << " (best of " << repeats << ")\n";
+    std::cout << "  " << std::setw(14) << "source file" << ": " << std::setw(8) << std::setprecision(2)
+              << sourceMs << " ms, " << std::setw(6) << sourceBytes * 8.0 / samples << " bits/sample  (stb_image)\n";
+
+    std::vector<unsigned char> decoded(static_cast<size_t>(samples) * sampleBytes);
+    ThreadPool serialPool(1);
+    bool exact = true;
+    for (ThreadPool* decodePool : { &serialPool, &pool })
+    {
+        double bestMs = 0.0;
+        for (int r = 0; r < repeats; ++r)
+        {
+            start = BenchClock::now();
+            bool ok = tiled.decode(decoded.data(), *decodePool);
+            double ms = elapsedMs(start);
+            if (r == 0 || ms < bestMs)
+                bestMs = ms;
+            exact = exact && ok && std::memcmp(decoded.data(), view.data, decoded.size()) == 0;
+        }
+        std::string label = "hmt " + std::to_string(decodePool->size()) + " thread" +
+                            (decodePool->size() == 1 ? "" : "s");
+        std::cout << "  " << std::setw(14) << label << ": " << std::setw(8) << bestMs << " ms, "
+                  << std::setw(6) << tiled.fileBytes() * 8.0 / samples << " bits/sample, "
+                  << samples / bestMs / 1000.0 << " Msamples/s\n";
+    }
+
+    // Random access: every tile decoded on its own into a tile-sized buffer
+    std::vector<unsigned char> tile(static_cast<size_t>(tiled.tileSize()) * tiled.tileSize() * sampleBytes);
+    start = BenchClock::now();
+    for (int tz = 0; tz < tiled.tilesZ(); ++tz)
+        for (int tx = 0; tx < tiled.tilesX(); ++tx)
+            tiled.decodeTile(0, tx, tz, tile.data(), static_cast<size_t>(tiled.tileSize()));
+    double tileUs = elapsedMs(start) * 1000.0 / (tiled.tilesX() * tiled.tilesZ());
+
+    std::cout << "  Single tile: " << tileUs << " us, encode: " << encodeMs << " ms, "
+              << "ratio to raw samples: " << samples * sampleBytes / tiled.fileBytes() << "x, "
+              << (exact ? "lossless" : "MISMATCH") << "\n";
+
+    tiled = TiledHeightmap();
+    std::remove(tiledPath.c_str());
+}
+
+// ============================================================================
+// TILE STREAMING
+// ============================================================================
+
+// Render-thread cost of streaming a .hmt pyramid during a camera flight
+// across the map: per frame, collect finished tiles, gather the strips a
+// 252-quad clipmap exposes at each level and queue requests. Small tiles and
+// a tight budget keep the I/O thread and the eviction busy.
+void benchTileStreaming(const char* heightmapPath)
+{
+    const int tileSize = 64;
+    const int frames = 600;
+    const int region = 255;     // Clipmap grid + normal border
+    const size_t budget = size_t(1) << 20;
+
+    Heightmap source = Heightmap::load(heightmapPath);
+    if (!source.isValid() || source.view().format == HeightmapFormat::F32)
+    {
+        std::cout << "\n[Tile streaming] needs an 8- or 16-bit heightmap, skipped\n";
+        return;
+    }
+    const std::string tiledPath = std::string(heightmapPath) + ".bench-stream.hmt";
+    std::string error;
+    {
+        ThreadPool pool;
+        if (!writeTiledHeightmap(tiledPath.c_str(), source.view(), tileSize, pool, error))
+        {
+            std::cout << "\n[Tile streaming] " << error << ", skipped\n";
+            return;
+        }
+    }
+
+    std::vector<double> frameMs;
+    size_t peakBytes = 0, loaded = 0, evicted = 0;
+    int levels = 0;
+    {
+        TileStreamer streamer(budget);
+        if (!streamer.open(tiledPath.c_str()))
+        {
+            std::cout << "\n[Tile streaming] " << streamer.error() << ", skipped\n";
+            std::remove(tiledPath.c_str());
+            return;
+        }
+        levels = streamer.levelCount() + 1;
+
+        std::vector<unsigned char> staging(static_cast<size_t>(region) * region * sizeof(uint16_t));
+        std::vector<int> originX(levels, INT32_MIN), originZ(levels, INT32_MIN);
+        const float width = static_cast<float>(streamer.width());
+        const float height = static_cast<float>(streamer.height());
+        for (int f = 0; f < frames; ++f)
+        {
+            // Diagonal flight there and back, about a texel and a half a frame
+            float t = static_cast<float>(f) / frames;
+            float along = t < 0.5f ? 2.0f * t : 2.0f - 2.0f * t;
+            float cameraX = 0.05f * width + 0.9f * width * along;
+            float cameraZ = 0.05f * height + 0.9f * height * along;
+
+            auto start = BenchClock::now();
+            streamer.beginFrame(cameraX, cameraZ);
+            for (int l = 0; l < levels; ++l)
+            {
+                float spacing = static_cast<float>(2 << l);
+                int x = 2 * static_cast<int>(std::floor(cameraX / spacing)) - region / 2;
+                int z = 2 * static_cast<int>(std::floor(cameraZ / spacing)) - region / 2;
+                int dx = x - originX[l], dz = z - originZ[l];
+                if (std::abs(dx) >= region || std::abs(dz) >= region)
+                {
+                    streamer.gather(l, x, z, region, region, staging.data());
+                }
+                else
+                {
+                    if (dx != 0)
+                        streamer.gather(l, dx > 0 ? originX[l] + region : x, z, std::abs(dx), region,
+                                        staging.data());
+                    if (dz != 0)
+                        streamer.gather(l, x, dz > 0 ? originZ[l] + region : z, region, std::abs(dz),
+                                        staging.data());
+                }
+                originX[l] = x;
+                originZ[l] = z;
+                streamer.require(l, x, z, region, region);
+            }
+            streamer.endFrame();
+            frameMs.push_back(elapsedMs(start));
+            peakBytes = std::max(peakBytes, streamer.residentBytes());
+
+            // Leave the I/O thread a slice of a 60 Hz frame
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        loaded = streamer.tilesLoaded();
+        evicted = streamer.tilesEvicted();
+    }
+    std::remove(tiledPath.c_str());
+
+    std::sort(frameMs.begin(), frameMs.end());
+    std::cout << "\n[Tile streaming] " << frames << " frames, " << levels << " levels, "
+              << tileSize << "x" << tileSize << " tiles, budget " << (budget >> 20) << " MB\n";
+    std::cout << "  Render thread: median " << std::setprecision(3) << frameMs[frameMs.size() / 2]
+              << " ms, p99 " << frameMs[frameMs.size() * 99 / 100] << " ms, max " << frameMs.back()
+              << " ms\n";
+    std::cout << "  Tiles loaded: " << loaded << ", evicted: " << evicted << ", peak resident: "
+              << std::setprecision(2) << peakBytes / (1024.0 * 1024.0) << " MB\n";
+}
+
+} // namespace
+
+int runBenchmarks(const char* heightmapPath)
+{
+    int width = 0, height = 0, channels = 0;
+    unsigned char* data = stbi_load(heightmapPath, &width, &height, &channels, 1);
+    if (!data)
+    {
+        std::cerr << "Failed to load heightmap: " << heightmapPath << "\n";
+        std::cerr << "Reason: " << stbi_failure_reason() << "\n";
+        return -1;
+    }
+
+    std::cout << "Benchmarking with heightmap: " << heightmapPath << "\n";
+
+    auto start = BenchClock::now();
+    ReferenceTerrainMesh reference = generateTerrainMeshSerial(data, width, height, BENCH_STEP);
+    double serialMs = elapsedMs(start);
+
+    benchMeshGeneration(data, width, height, reference, serialMs);
+    benchNormalKernels(reference);
+    benchSampleKernels(data, width, height);
+    benchFrustumCulling();
+    benchHeightmapLoading(heightmapPath, data, width, height);
+    benchDownsampledLoading(heightmapPath);
+    benchTerrainCache(heightmapPath);
+    benchCollisionGrid(heightmapPath);
+    benchHeightQueries(heightmapPath);
+    benchRaycasts(heightmapPath);
+    benchCameraSweep(heightmapPath);
+    benchTiledDecode(heightmapPath);
+    benchTileStreaming(heightmapPath);
+
+    stbi_image_free(data);
+    return 0;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Headless benchmarks for the CPU side of the terrain pipeline.
+// Run with: TerrainRenderer --bench [heightmap]
+int runBenchmarks(const char* heightmapPath);
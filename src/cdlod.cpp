@@ -0,0 +1,389 @@
+#include "cdlod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <glad/gl.h>
+
+#include "height_texture.h"
+#include "terrain_mesh.h"
+
+namespace {
+
+// Grid patch quadrants are drawn separately when only part of a node is
+// selected, so their indices are stored as four consecutive blocks
+const int CDLOD_HALF_GRID = CDLOD_GRID_SIZE / 2;
+
+// Morph start for the top level, far enough that it never morphs
+const float CDLOD_NO_MORPH = 1.0e30f;
+
+int ceilDiv(int a, int b)
+{
+    return (a + b - 1) / b;
+}
+
+// Node bounds are stored as 16-bit normalized heights, rounded outwards so
+// they always contain the samples
+uint16_t quantizeHeight(float normalized, bool roundUp)
+{
+    float scaled = normalized * 65535.0f;
+    scaled = roundUp ? std::ceil(scaled) : std::floor(scaled);
+    return static_cast<uint16_t>(std::max(0.0f, std::min(scaled, 65535.0f)));
+}
+
+// Min/max of one row of leaf nodes, scanned at the samples' stored width
+template <typename Sample>
+void leafRowMinMax(const HeightmapView& heightmap, int nz, int nodesX, uint16_t* row)
+{
+    std::vector<Sample> lo(nodesX, std::numeric_limits<Sample>::max());
+    std::vector<Sample> hi(nodesX, std::numeric_limits<Sample>::lowest());
+
+    int z0 = nz * CDLOD_GRID_SIZE;
+    int z1 = std::min(z0 + CDLOD_GRID_SIZE, heightmap.height - 1);
+    for (int z = z0; z <= z1; ++z)
+    {
+        const Sample* texels = &heightmap.samples<Sample>()[static_cast<size_t>(z) * heightmap.width];
+        for (int nx = 0; nx < nodesX; ++nx)
+        {
+            int x0 = nx * CDLOD_GRID_SIZE;
+            int x1 = std::min(x0 + CDLOD_GRID_SIZE, heightmap.width - 1);
+            Sample nodeLo = lo[nx];
+            Sample nodeHi = hi[nx];
+            for (int x = x0; x <= x1; ++x)
+            {
+                nodeLo = std::min(nodeLo, texels[x]);
+                nodeHi = std::max(nodeHi, texels[x]);
+            }
+            lo[nx] = nodeLo;
+            hi[nx] = nodeHi;
+        }
+    }
+
+    // A reversed float range (min > max) flips which sample is lowest
+    const SampleRange range = heightmap.range;
+    for (int nx = 0; nx < nodesX; ++nx)
+    {
+        float a = (static_cast<float>(lo[nx]) - range.offset) / range.span;
+        float b = (static_cast<float>(hi[nx]) - range.offset) / range.span;
+        row[nx * 2]     = quantizeHeight(std::min(a, b), false);
+        row[nx * 2 + 1] = quantizeHeight(std::max(a, b), true);
+    }
+}
+
+} // namespace
+
+CdlodTerrainRenderer::CdlodTerrainRenderer(const HeightmapView& heightmap, ThreadPool& pool,
+                                           GpuResidency& residency)
+    : width_(heightmap.width),
+      height_(heightmap.height),
+      residency_(residency),
+      shader_("shaders/cdlod_vertex.glsl", "shaders/fragment.glsl")
+{
+    buildTree(heightmap, pool);
+
+    // Full-resolution height texture at the samples' own width. Linear
+    // filtering lets morphing vertices and normal taps land between texels.
+    HeightTextureFormat textureFormat = heightTextureFormat(heightmap);
+    textureBytesPerTexel_ = textureFormat.bytesPerTexel;
+    glGenTextures(1, &heightTexture_);
+    glBindTexture(GL_TEXTURE_2D, heightTexture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, textureFormat.internalFormat, width_, height_, 0,
+                 GL_RED, textureFormat.type, heightmap.data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    residency_.trackTexture(textureBytes());
+
+    buildGridPatch();
+
+    shader_.use();
+    shader_.setInt("heightmap", 0);
+    shader_.setVec2("heightmapSize", static_cast<float>(width_), static_cast<float>(height_));
+    shader_.setVec2("heightRange", textureFormat.offset, textureFormat.scale);
+    shader_.setFloat("normalStep", static_cast<float>(HEIGHTMAP_STEP));
+}
+
+CdlodTerrainRenderer::~CdlodTerrainRenderer()
+{
+    residency_.untrackTexture(textureBytes());
+    residency_.untrackBuffer(gridBytes_);
+    glDeleteTextures(1, &heightTexture_);
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &vbo_);
+    glDeleteBuffers(1, &ebo_);
+}
+
+bool CdlodTerrainRenderer::isValid() const
+{
+    return shader_.isValid();
+}
+
+// ============================================================================
+// QUADTREE
+// ============================================================================
+
+void CdlodTerrainRenderer::buildTree(const HeightmapView& heightmap, ThreadPool& pool)
+{
+    // Quads of the full-resolution grid; node ranges are inclusive of their
+    // far edge so neighbouring nodes share border texels
+    const int quadsX = std::max(1, width_ - 1);
+    const int quadsZ = std::max(1, height_ - 1);
+    const float texelWorldSize = std::max(60.0f / quadsX, 60.0f / quadsZ);
+
+    int nodeSize = CDLOD_GRID_SIZE;
+    while (true)
+    {
+        Level level;
+        level.nodeSize = nodeSize;
+        level.nodesX = ceilDiv(quadsX, nodeSize);
+        level.nodesZ = ceilDiv(quadsZ, nodeSize);
+        level.minMax.resize(static_cast<size_t>(level.nodesX) * level.nodesZ * 2);
+        level.range = CDLOD_RANGE_FACTOR * nodeSize * texelWorldSize;
+        levels_.push_back(std::move(level));
+        if (nodeSize >= quadsX && nodeSize >= quadsZ)
+            break;
+        nodeSize *= 2;
+    }
+
+    // Each level morphs over the last part of its range, from the previous
+    // level's range outwards
+    for (size_t l = 0; l < levels_.size(); ++l)
+    {
+        float inner = l > 0 ? levels_[l - 1].range : 0.0f;
+        levels_[l].morphStart = levels_[l].range - CDLOD_MORPH_FRACTION * (levels_[l].range - inner);
+    }
+    levels_.back().morphStart = CDLOD_NO_MORPH;
+
+    // Leaves scan the heightmap, one row of nodes per work item
+    Level& leaves = levels_[0];
+    pool.parallelFor(leaves.nodesZ, [&](int nz) {
+        uint16_t* row = &leaves.minMax[static_cast<size_t>(nz) * leaves.nodesX * 2];
+        switch (heightmap.format)
+        {
+        case HeightmapFormat::U16: leafRowMinMax<uint16_t>(heightmap, nz, leaves.nodesX, row); break;
+        case HeightmapFormat::F32: leafRowMinMax<float>(heightmap, nz, leaves.nodesX, row); break;
+        default:                   leafRowMinMax<uint8_t>(heightmap, nz, leaves.nodesX, row); break;
+        }
+    });
+
+    // Parents combine their (up to four) children
+    for (size_t l = 1; l < levels_.size(); ++l)
+    {
+        const Level& child = levels_[l - 1];
+        Level& parent = levels_[l];
+        for (int nz = 0; nz < parent.nodesZ; ++nz)
+        {
+            for (int nx = 0; nx < parent.nodesX; ++nx)
+            {
+                uint16_t lo = 65535;
+                uint16_t hi = 0;
+                for (int q = 0; q < 4; ++q)
+                {
+                    int cx = nx * 2 + (q & 1);
+                    int cz = nz * 2 + (q >> 1);
+                    if (cx >= child.nodesX || cz >= child.nodesZ)
+                        continue;
+                    const uint16_t* c = &child.minMax[(static_cast<size_t>(cz) * child.nodesX + cx) * 2];
+                    lo = std::min(lo, c[0]);
+                    hi = std::max(hi, c[1]);
+                }
+                uint16_t* p = &parent.minMax[(static_cast<size_t>(nz) * parent.nodesX + nx) * 2];
+                p[0] = lo;
+                p[1] = hi;
+            }
+        }
+    }
+}
+
+size_t CdlodTerrainRenderer::treeBytes() const
+{
+    size_t bytes = 0;
+    for (const Level& level : levels_)
+        bytes += level.minMax.size() * sizeof(uint16_t);
+    return bytes;
+}
+
+size_t CdlodTerrainRenderer::textureBytes() const
+{
+    return static_cast<size_t>(width_) * height_ * textureBytesPerTexel_;
+}
+
+glm::vec3 CdlodTerrainRenderer::texelToWorld(float tx, float tz, float height) const
+{
+    // Same mapping as the mesh path: the map spans -30 to 30 on both axes
+    return glm::vec3(tx / (width_ - 1) * 60.0f - 30.0f, height,
+                     tz / (height_ - 1) * 60.0f - 30.0f);
+}
+
+void CdlodTerrainRenderer::nodeBounds(int level, int x, int z,
+                                      glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    const Level& l = levels_[level];
+    const uint16_t* minMax = &l.minMax[(static_cast<size_t>(z) * l.nodesX + x) * 2];
+    int x0 = x * l.nodeSize;
+    int z0 = z * l.nodeSize;
+    int x1 = std::min(x0 + l.nodeSize, width_ - 1);
+    int z1 = std::min(z0 + l.nodeSize, height_ - 1);
+    boundsMin = texelToWorld(static_cast<float>(x0), static_cast<float>(z0),
+                             minMax[0] / 65535.0f * HEIGHT_SCALE);
+    boundsMax = texelToWorld(static_cast<float>(x1), static_cast<float>(z1),
+                             minMax[1] / 65535.0f * HEIGHT_SCALE);
+}
+
+bool CdlodTerrainRenderer::nodeInRange(int level, int x, int z,
+                                       const glm::vec3& cameraPos, float range) const
+{
+    glm::vec3 boundsMin, boundsMax;
+    nodeBounds(level, x, z, boundsMin, boundsMax);
+    glm::vec3 closest = glm::clamp(cameraPos, boundsMin, boundsMax);
+    glm::vec3 offset = closest - cameraPos;
+    return glm::dot(offset, offset) <= range * range;
+}
+
+// Returns false if the node is beyond its level's range, in which case the
+// parent covers that area itself. Nodes outside the frustum count as
+// handled so the parent does not draw them either.
+bool CdlodTerrainRenderer::selectNode(int level, int x, int z, const TerrainFrame& frame)
+{
+    const int topLevel = levelCount() - 1;
+    if (level < topLevel && !nodeInRange(level, x, z, frame.cameraPos, levels_[level].range))
+        return false;
+
+    glm::vec3 boundsMin, boundsMax;
+    nodeBounds(level, x, z, boundsMin, boundsMax);
+    if (!aabbInFrustum(frame.frustum, boundsMin, boundsMax))
+        return true;
+
+    if (level == 0 || !nodeInRange(level, x, z, frame.cameraPos, levels_[level - 1].range))
+    {
+        selection_.push_back({ x, z, level, -1 });
+        return true;
+    }
+
+    const Level& child = levels_[level - 1];
+    for (int q = 0; q < 4; ++q)
+    {
+        int cx = x * 2 + (q & 1);
+        int cz = z * 2 + (q >> 1);
+        if (cx >= child.nodesX || cz >= child.nodesZ)
+            continue;   // Past the edge of the map
+        if (selectNode(level - 1, cx, cz, frame))
+            continue;
+
+        nodeBounds(level - 1, cx, cz, boundsMin, boundsMax);
+        if (aabbInFrustum(frame.frustum, boundsMin, boundsMax))
+            selection_.push_back({ x, z, level, q });
+    }
+    return true;
+}
+
+// ============================================================================
+// RENDERING
+// ============================================================================
+
+void CdlodTerrainRenderer::buildGridPatch()
+{
+    const int side = CDLOD_GRID_SIZE + 1;
+    std::vector<float> gridPositions;
+    gridPositions.reserve(static_cast<size_t>(side) * side * 2);
+    for (int j = 0; j < side; ++j)
+    {
+        for (int i = 0; i < side; ++i)
+        {
+            gridPositions.push_back(static_cast<float>(i));
+            gridPositions.push_back(static_cast<float>(j));
+        }
+    }
+
+    // Same triangle layout as buildChunkIndices, one block per quadrant
+    std::vector<uint16_t> indices;
+    indices.reserve(static_cast<size_t>(CDLOD_GRID_SIZE) * CDLOD_GRID_SIZE * 6);
+    for (int q = 0; q < 4; ++q)
+    {
+        int i0 = (q & 1) * CDLOD_HALF_GRID;
+        int j0 = (q >> 1) * CDLOD_HALF_GRID;
+        for (int j = j0; j < j0 + CDLOD_HALF_GRID; ++j)
+        {
+            for (int i = i0; i < i0 + CDLOD_HALF_GRID; ++i)
+            {
+                uint16_t topLeft     = static_cast<uint16_t>(j * side + i);
+                uint16_t topRight    = static_cast<uint16_t>(j * side + (i + 1));
+                uint16_t bottomLeft  = static_cast<uint16_t>((j + 1) * side + i);
+                uint16_t bottomRight = static_cast<uint16_t>((j + 1) * side + (i + 1));
+                indices.insert(indices.end(), { topLeft, bottomLeft, topRight,
+                                                topRight, bottomLeft, bottomRight });
+            }
+        }
+    }
+    quadrantIndexCount_ = CDLOD_HALF_GRID * CDLOD_HALF_GRID * 6;
+
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glGenBuffers(1, &ebo_);
+
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, gridPositions.size() * sizeof(float),
+                 gridPositions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t),
+                 indices.data(), GL_STATIC_DRAW);
+    gridBytes_ = gridPositions.size() * sizeof(float) + indices.size() * sizeof(uint16_t);
+    residency_.trackBuffer(gridBytes_);
+
+    // Grid position attribute (location = 0), 0..CDLOD_GRID_SIZE
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+    glBindVertexArray(0);
+}
+
+void CdlodTerrainRenderer::render(const TerrainFrame& frame)
+{
+    selection_.clear();
+    const int topLevel = levelCount() - 1;
+    for (int z = 0; z < levels_[topLevel].nodesZ; ++z)
+        for (int x = 0; x < levels_[topLevel].nodesX; ++x)
+            selectNode(topLevel, x, z, frame);
+
+    shader_.use();
+    shader_.setMat4("view", &frame.view[0][0]);
+    shader_.setMat4("projection", &frame.projection[0][0]);
+    shader_.setVec3("viewPos", &frame.cameraPos[0]);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, heightTexture_);
+    glBindVertexArray(vao_);
+    for (const CdlodNode& node : selection_)
+    {
+        const Level& level = levels_[node.level];
+        float morphEnd = level.range;
+        float morphScale = node.level == topLevel ? 0.0f : 1.0f / (morphEnd - level.morphStart);
+        shader_.setVec2("nodeOrigin", static_cast<float>(node.x * level.nodeSize),
+                        static_cast<float>(node.z * level.nodeSize));
+        shader_.setFloat("nodeScale", static_cast<float>(level.nodeSize / CDLOD_GRID_SIZE));
+        shader_.setVec2("morphRange", level.morphStart, morphScale);
+
+        if (node.quadrant < 0)
+        {
+            glDrawElements(GL_TRIANGLES, quadrantIndexCount_ * 4, GL_UNSIGNED_SHORT, (void*)0);
+        }
+        else
+        {
+            size_t offset = static_cast<size_t>(node.quadrant) * quadrantIndexCount_ * sizeof(uint16_t);
+            glDrawElements(GL_TRIANGLES, quadrantIndexCount_, GL_UNSIGNED_SHORT, (void*)offset);
+        }
+    }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+std::string CdlodTerrainRenderer::stats() const
+{
+    return "CDLOD nodes " + std::to_string(selection_.size()) +
+           " (" + std::to_string(levelCount()) + " levels)";
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "gpu_residency.h"
+#include "heightmap.h"
+#include "shader.h"
+#include "terrain_renderer.h"
+#include "thread_pool.h"
+
+// ============================================================================
+// CDLOD SETTINGS
+// ============================================================================
+
+// Quads per side of the grid patch drawn for every selected node. Leaf nodes
+// map one quad to one heightmap texel, each level up doubles the spacing.
+const int CDLOD_GRID_SIZE = 32;
+
+// A level is used out to this many times its node size; beyond that the
+// next coarser level takes over
+const float CDLOD_RANGE_FACTOR = 2.5f;
+
+// Fraction of each level's range over which vertices morph into the coarser
+// grid, ending exactly where the coarser level starts
+const float CDLOD_MORPH_FRACTION = 0.3f;
+
+// ============================================================================
+// CDLOD TERRAIN
+// ============================================================================
+
+// One node picked by the quadtree selection. Nodes whose children are only
+// partly in range draw just the quadrants the children do not cover.
+struct CdlodNode
+{
+    int x;          // Texel coordinate of the node's corner
+    int z;
+    int level;      // 0 = leaves
+    int quadrant;   // -1 = whole node, else 0..3 (bit 0 = +X half, bit 1 = +Z half)
+};
+
+// Continuous distance-dependent LOD (Strugar 2010). Heights live in a single
+// texture at full resolution and full sample depth; the CPU keeps only a min/max quadtree for
+// selection and culling, so memory grows with the heightmap, not with the
+// number of vertices drawn.
+class CdlodTerrainRenderer : public TerrainRenderer
+{
+public:
+    // Only reads the heightmap during construction. The texture and grid
+    // count against residency's budget.
+    CdlodTerrainRenderer(const HeightmapView& heightmap, ThreadPool& pool, GpuResidency& residency);
+    ~CdlodTerrainRenderer() override;
+
+    bool isValid() const override;
+    void render(const TerrainFrame& frame) override;
+    std::string stats() const override;
+
+    int levelCount() const { return static_cast<int>(levels_.size()); }
+    size_t treeBytes() const;
+    size_t textureBytes() const;
+
+private:
+    struct Level
+    {
+        int nodeSize;                   // Texels per node side
+        int nodesX;
+        int nodesZ;
+        std::vector<uint16_t> minMax;   // Interleaved min, max per node, 0..65535
+        float range = 0.0f;             // Selection distance for this level
+        float morphStart = 0.0f;
+    };
+
+    void buildTree(const HeightmapView& heightmap, ThreadPool& pool);
+    bool selectNode(int level, int x, int z, const TerrainFrame& frame);
+    void nodeBounds(int level, int x, int z, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+    bool nodeInRange(int level, int x, int z, const glm::vec3& cameraPos, float range) const;
+    void buildGridPatch();
+    glm::vec3 texelToWorld(float tx, float tz, float height) const;
+
+    int width_;
+    int height_;
+    std::vector<Level> levels_;
+
+    GpuResidency& residency_;
+    Shader shader_;
+    unsigned int heightTexture_ = 0;
+    size_t textureBytesPerTexel_ = 1;
+    unsigned int vao_ = 0;
+    unsigned int vbo_ = 0;
+    unsigned int ebo_ = 0;
+    size_t gridBytes_ = 0;
+    int quadrantIndexCount_ = 0;
+
+    std::vector<CdlodNode> selection_;
+};
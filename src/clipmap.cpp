@@ -0,0 +1,417 @@
+#include "clipmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glad/gl.h>
+
+#include "frustum_culling.h"
+#include "height_texture.h"
+#include "terrain_mesh.h"
+
+namespace {
+
+const int CLIPMAP_QUARTER_GRID = CLIPMAP_GRID_SIZE / 4;
+
+// Level texels kept resident per side: the grid's vertices plus one texel on
+// each side for the normal taps
+const int CLIPMAP_REGION_SIZE = CLIPMAP_GRID_SIZE + 3;
+
+int wrapTexel(int coordinate)
+{
+    return ((coordinate % CLIPMAP_TEXTURE_SIZE) + CLIPMAP_TEXTURE_SIZE) % CLIPMAP_TEXTURE_SIZE;
+}
+
+// Copies a rectangle of level texels (every spacing-th heightmap sample,
+// unfiltered and clamped to the map; a .hmt pyramid is filtered instead)
+// into staging memory at the samples' stored width
+template <typename Sample>
+void gatherLevelTexels(const HeightmapView& heightmap, int x0, int z0, int columns, int rows,
+                       int spacing, unsigned char* staging)
+{
+    const Sample* samples = heightmap.samples<Sample>();
+    Sample* out = reinterpret_cast<Sample*>(staging);
+    for (int r = 0; r < rows; ++r)
+    {
+        int sz = std::max(0, std::min((z0 + r) * spacing, heightmap.height - 1));
+        const Sample* row = samples + static_cast<size_t>(sz) * heightmap.width;
+        for (int c = 0; c < columns; ++c)
+        {
+            int sx = std::max(0, std::min((x0 + c) * spacing, heightmap.width - 1));
+            *out++ = row[sx];
+        }
+    }
+}
+
+} // namespace
+
+ClipmapTerrainRenderer::ClipmapTerrainRenderer(const HeightmapView& heightmap, GpuResidency& residency)
+    : heightmap_(heightmap),
+      residency_(residency),
+      shader_("shaders/clipmap_vertex.glsl", "shaders/fragment.glsl")
+{
+    initialize();
+}
+
+ClipmapTerrainRenderer::ClipmapTerrainRenderer(TileStreamer& streamer, GpuResidency& residency)
+    : streamer_(&streamer),
+      residency_(residency),
+      shader_("shaders/clipmap_vertex.glsl", "shaders/fragment.glsl")
+{
+    heightmap_.width = streamer.width();
+    heightmap_.height = streamer.height();
+    heightmap_.format = streamer.format();
+    heightmap_.range = defaultSampleRange(streamer.format());
+    initialize();
+}
+
+void ClipmapTerrainRenderer::initialize()
+{
+    // Enough levels that the coarsest covers the whole map from any camera
+    // position on it
+    int mapSize = std::max(heightmap_.width, heightmap_.height);
+    levelCount_ = 1;
+    while (levelCount_ < CLIPMAP_MAX_LEVELS &&
+           (CLIPMAP_GRID_SIZE << (levelCount_ - 1)) < 2 * mapSize)
+        ++levelCount_;
+    levels_.resize(levelCount_);
+
+    // Levels keep the samples' own depth (R8, R16 or R32F)
+    HeightTextureFormat textureFormat = heightTextureFormat(heightmap_);
+    textureType_ = textureFormat.type;
+    textureBytesPerTexel_ = textureFormat.bytesPerTexel;
+    glGenTextures(1, &heightTexture_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture_);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, textureFormat.internalFormat,
+                 CLIPMAP_TEXTURE_SIZE, CLIPMAP_TEXTURE_SIZE, levelCount_, 0,
+                 GL_RED, textureType_, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    residency_.trackTexture(textureBytes());
+
+    buildGrid();
+
+    shader_.use();
+    shader_.setInt("heightLevels", 0);
+    shader_.setVec2("heightmapSize", static_cast<float>(heightmap_.width),
+                    static_cast<float>(heightmap_.height));
+    shader_.setVec2("heightRange", textureFormat.offset, textureFormat.scale);
+    shader_.setFloat("normalStep", static_cast<float>(HEIGHTMAP_STEP));
+    shader_.setInt("gridSize", CLIPMAP_GRID_SIZE);
+    shader_.setFloat("blendWidth", static_cast<float>(CLIPMAP_BLEND_WIDTH));
+}
+
+ClipmapTerrainRenderer::~ClipmapTerrainRenderer()
+{
+    residency_.untrackTexture(textureBytes());
+    residency_.untrackBuffer(gridBytes_);
+    glDeleteTextures(1, &heightTexture_);
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &vbo_);
+    glDeleteBuffers(1, &ebo_);
+}
+
+bool ClipmapTerrainRenderer::isValid() const
+{
+    return shader_.isValid();
+}
+
+size_t ClipmapTerrainRenderer::textureBytes() const
+{
+    return static_cast<size_t>(CLIPMAP_TEXTURE_SIZE) * CLIPMAP_TEXTURE_SIZE * levelCount_ *
+           textureBytesPerTexel_;
+}
+
+// ============================================================================
+// GRID
+// ============================================================================
+
+void ClipmapTerrainRenderer::buildGrid()
+{
+    const int side = CLIPMAP_GRID_SIZE + 1;
+    std::vector<float> gridPositions;
+    gridPositions.reserve(static_cast<size_t>(side) * side * 2);
+    for (int j = 0; j < side; ++j)
+    {
+        for (int i = 0; i < side; ++i)
+        {
+            gridPositions.push_back(static_cast<float>(i));
+            gridPositions.push_back(static_cast<float>(j));
+        }
+    }
+
+    // Same triangle layout as buildChunkIndices. The diagonal runs
+    // top-right to bottom-left at every level, so a finer level blended
+    // fully into the coarser one matches it exactly.
+    std::vector<uint16_t> indices;
+    auto addQuads = [&](int holeX, int holeZ) {
+        for (int j = 0; j < CLIPMAP_GRID_SIZE; ++j)
+        {
+            for (int i = 0; i < CLIPMAP_GRID_SIZE; ++i)
+            {
+                if (holeX >= 0 &&
+                    i >= holeX && i < holeX + CLIPMAP_GRID_SIZE / 2 &&
+                    j >= holeZ && j < holeZ + CLIPMAP_GRID_SIZE / 2)
+                    continue;
+
+                uint16_t topLeft     = static_cast<uint16_t>(j * side + i);
+                uint16_t topRight    = static_cast<uint16_t>(j * side + (i + 1));
+                uint16_t bottomLeft  = static_cast<uint16_t>((j + 1) * side + i);
+                uint16_t bottomRight = static_cast<uint16_t>((j + 1) * side + (i + 1));
+                indices.insert(indices.end(), { topLeft, bottomLeft, topRight,
+                                                topRight, bottomLeft, bottomRight });
+            }
+        }
+    };
+
+    // Level 0 has no finer level inside it
+    addQuads(-1, -1);
+    fullGridIndexCount_ = indices.size();
+
+    // Coarser levels leave a hole of half their size for the finer level.
+    // Both levels snap to even texels of their own spacing, so the hole
+    // sits one of four ways: a quarter in from the low edges, plus 0 or 1.
+    for (int variant = 0; variant < 4; ++variant)
+    {
+        ringIndexOffset_[variant] = indices.size();
+        addQuads(CLIPMAP_QUARTER_GRID + (variant & 1), CLIPMAP_QUARTER_GRID + (variant >> 1));
+    }
+    ringIndexCount_ = indices.size() - ringIndexOffset_[3];
+
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glGenBuffers(1, &ebo_);
+
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, gridPositions.size() * sizeof(float),
+                 gridPositions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t),
+                 indices.data(), GL_STATIC_DRAW);
+    gridBytes_ = gridPositions.size() * sizeof(float) + indices.size() * sizeof(uint16_t);
+    residency_.trackBuffer(gridBytes_);
+
+    // Grid position attribute (location = 0), 0..CLIPMAP_GRID_SIZE
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+    glBindVertexArray(0);
+}
+
+// ============================================================================
+// TOROIDAL UPDATES
+// ============================================================================
+
+// Uploads a rectangle of level texels, splitting it where it wraps around
+// the edges of the toroidal texture. Texels past the heightmap edge repeat
+// the edge, matching the clamped vertices in the shader.
+void ClipmapTerrainRenderer::uploadRegion(int level, int x0, int z0, int width, int height)
+{
+    const int spacing = 1 << level;
+    for (int z = z0; z < z0 + height; )
+    {
+        int tz = wrapTexel(z);
+        int rows = std::min(z0 + height - z, CLIPMAP_TEXTURE_SIZE - tz);
+        for (int x = x0; x < x0 + width; )
+        {
+            int tx = wrapTexel(x);
+            int columns = std::min(x0 + width - x, CLIPMAP_TEXTURE_SIZE - tx);
+
+            staging_.resize(static_cast<size_t>(columns) * rows * textureBytesPerTexel_);
+            if (streamer_)
+            {
+                streamer_->gather(level, x, z, columns, rows, staging_.data());
+            }
+            else
+            {
+                switch (heightmap_.format)
+                {
+                case HeightmapFormat::U16:
+                    gatherLevelTexels<uint16_t>(heightmap_, x, z, columns, rows, spacing, staging_.data());
+                    break;
+                case HeightmapFormat::F32:
+                    gatherLevelTexels<float>(heightmap_, x, z, columns, rows, spacing, staging_.data());
+                    break;
+                default:
+                    gatherLevelTexels<uint8_t>(heightmap_, x, z, columns, rows, spacing, staging_.data());
+                    break;
+                }
+            }
+
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, tx, tz, level, columns, rows, 1,
+                            GL_RED, textureType_, staging_.data());
+            texelsUploaded_ += static_cast<size_t>(columns) * rows;
+            x += columns;
+        }
+        z += rows;
+    }
+}
+
+// Moves a level to a new origin, uploading only the texels that were not
+// resident before: a column strip and a row strip, together an L shape
+void ClipmapTerrainRenderer::updateLevel(int level, int originX, int originZ)
+{
+    Level& state = levels_[level];
+    const int newX = originX - 1;   // Resident region includes the normal border
+    const int newZ = originZ - 1;
+    const int oldX = state.originX - 1;
+    const int oldZ = state.originZ - 1;
+    const int dx = newX - oldX;
+    const int dz = newZ - oldZ;
+
+    if (!state.resident || std::abs(dx) >= CLIPMAP_REGION_SIZE || std::abs(dz) >= CLIPMAP_REGION_SIZE)
+    {
+        uploadRegion(level, newX, newZ, CLIPMAP_REGION_SIZE, CLIPMAP_REGION_SIZE);
+    }
+    else
+    {
+        if (dx > 0)
+            uploadRegion(level, oldX + CLIPMAP_REGION_SIZE, newZ, dx, CLIPMAP_REGION_SIZE);
+        else if (dx < 0)
+            uploadRegion(level, newX, newZ, -dx, CLIPMAP_REGION_SIZE);
+
+        // Rows, skipping the corner the column strip already covered
+        int rowX = dx > 0 ? newX : newX - dx;
+        int rowWidth = CLIPMAP_REGION_SIZE - std::abs(dx);
+        if (dz > 0)
+            uploadRegion(level, rowX, oldZ + CLIPMAP_REGION_SIZE, rowWidth, dz);
+        else if (dz < 0)
+            uploadRegion(level, rowX, newZ, rowWidth, -dz);
+    }
+
+    state.originX = originX;
+    state.originZ = originZ;
+    state.resident = true;
+}
+
+// Re-uploads the part of each level's resident region that a newly arrived
+// tile covers; it was drawn from a coarser level while the tile was missing.
+// Edge tiles also cover the clamped texels beyond the map.
+void ClipmapTerrainRenderer::refreshArrivedTiles()
+{
+    const int size = streamer_->tileSize();
+    for (const TileStreamer::TileKey& tile : streamer_->arrived())
+    {
+        if (tile.level >= levelCount_ || !levels_[tile.level].resident)
+            continue;
+        const Level& level = levels_[tile.level];
+        const int lastX = (streamer_->width() - 1 + (1 << tile.level) - 1) >> tile.level;
+        const int lastZ = (streamer_->height() - 1 + (1 << tile.level) - 1) >> tile.level;
+
+        int x0 = tile.tx == 0 ? INT32_MIN / 2 : tile.tx * size;
+        int z0 = tile.tz == 0 ? INT32_MIN / 2 : tile.tz * size;
+        int x1 = (tile.tx + 1) * size > lastX ? INT32_MAX / 2 : (tile.tx + 1) * size;
+        int z1 = (tile.tz + 1) * size > lastZ ? INT32_MAX / 2 : (tile.tz + 1) * size;
+        x0 = std::max(x0, level.originX - 1);
+        z0 = std::max(z0, level.originZ - 1);
+        x1 = std::min(x1, level.originX - 1 + CLIPMAP_REGION_SIZE);
+        z1 = std::min(z1, level.originZ - 1 + CLIPMAP_REGION_SIZE);
+        if (x0 < x1 && z0 < z1)
+            uploadRegion(tile.level, x0, z0, x1 - x0, z1 - z0);
+    }
+}
+
+// ============================================================================
+// RENDERING
+// ============================================================================
+
+void ClipmapTerrainRenderer::render(const TerrainFrame& frame)
+{
+    const float mapQuadsX = static_cast<float>(heightmap_.width - 1);
+    const float mapQuadsZ = static_cast<float>(heightmap_.height - 1);
+    const float cameraTexelX = (frame.cameraPos.x + 30.0f) / 60.0f * mapQuadsX;
+    const float cameraTexelZ = (frame.cameraPos.z + 30.0f) / 60.0f * mapQuadsZ;
+
+    // Every level snaps to even texels of its own spacing (odd texels of
+    // the next coarser level's grid would otherwise not line up)
+    texelsUploaded_ = 0;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (streamer_)
+    {
+        streamer_->beginFrame(cameraTexelX, cameraTexelZ);
+        refreshArrivedTiles();
+    }
+    for (int l = 0; l < levelCount_; ++l)
+    {
+        float spacing = static_cast<float>(2 << l);
+        int originX = 2 * static_cast<int>(std::floor(cameraTexelX / spacing)) - CLIPMAP_GRID_SIZE / 2;
+        int originZ = 2 * static_cast<int>(std::floor(cameraTexelZ / spacing)) - CLIPMAP_GRID_SIZE / 2;
+        updateLevel(l, originX, originZ);
+        if (streamer_)
+            streamer_->require(l, originX - 1, originZ - 1, CLIPMAP_REGION_SIZE, CLIPMAP_REGION_SIZE);
+    }
+    if (streamer_)
+        streamer_->endFrame();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    shader_.use();
+    shader_.setMat4("view", &frame.view[0][0]);
+    shader_.setMat4("projection", &frame.projection[0][0]);
+    shader_.setVec3("viewPos", &frame.cameraPos[0]);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(vao_);
+
+    // Finest first, so the coarse rings are mostly rejected by depth
+    levelsDrawn_ = 0;
+    for (int l = 0; l < levelCount_; ++l)
+    {
+        const Level& level = levels_[l];
+        const int spacing = 1 << l;
+
+        // Levels that miss the map or the frustum are skipped; a coarser
+        // level's hole only ever hides area a finer level would have drawn
+        float x0 = std::max(0.0f, static_cast<float>(level.originX * spacing));
+        float z0 = std::max(0.0f, static_cast<float>(level.originZ * spacing));
+        float x1 = std::min(mapQuadsX, static_cast<float>((level.originX + CLIPMAP_GRID_SIZE) * spacing));
+        float z1 = std::min(mapQuadsZ, static_cast<float>((level.originZ + CLIPMAP_GRID_SIZE) * spacing));
+        if (x0 >= x1 || z0 >= z1)
+            continue;
+        glm::vec3 boundsMin(x0 / mapQuadsX * 60.0f - 30.0f, 0.0f, z0 / mapQuadsZ * 60.0f - 30.0f);
+        glm::vec3 boundsMax(x1 / mapQuadsX * 60.0f - 30.0f, HEIGHT_SCALE, z1 / mapQuadsZ * 60.0f - 30.0f);
+        if (!aabbInFrustum(frame.frustum, boundsMin, boundsMax))
+            continue;
+
+        shader_.setInt("level", l);
+        shader_.setInt("levelOriginX", level.originX);
+        shader_.setInt("levelOriginZ", level.originZ);
+        shader_.setFloat("levelSpacing", static_cast<float>(spacing));
+        shader_.setInt("blendToCoarser", l + 1 < levelCount_ ? 1 : 0);
+
+        if (l == 0)
+        {
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(fullGridIndexCount_),
+                           GL_UNSIGNED_SHORT, (void*)0);
+        }
+        else
+        {
+            // Where the finer level's hole sits inside this one
+            const Level& finer = levels_[l - 1];
+            int holeX = finer.originX / 2 - level.originX - CLIPMAP_QUARTER_GRID;
+            int holeZ = finer.originZ / 2 - level.originZ - CLIPMAP_QUARTER_GRID;
+            int variant = holeX + 2 * holeZ;
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(ringIndexCount_), GL_UNSIGNED_SHORT,
+                           (void*)(ringIndexOffset_[variant] * sizeof(uint16_t)));
+        }
+        ++levelsDrawn_;
+    }
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+std::string ClipmapTerrainRenderer::stats() const
+{
+    std::string text = "clipmap levels " + std::to_string(levelsDrawn_) + " / " +
+                       std::to_string(levelCount_) + ", uploaded " +
+                       std::to_string(texelsUploaded_) + " texels";
+    if (streamer_)
+        text += ", tiles " + std::to_string(streamer_->residentTiles()) + " (" +
+                std::to_string(streamer_->residentBytes() >> 20) + " MB), pending " +
+                std::to_string(streamer_->pendingTiles());
+    return text;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "gpu_residency.h"
+#include "heightmap.h"
+#include "shader.h"
+#include "terrain_renderer.h"
+#include "tile_streamer.h"
+
+// ============================================================================
+// CLIPMAP SETTINGS
+// ============================================================================
+
+// Quads per side of every clipmap level. Must be a multiple of 4 so a level
+// covers exactly half of the next coarser one, and leave room for the
+// one-texel normal border in the toroidal texture.
+const int CLIPMAP_GRID_SIZE = 252;
+
+// Side of each level's toroidal height texture (power of two)
+const int CLIPMAP_TEXTURE_SIZE = 256;
+
+// Upper limit on levels; 252 << 9 texels covers a 128k heightmap
+const int CLIPMAP_MAX_LEVELS = 10;
+
+// Width, in level quads, of the band along each level's outer edge where
+// heights blend into the next coarser level
+const int CLIPMAP_BLEND_WIDTH = 24;
+
+static_assert(CLIPMAP_GRID_SIZE % 4 == 0, "Clipmap grid must be a multiple of 4");
+static_assert(CLIPMAP_GRID_SIZE + 3 <= CLIPMAP_TEXTURE_SIZE,
+              "Clipmap texture must hold the grid plus a one-texel border");
+
+// ============================================================================
+// GEOMETRY CLIPMAP
+// ============================================================================
+
+// Geometry clipmaps (Losasso & Hoppe 2004). Level l is a fixed grid of
+// CLIPMAP_GRID_SIZE quads spaced 2^l heightmap texels apart, centred on the
+// camera. Each level's heights live in one layer of a small texture array
+// addressed toroidally, so when the camera moves only the newly exposed
+// L-shaped strips are uploaded. Per-frame cost and GPU memory depend on the
+// level count, not on the heightmap size.
+class ClipmapTerrainRenderer : public TerrainRenderer
+{
+public:
+    // heightmap must outlive the renderer; strips are read from it as the
+    // camera moves. The textures and grid count against residency's budget.
+    ClipmapTerrainRenderer(const HeightmapView& heightmap, GpuResidency& residency);
+
+    // Out-of-core: strips are read from tiles paged in by the streamer, and
+    // regions drawn from a coarser stand-in are re-uploaded as the real
+    // tiles arrive. streamer must outlive the renderer.
+    ClipmapTerrainRenderer(TileStreamer& streamer, GpuResidency& residency);
+    ~ClipmapTerrainRenderer() override;
+
+    bool isValid() const override;
+    void render(const TerrainFrame& frame) override;
+    std::string stats() const override;
+
+    int levelCount() const { return levelCount_; }
+    size_t textureBytes() const;
+
+private:
+    struct Level
+    {
+        int originX = 0;    // Level texel coordinate of grid vertex (0, 0)
+        int originZ = 0;
+        bool resident = false;
+    };
+
+    void initialize();
+    void buildGrid();
+    void refreshArrivedTiles();
+    void updateLevel(int level, int originX, int originZ);
+    void uploadRegion(int level, int x0, int z0, int width, int height);
+
+    HeightmapView heightmap_;           // No samples when streaming
+    TileStreamer* streamer_ = nullptr;
+    int levelCount_ = 0;
+    std::vector<Level> levels_;
+
+    GpuResidency& residency_;
+    Shader shader_;
+    unsigned int heightTexture_ = 0;
+    unsigned int textureType_ = 0;      // GL type of the staged samples
+    size_t textureBytesPerTexel_ = 1;
+    unsigned int vao_ = 0;
+    unsigned int vbo_ = 0;
+    unsigned int ebo_ = 0;
+    size_t gridBytes_ = 0;
+
+    // Index ranges in ebo_: the full grid for level 0, then the ring for
+    // each of the four positions the finer level's hole can take
+    size_t fullGridIndexCount_ = 0;
+    size_t ringIndexOffset_[4] = {};
+    size_t ringIndexCount_ = 0;
+
+    std::vector<unsigned char> staging_;
+    size_t texelsUploaded_ = 0;     // Last frame
+    int levelsDrawn_ = 0;
+};
@@ -0,0 +1,347 @@
+#include "collision_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "cpu_features.h"
+#include "sample_rows.h"
+#include "terrain_mesh.h"
+
+namespace {
+
+// Heights of one row, converted exactly as the mesh generator converts them
+void convertRow(const HeightmapView& heightmap, int z, float* out)
+{
+    size_t rowStart = static_cast<size_t>(z) * heightmap.width;
+    switch (heightmap.format)
+    {
+    case HeightmapFormat::U16:
+        convertSampleRow(heightmap.samples<uint16_t>() + rowStart, 1, heightmap.width,
+                         heightmap.range, HEIGHT_SCALE, out);
+        break;
+    case HeightmapFormat::F32:
+        convertSampleRow(heightmap.samples<float>() + rowStart, 1, heightmap.width,
+                         heightmap.range, HEIGHT_SCALE, out);
+        break;
+    default:
+        convertSampleRow(heightmap.samples<uint8_t>() + rowStart, 1, heightmap.width,
+                         heightmap.range, HEIGHT_SCALE, out);
+        break;
+    }
+}
+
+} // namespace
+
+CollisionGrid::CollisionGrid(const HeightmapView& heightmap)
+    : width_(heightmap.width),
+      height_(heightmap.height),
+      tilesX_((heightmap.width + COLLISION_TILE_SIZE - 1) / COLLISION_TILE_SIZE)
+{
+    if (!heightmap.data || width_ < 2 || height_ < 2)
+        return;
+
+    // First pass finds the range the 16-bit samples cover
+    std::vector<float> row(width_);
+    float lowest = 0.0f;
+    float highest = 0.0f;
+    for (int z = 0; z < height_; ++z)
+    {
+        convertRow(heightmap, z, row.data());
+        auto range = std::minmax_element(row.begin(), row.end());
+        lowest = z == 0 ? *range.first : std::min(lowest, *range.first);
+        highest = z == 0 ? *range.second : std::max(highest, *range.second);
+    }
+    offset_ = lowest;
+    scale_ = highest > lowest ? (highest - lowest) / 65535.0f : 0.0f;
+    const float toSample = scale_ > 0.0f ? 1.0f / scale_ : 0.0f;
+
+    // Partial tiles on the right and bottom edges are padded. One spare
+    // sample at the end lets the AVX2 kernel gather 32 bits at any sample.
+    const int tilesZ = (height_ + COLLISION_TILE_SIZE - 1) / COLLISION_TILE_SIZE;
+    samples_.assign(static_cast<size_t>(tilesX_) * tilesZ * COLLISION_TILE_SIZE * COLLISION_TILE_SIZE + 1, 0);
+    for (int z = 0; z < height_; ++z)
+    {
+        convertRow(heightmap, z, row.data());
+        for (int x = 0; x < width_; ++x)
+        {
+            float sample = std::round((row[x] - offset_) * toSample);
+            samples_[sampleIndex(x, z)] = static_cast<uint16_t>(std::max(0.0f, std::min(sample, 65535.0f)));
+        }
+    }
+}
+
+float CollisionGrid::heightAt(float worldX, float worldZ) const
+{
+    if (samples_.empty()) return 0.0f;
+
+    float gx = (worldX + 30.0f) / 60.0f * (width_ - 1);
+    float gz = (worldZ + 30.0f) / 60.0f * (height_ - 1);
+    if (gx < 0 || gx >= width_ - 1 || gz < 0 || gz >= height_ - 1)
+        return 0.0f;  // Outside terrain bounds
+
+    int x0 = static_cast<int>(gx);
+    int z0 = static_cast<int>(gz);
+    float fx = gx - x0;
+    float fz = gz - z0;
+
+    float h0 = sampleHeight(x0, z0) * (1 - fx) + sampleHeight(x0 + 1, z0) * fx;
+    float h1 = sampleHeight(x0, z0 + 1) * (1 - fx) + sampleHeight(x0 + 1, z0 + 1) * fx;
+    return h0 * (1 - fz) + h1 * fz;
+}
+
+// ============================================================================
+// BATCH QUERIES
+// ============================================================================
+
+namespace {
+
+struct NormalOutput
+{
+    float* x;
+    float* y;
+    float* z;
+};
+
+// One query the way heightAt does it, plus the bilinear surface normal
+void queryScalar(const CollisionGrid& grid, float worldX, float worldZ, size_t i,
+                 float* heights, const NormalOutput& normals)
+{
+    const int width = grid.width();
+    const int height = grid.height();
+    float gx = (worldX + 30.0f) / 60.0f * (width - 1);
+    float gz = (worldZ + 30.0f) / 60.0f * (height - 1);
+    if (!(gx >= 0 && gx < width - 1 && gz >= 0 && gz < height - 1))
+    {
+        heights[i] = 0.0f;
+        if (normals.x)
+        {
+            normals.x[i] = 0.0f;
+            normals.y[i] = 1.0f;
+            normals.z[i] = 0.0f;
+        }
+        return;
+    }
+
+    int x0 = static_cast<int>(gx);
+    int z0 = static_cast<int>(gz);
+    float fx = gx - x0;
+    float fz = gz - z0;
+    float h00 = grid.sampleHeight(x0, z0);
+    float h10 = grid.sampleHeight(x0 + 1, z0);
+    float h01 = grid.sampleHeight(x0, z0 + 1);
+    float h11 = grid.sampleHeight(x0 + 1, z0 + 1);
+
+    float h0 = h00 * (1 - fx) + h10 * fx;
+    float h1 = h01 * (1 - fx) + h11 * fx;
+    heights[i] = h0 * (1 - fz) + h1 * fz;
+
+    if (normals.x)
+    {
+        // Height slope per world unit along X and Z
+        float slopeX = ((h10 - h00) * (1 - fz) + (h11 - h01) * fz) * ((width - 1) / 60.0f);
+        float slopeZ = (h1 - h0) * ((height - 1) / 60.0f);
+        float inverseLength = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+        normals.x[i] = -slopeX * inverseLength;
+        normals.y[i] = inverseLength;
+        normals.z[i] = -slopeZ * inverseLength;
+    }
+}
+
+void heightsScalar(const CollisionGrid& grid, const float* worldX, const float* worldZ, size_t count,
+                   float* heights, const NormalOutput& normals)
+{
+    for (size_t i = 0; i < count; ++i)
+        queryScalar(grid, worldX[i], worldZ[i], i, heights, normals);
+}
+
+#if TERRAIN_X86
+
+// Tiled index of (x, z), as CollisionGrid::sampleIndex
+TERRAIN_TARGET("avx2")
+inline __m256i tiledIndex(__m256i x, __m256i z, __m256i tilesX)
+{
+    const __m256i inTile = _mm256_set1_epi32(COLLISION_TILE_SIZE - 1);
+    __m256i tile = _mm256_add_epi32(
+        _mm256_mullo_epi32(_mm256_srli_epi32(z, COLLISION_TILE_SHIFT), tilesX),
+        _mm256_srli_epi32(x, COLLISION_TILE_SHIFT));
+    __m256i local = _mm256_add_epi32(
+        _mm256_slli_epi32(_mm256_and_si256(z, inTile), COLLISION_TILE_SHIFT),
+        _mm256_and_si256(x, inTile));
+    return _mm256_add_epi32(_mm256_slli_epi32(tile, 2 * COLLISION_TILE_SHIFT), local);
+}
+
+// 32-bit gather at 16-bit sample indices; the low half is the sample
+TERRAIN_TARGET("avx2")
+inline __m256 gatherSamples(const uint16_t* samples, __m256i index)
+{
+    __m256i pairs = _mm256_i32gather_epi32(reinterpret_cast<const int*>(samples), index, 2);
+    return _mm256_cvtepi32_ps(_mm256_and_si256(pairs, _mm256_set1_epi32(0xFFFF)));
+}
+
+TERRAIN_TARGET("avx2")
+void heightsAVX2(const CollisionGrid& grid, const float* worldX, const float* worldZ, size_t count,
+                 float* heights, const NormalOutput& normals)
+{
+    const int width = grid.width();
+    const int height = grid.height();
+    const __m256 offset = _mm256_set1_ps(30.0f);
+    const __m256 worldSize = _mm256_set1_ps(60.0f);
+    const __m256 gridSizeX = _mm256_set1_ps(static_cast<float>(width - 1));
+    const __m256 gridSizeZ = _mm256_set1_ps(static_cast<float>(height - 1));
+    const __m256 toGridX = _mm256_set1_ps((width - 1) / 60.0f);
+    const __m256 toGridZ = _mm256_set1_ps((height - 1) / 60.0f);
+    const __m256 lastCellX = _mm256_set1_ps(static_cast<float>(width - 2));
+    const __m256 lastCellZ = _mm256_set1_ps(static_cast<float>(height - 2));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(grid.scale());
+    const __m256 heightOffset = _mm256_set1_ps(grid.offset());
+    const __m256i tilesX = _mm256_set1_epi32(grid.tilesX());
+    const __m256i oneInt = _mm256_set1_epi32(1);
+    const uint16_t* samples = grid.samples();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // Divided then scaled, exactly as queryScalar does, so points on a
+        // cell edge pick the same cell (the normal is not continuous there)
+        __m256 gx = _mm256_mul_ps(_mm256_div_ps(_mm256_add_ps(_mm256_loadu_ps(worldX + i), offset),
+                                                worldSize), gridSizeX);
+        __m256 gz = _mm256_mul_ps(_mm256_div_ps(_mm256_add_ps(_mm256_loadu_ps(worldZ + i), offset),
+                                                worldSize), gridSizeZ);
+
+        // Same bounds as heightAt; NaN compares false and lands outside
+        __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(gx, zero, _CMP_GE_OQ), _mm256_cmp_ps(gx, gridSizeX, _CMP_LT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(gz, zero, _CMP_GE_OQ), _mm256_cmp_ps(gz, gridSizeZ, _CMP_LT_OQ)));
+
+        // Lanes outside are clamped so their gathers stay in the grid; max
+        // returns its second operand for NaN
+        __m256 cellX = _mm256_floor_ps(_mm256_min_ps(_mm256_max_ps(gx, zero), lastCellX));
+        __m256 cellZ = _mm256_floor_ps(_mm256_min_ps(_mm256_max_ps(gz, zero), lastCellZ));
+        __m256 fx = _mm256_sub_ps(gx, cellX);
+        __m256 fz = _mm256_sub_ps(gz, cellZ);
+        __m256i x0 = _mm256_cvttps_epi32(cellX);
+        __m256i z0 = _mm256_cvttps_epi32(cellZ);
+        __m256i x1 = _mm256_add_epi32(x0, oneInt);
+        __m256i z1 = _mm256_add_epi32(z0, oneInt);
+
+        __m256 h00 = gatherSamples(samples, tiledIndex(x0, z0, tilesX));
+        __m256 h10 = gatherSamples(samples, tiledIndex(x1, z0, tilesX));
+        __m256 h01 = gatherSamples(samples, tiledIndex(x0, z1, tilesX));
+        __m256 h11 = gatherSamples(samples, tiledIndex(x1, z1, tilesX));
+
+        // Interpolated in sample units, scaled once at the end
+        __m256 dx0 = _mm256_sub_ps(h10, h00);
+        __m256 dx1 = _mm256_sub_ps(h11, h01);
+        __m256 h0 = _mm256_add_ps(h00, _mm256_mul_ps(dx0, fx));
+        __m256 h1 = _mm256_add_ps(h01, _mm256_mul_ps(dx1, fx));
+        __m256 dz = _mm256_sub_ps(h1, h0);
+        __m256 h = _mm256_add_ps(h0, _mm256_mul_ps(dz, fz));
+        h = _mm256_add_ps(_mm256_mul_ps(h, scale), heightOffset);
+        _mm256_storeu_ps(heights + i, _mm256_and_ps(h, inside));
+
+        if (normals.x)
+        {
+            __m256 dx = _mm256_add_ps(dx0, _mm256_mul_ps(_mm256_sub_ps(dx1, dx0), fz));
+            __m256 slopeX = _mm256_and_ps(_mm256_mul_ps(_mm256_mul_ps(dx, scale), toGridX), inside);
+            __m256 slopeZ = _mm256_and_ps(_mm256_mul_ps(_mm256_mul_ps(dz, scale), toGridZ), inside);
+            __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(slopeX, slopeX), one),
+                                            _mm256_mul_ps(slopeZ, slopeZ));
+            __m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSq));
+            _mm256_storeu_ps(normals.x + i, _mm256_mul_ps(_mm256_sub_ps(zero, slopeX), inverseLength));
+            _mm256_storeu_ps(normals.y + i, inverseLength);
+            _mm256_storeu_ps(normals.z + i, _mm256_mul_ps(_mm256_sub_ps(zero, slopeZ), inverseLength));
+        }
+    }
+
+    for (; i < count; ++i)
+        queryScalar(grid, worldX[i], worldZ[i], i, heights, normals);
+}
+
+#endif // TERRAIN_X86
+
+using HeightQueryFn = void (*)(const CollisionGrid&, const float*, const float*, size_t, float*,
+                               const NormalOutput&);
+
+HeightQueryFn kernelFunction(HeightQueryKernel kernel)
+{
+    switch (kernel)
+    {
+#if TERRAIN_X86
+    case HeightQueryKernel::AVX2: return heightsAVX2;
+#endif
+    default:                      return heightsScalar;
+    }
+}
+
+HeightQueryKernel detectHeightQueryKernel()
+{
+    if (cpuHasAVX2()) return HeightQueryKernel::AVX2;
+    return HeightQueryKernel::Scalar;
+}
+
+const HeightQueryKernel g_activeKernel = detectHeightQueryKernel();
+const HeightQueryFn g_activeQueryFn = kernelFunction(g_activeKernel);
+
+// An empty grid answers 0 everywhere, like heightAt
+void fillFlatHeights(size_t count, float* heights, float* normalX, float* normalY, float* normalZ)
+{
+    std::fill(heights, heights + count, 0.0f);
+    if (normalX)
+    {
+        std::fill(normalX, normalX + count, 0.0f);
+        std::fill(normalY, normalY + count, 1.0f);
+        std::fill(normalZ, normalZ + count, 0.0f);
+    }
+}
+
+} // namespace
+
+HeightQueryKernel activeHeightQueryKernel()
+{
+    return g_activeKernel;
+}
+
+bool heightQueryKernelSupported(HeightQueryKernel kernel)
+{
+    switch (kernel)
+    {
+    case HeightQueryKernel::AVX2: return cpuHasAVX2();
+    default:                      return true;
+    }
+}
+
+const char* heightQueryKernelName(HeightQueryKernel kernel)
+{
+    switch (kernel)
+    {
+    case HeightQueryKernel::AVX2: return "AVX2";
+    default:                      return "scalar";
+    }
+}
+
+void CollisionGrid::heightsAt(const float* worldX, const float* worldZ, size_t count, float* heights,
+                              float* normalX, float* normalY, float* normalZ) const
+{
+    if (samples_.empty())
+    {
+        fillFlatHeights(count, heights, normalX, normalY, normalZ);
+        return;
+    }
+    NormalOutput normals = { normalX, normalY, normalZ };
+    g_activeQueryFn(*this, worldX, worldZ, count, heights, normals);
+}
+
+void CollisionGrid::heightsAtWith(HeightQueryKernel kernel, const float* worldX, const float* worldZ,
+                                  size_t count, float* heights,
+                                  float* normalX, float* normalY, float* normalZ) const
+{
+    if (samples_.empty())
+    {
+        fillFlatHeights(count, heights, normalX, normalY, normalZ);
+        return;
+    }
+    NormalOutput normals = { normalX, normalY, normalZ };
+    kernelFunction(kernel)(*this, worldX, worldZ, count, heights, normals);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "heightmap.h"
+
+// ============================================================================
+// COLLISION SETTINGS
+// ============================================================================
+
+// Samples per tile side. Tiles are stored one after another, so the four
+// taps of a height query almost always share a 128-byte tile. Power of two.
+const int COLLISION_TILE_SIZE = 8;
+const int COLLISION_TILE_SHIFT = 3;
+
+// ============================================================================
+// COLLISION HEIGHT GRID
+// ============================================================================
+
+enum class HeightQueryKernel
+{
+    Scalar,
+    AVX2        // 8 queries per instruction, corner samples gathered
+};
+
+HeightQueryKernel activeHeightQueryKernel();
+bool heightQueryKernelSupported(HeightQueryKernel kernel);
+const char* heightQueryKernelName(HeightQueryKernel kernel);
+
+// Heights for camera collision, kept apart from the render data so the mesh
+// can be freed once it is on the GPU. Heights are quantized to 16 bits over
+// the grid's own height range:
+//     height = sample * scale + offset
+// Queries use the same -30..30 world mapping and bilinear filter as
+// heightmapHeightAt. The grid is never modified after construction, so any
+// number of threads can query it at once.
+class CollisionGrid
+{
+public:
+    CollisionGrid() = default;
+
+    // Copies the heightmap's samples; the view is not used afterwards
+    explicit CollisionGrid(const HeightmapView& heightmap);
+
+    bool isValid() const { return !samples_.empty(); }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    float scale() const { return scale_; }
+    float offset() const { return offset_; }
+    size_t bytes() const { return samples_.size() * sizeof(uint16_t); }
+
+    // Tiled storage: tile (x >> SHIFT, z >> SHIFT) in row-major tile order,
+    // then row-major inside the tile
+    const uint16_t* samples() const { return samples_.data(); }
+    int tilesX() const { return tilesX_; }
+    size_t sampleIndex(int x, int z) const
+    {
+        size_t tile = static_cast<size_t>(z >> COLLISION_TILE_SHIFT) * tilesX_ + (x >> COLLISION_TILE_SHIFT);
+        return (tile << (2 * COLLISION_TILE_SHIFT)) +
+               ((z & (COLLISION_TILE_SIZE - 1)) << COLLISION_TILE_SHIFT) + (x & (COLLISION_TILE_SIZE - 1));
+    }
+
+    float sampleHeight(int x, int z) const { return samples_[sampleIndex(x, z)] * scale_ + offset_; }
+
+    // Bilinear world-space height; 0 outside the grid
+    float heightAt(float worldX, float worldZ) const;
+
+    // Batch form for many queries at once: heights[i] = heightAt(worldX[i],
+    // worldZ[i]). If normal arrays are given they receive the normal of the
+    // bilinear surface at each point, (0, 1, 0) outside the grid. Heights
+    // may differ from heightAt in the last bits.
+    void heightsAt(const float* worldX, const float* worldZ, size_t count, float* heights,
+                   float* normalX = nullptr, float* normalY = nullptr, float* normalZ = nullptr) const;
+    void heightsAtWith(HeightQueryKernel kernel, const float* worldX, const float* worldZ,
+                       size_t count, float* heights,
+                       float* normalX = nullptr, float* normalY = nullptr, float* normalZ = nullptr) const;
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    int tilesX_ = 0;
+    float scale_ = 0.0f;
+    float offset_ = 0.0f;
+    std::vector<uint16_t> samples_;
+};
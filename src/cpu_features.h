@@ -0,0 +1,52 @@
+#pragma once
+
+// Runtime CPU feature detection for the SIMD kernels.
+// Kernels are compiled per function with TERRAIN_TARGET(...) so the rest of
+// the build keeps the baseline instruction set.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TERRAIN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#else
+#define TERRAIN_X86 0
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TERRAIN_TARGET(isa)
+#else
+#define TERRAIN_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+inline bool cpuHasSSE42()
+{
+#if !TERRAIN_X86
+    return false;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    __builtin_cpu_init();  // May run from a static initializer
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+inline bool cpuHasAVX2()
+{
+#if !TERRAIN_X86
+    return false;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    bool hasAvx = (info[2] & (1 << 28)) != 0;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && hasAvx && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
@@ -0,0 +1,252 @@
+#include "displaced.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glad/gl.h>
+
+#include "height_texture.h"
+#include "sample_rows.h"
+
+namespace {
+
+// Height range and relief of one chunk, read from every texel it covers at
+// full resolution, since tess_eval.glsl samples between the grid vertices
+template <typename Sample>
+void scanChunk(const HeightmapView& heightmap, int gridWidth, int gridHeight,
+               DisplacedChunk& chunk, float& minHeight, float& maxHeight)
+{
+    // Grid quads are not a whole number of texels wide; each one takes
+    // every texel it touches
+    const float texelsX = static_cast<float>(heightmap.width - 1) / (gridWidth - 1);
+    const float texelsZ = static_cast<float>(heightmap.height - 1) / (gridHeight - 1);
+    auto firstTexel = [](int quad, float texels) { return static_cast<int>(std::floor(quad * texels)); };
+    auto lastTexel = [](int quad, float texels, int size) {
+        return std::min(static_cast<int>(std::ceil((quad + 1) * texels)), size - 1);
+    };
+
+    const int x0 = firstTexel(chunk.originX, texelsX);
+    const int x1 = lastTexel(chunk.originX + chunk.quadsX - 1, texelsX, heightmap.width);
+    const int count = x1 - x0 + 1;
+
+    thread_local std::vector<float> row;
+    thread_local std::vector<float> quadLow;
+    thread_local std::vector<float> quadHigh;
+    row.resize(count);
+    quadLow.resize(chunk.quadsX);
+    quadHigh.resize(chunk.quadsX);
+
+    minHeight = HEIGHT_SCALE;
+    maxHeight = 0.0f;
+    chunk.relief = 0.0f;
+
+    // Quads share their border texels, so the rows between two quad rows
+    // are read by both
+    for (int lj = 0; lj < chunk.quadsZ; ++lj)
+    {
+        std::fill(quadLow.begin(), quadLow.end(), HEIGHT_SCALE);
+        std::fill(quadHigh.begin(), quadHigh.end(), 0.0f);
+        const int z0 = firstTexel(chunk.originZ + lj, texelsZ);
+        const int z1 = lastTexel(chunk.originZ + lj, texelsZ, heightmap.height);
+        for (int z = z0; z <= z1; ++z)
+        {
+            const Sample* samples =
+                heightmap.samples<Sample>() + static_cast<size_t>(z) * heightmap.width + x0;
+            convertSampleRow(samples, 1, count, heightmap.range, HEIGHT_SCALE, row.data());
+            for (int li = 0; li < chunk.quadsX; ++li)
+            {
+                const int a = firstTexel(chunk.originX + li, texelsX) - x0;
+                const int b = lastTexel(chunk.originX + li, texelsX, heightmap.width) - x0;
+                for (int x = a; x <= b; ++x)
+                {
+                    quadLow[li] = std::min(quadLow[li], row[x]);
+                    quadHigh[li] = std::max(quadHigh[li], row[x]);
+                }
+            }
+        }
+
+        for (int li = 0; li < chunk.quadsX; ++li)
+        {
+            minHeight = std::min(minHeight, quadLow[li]);
+            maxHeight = std::max(maxHeight, quadHigh[li]);
+            chunk.relief = std::max(chunk.relief, quadHigh[li] - quadLow[li]);
+        }
+    }
+}
+
+} // namespace
+
+DisplacedTerrainRenderer::DisplacedTerrainRenderer(const HeightmapView& heightmap, ThreadPool& pool,
+                                                   GpuResidency& residency)
+    : width_(heightmap.width),
+      height_(heightmap.height),
+      gridWidth_(heightmap.width / HEIGHTMAP_STEP),
+      gridHeight_(heightmap.height / HEIGHTMAP_STEP),
+      residency_(residency),
+      shader_("shaders/vertex_displaced.glsl", "shaders/fragment.glsl",
+              "shaders/tess_control.glsl", "shaders/tess_eval.glsl")
+{
+    buildChunks(heightmap, pool);
+
+    // The whole heightmap in one upload, at the samples' own width. Linear
+    // filtering lets tessellated vertices and normal taps land between texels.
+    HeightTextureFormat textureFormat = heightTextureFormat(heightmap);
+    textureBytesPerTexel_ = textureFormat.bytesPerTexel;
+    glGenTextures(1, &heightTexture_);
+    glBindTexture(GL_TEXTURE_2D, heightTexture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, textureFormat.internalFormat, width_, height_, 0,
+                 GL_RED, textureFormat.type, heightmap.data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    residency_.trackTexture(textureBytes());
+
+    // The mesh backend's shared chunk indices; with no vertex attributes
+    // the VAO holds only this
+    std::vector<uint16_t> indices = buildTerrainChunkIndices();
+    indexCount_ = indices.size();
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &ebo_);
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes(), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    residency_.trackBuffer(indexBytes());
+
+    shader_.use();
+    shader_.setInt("gridWidth", gridWidth_);
+    shader_.setInt("gridHeight", gridHeight_);
+    shader_.setInt("heightmap", 0);
+    shader_.setVec2("heightmapSize", static_cast<float>(width_), static_cast<float>(height_));
+    shader_.setVec2("heightRange", textureFormat.offset, textureFormat.scale);
+    shader_.setFloat("normalStep", static_cast<float>(HEIGHTMAP_STEP));
+    shader_.setInt("displaceFromTexture", 1);
+}
+
+DisplacedTerrainRenderer::~DisplacedTerrainRenderer()
+{
+    residency_.untrackTexture(textureBytes());
+    residency_.untrackBuffer(indexBytes());
+    glDeleteTextures(1, &heightTexture_);
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &ebo_);
+}
+
+bool DisplacedTerrainRenderer::isValid() const
+{
+    return shader_.isValid();
+}
+
+size_t DisplacedTerrainRenderer::textureBytes() const
+{
+    return static_cast<size_t>(width_) * height_ * textureBytesPerTexel_;
+}
+
+size_t DisplacedTerrainRenderer::indexBytes() const
+{
+    return indexCount_ * sizeof(uint16_t);
+}
+
+// Same chunk layout as generateTerrainMesh; the bounds come from the texels
+// instead of the vertices
+void DisplacedTerrainRenderer::buildChunks(const HeightmapView& heightmap, ThreadPool& pool)
+{
+    const int chunksX = std::max(1, (gridWidth_ - 1 + TERRAIN_CHUNK_QUADS - 1) / TERRAIN_CHUNK_QUADS);
+    const int chunksZ = std::max(1, (gridHeight_ - 1 + TERRAIN_CHUNK_QUADS - 1) / TERRAIN_CHUNK_QUADS);
+    chunks_.resize(static_cast<size_t>(chunksX) * chunksZ);
+    for (int cz = 0; cz < chunksZ; ++cz)
+    {
+        for (int cx = 0; cx < chunksX; ++cx)
+        {
+            DisplacedChunk& chunk = chunks_[cz * chunksX + cx];
+            chunk.originX = cx * TERRAIN_CHUNK_QUADS;
+            chunk.originZ = cz * TERRAIN_CHUNK_QUADS;
+            chunk.quadsX = std::min(TERRAIN_CHUNK_QUADS, gridWidth_ - 1 - chunk.originX);
+            chunk.quadsZ = std::min(TERRAIN_CHUNK_QUADS, gridHeight_ - 1 - chunk.originZ);
+            chunk.indexCount = static_cast<unsigned int>(chunk.quadsZ * TERRAIN_CHUNK_QUADS * 6);
+        }
+    }
+
+    std::vector<float> minHeights(chunks_.size());
+    std::vector<float> maxHeights(chunks_.size());
+    pool.parallelFor(static_cast<int>(chunks_.size()), [&](int c) {
+        switch (heightmap.format)
+        {
+        case HeightmapFormat::U16:
+            scanChunk<uint16_t>(heightmap, gridWidth_, gridHeight_, chunks_[c],
+                            minHeights[c], maxHeights[c]);
+            break;
+        case HeightmapFormat::F32:
+            scanChunk<float>(heightmap, gridWidth_, gridHeight_, chunks_[c],
+                            minHeights[c], maxHeights[c]);
+            break;
+        default:
+            scanChunk<uint8_t>(heightmap, gridWidth_, gridHeight_, chunks_[c],
+                            minHeights[c], maxHeights[c]);
+            break;
+        }
+    });
+
+    // Padded by the detail noise tess_eval.glsl adds on top
+    const float worldX = 60.0f / (gridWidth_ - 1);
+    const float worldZ = 60.0f / (gridHeight_ - 1);
+    for (size_t c = 0; c < chunks_.size(); ++c)
+    {
+        const DisplacedChunk& chunk = chunks_[c];
+        chunkBounds_.push(
+            glm::vec3(chunk.originX * worldX - 30.0f, minHeights[c] - TERRAIN_DISPLACEMENT_BOUND,
+                      chunk.originZ * worldZ - 30.0f),
+            glm::vec3((chunk.originX + chunk.quadsX) * worldX - 30.0f,
+                      maxHeights[c] + TERRAIN_DISPLACEMENT_BOUND,
+                      (chunk.originZ + chunk.quadsZ) * worldZ - 30.0f));
+    }
+    visibleChunks_.reserve(chunks_.size());
+}
+
+void DisplacedTerrainRenderer::render(const TerrainFrame& frame)
+{
+    shader_.use();
+
+    glm::mat4 model = glm::mat4(1.0f);
+    shader_.setMat4("model", &model[0][0]);
+    shader_.setMat4("view", &frame.view[0][0]);
+    shader_.setMat4("projection", &frame.projection[0][0]);
+    shader_.setVec3("viewPos", &frame.cameraPos[0]);
+
+    shader_.setVec4Array("frustumPlanes", 6, &frame.frustum.planes[0][0]);
+    shader_.setInt("patchCulling", frame.patchCulling ? 1 : 0);
+    shader_.setInt("tessMode", frame.screenSpaceTessellation ? 1 : 0);
+    shader_.setVec2("viewportSize", static_cast<float>(frame.viewportWidth),
+                    static_cast<float>(frame.viewportHeight));
+    shader_.setFloat("targetPixelsPerEdge", frame.targetPixelsPerEdge);
+
+    visibleChunks_.clear();
+    cullAabbs(frame.frustum, chunkBounds_, visibleChunks_);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, heightTexture_);
+    glPatchParameteri(GL_PATCH_VERTICES, 3);
+    glBindVertexArray(vao_);
+    for (uint32_t chunkIndex : visibleChunks_)
+    {
+        // Tessellated vertices can rise or fall from the patch corners by
+        // up to the chunk's relief, so patch culling pads by that
+        const DisplacedChunk& chunk = chunks_[chunkIndex];
+        shader_.setInt("chunkOriginX", chunk.originX);
+        shader_.setInt("chunkOriginZ", chunk.originZ);
+        shader_.setFloat("displacementBound", chunk.relief + TERRAIN_DISPLACEMENT_BOUND);
+        glDrawElements(GL_PATCHES, static_cast<GLsizei>(chunk.indexCount),
+                       GL_UNSIGNED_SHORT, (void*)0);
+    }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+std::string DisplacedTerrainRenderer::stats() const
+{
+    return "displaced chunks visible " + std::to_string(visibleChunks_.size()) + " / " +
+           std::to_string(chunks_.size());
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum_culling.h"
+#include "gpu_residency.h"
+#include "heightmap.h"
+#include "shader.h"
+#include "terrain_mesh.h"
+#include "terrain_renderer.h"
+#include "thread_pool.h"
+
+// ============================================================================
+// DISPLACED GRID TERRAIN
+// ============================================================================
+
+// One chunk of the flat grid: the same layout as a mesh chunk, without any
+// vertices behind it
+struct DisplacedChunk
+{
+    int originX;                // Grid coordinate of local vertex (0, 0)
+    int originZ;
+    int quadsX;
+    int quadsZ;
+    unsigned int indexCount;    // Shared indices to draw
+    float relief;               // Largest height spread inside one grid quad
+};
+
+// The mesh backend's grid and tessellation pipeline with nothing baked into
+// vertices. The heightmap is uploaded once as a texture at its stored sample
+// width; vertex_displaced.glsl places grid vertices from gl_VertexID and
+// reads their height and normal from the texture, and tess_eval.glsl samples
+// it again at every tessellated vertex, so tessellation recovers the texels
+// between grid vertices. GPU memory is the texture plus one chunk's index
+// buffer, and the CPU keeps only the chunk table.
+class DisplacedTerrainRenderer : public TerrainRenderer
+{
+public:
+    // Only reads the heightmap during construction. The texture and index
+    // buffer count against residency's budget.
+    DisplacedTerrainRenderer(const HeightmapView& heightmap, ThreadPool& pool, GpuResidency& residency);
+    ~DisplacedTerrainRenderer() override;
+
+    bool isValid() const override;
+    void render(const TerrainFrame& frame) override;
+    std::string stats() const override;
+
+    int gridWidth() const { return gridWidth_; }
+    int gridHeight() const { return gridHeight_; }
+    size_t chunkCount() const { return chunks_.size(); }
+    size_t textureBytes() const;
+    size_t indexBytes() const;
+
+private:
+    void buildChunks(const HeightmapView& heightmap, ThreadPool& pool);
+
+    int width_;
+    int height_;
+    int gridWidth_;
+    int gridHeight_;
+    std::vector<DisplacedChunk> chunks_;
+    AabbSoA chunkBounds_;
+    std::vector<uint32_t> visibleChunks_;
+
+    GpuResidency& residency_;
+    Shader shader_;
+    unsigned int heightTexture_ = 0;
+    size_t textureBytesPerTexel_ = 1;
+    unsigned int vao_ = 0;
+    unsigned int ebo_ = 0;
+    size_t indexCount_ = 0;
+};
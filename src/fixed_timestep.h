@@ -0,0 +1,61 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+// ============================================================================
+// SIMULATION SETTINGS
+// ============================================================================
+
+// Ticks per second for input, camera movement and collision, whatever the
+// frame rate. Overridden with --tick-rate=HZ.
+const double SIMULATION_DEFAULT_TICK_RATE = 120.0;
+
+// Ticks run for one frame at most. After a long hitch the rest is dropped
+// rather than caught up, so slow ticks cannot make every later frame slower.
+const int SIMULATION_MAX_TICKS_PER_FRAME = 8;
+
+// ============================================================================
+// FIXED TIMESTEP
+// ============================================================================
+
+// Accumulates frame time and hands it out as whole ticks. What is left over
+// is the fraction of a tick the display is ahead of the last tick, used to
+// blend the last two simulated states when drawing.
+class FixedTimestep
+{
+public:
+    explicit FixedTimestep(double tickRate)
+        : tickSeconds_(1.0 / std::max(1.0, tickRate))
+    {
+    }
+
+    double tickSeconds() const { return tickSeconds_; }
+
+    // Ticks to run for a frame that took frameSeconds
+    int advance(double frameSeconds)
+    {
+        accumulator_ += std::max(0.0, frameSeconds);
+        int ticks = static_cast<int>(accumulator_ / tickSeconds_);
+        if (ticks > SIMULATION_MAX_TICKS_PER_FRAME)
+        {
+            dropped_ += static_cast<uint64_t>(ticks - SIMULATION_MAX_TICKS_PER_FRAME);
+            ticks = SIMULATION_MAX_TICKS_PER_FRAME;
+            accumulator_ = ticks * tickSeconds_;
+        }
+        accumulator_ -= ticks * tickSeconds_;
+        ticks_ += static_cast<uint64_t>(ticks);
+        return ticks;
+    }
+
+    // 0 draws the previous tick's state, 1 the latest
+    float alpha() const { return static_cast<float>(accumulator_ / tickSeconds_); }
+
+    uint64_t ticks() const { return ticks_; }
+    uint64_t droppedTicks() const { return dropped_; }
+
+private:
+    double tickSeconds_;
+    double accumulator_ = 0.0;
+    uint64_t ticks_ = 0;
+    uint64_t dropped_ = 0;
+};
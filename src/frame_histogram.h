@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+// ============================================================================
+// FRAME TIME HISTOGRAM
+// ============================================================================
+
+// Upper bounds of the histogram buckets in milliseconds; the last bucket
+// takes everything slower. 16.7 and 33.3 are one and two 60 Hz intervals.
+const double FRAME_HISTOGRAM_BOUNDS_MS[] = { 4.0, 8.0, 12.0, 16.7, 20.0, 25.0, 33.3, 50.0, 100.0 };
+const int FRAME_HISTOGRAM_BUCKETS =
+    static_cast<int>(sizeof(FRAME_HISTOGRAM_BOUNDS_MS) / sizeof(FRAME_HISTOGRAM_BOUNDS_MS[0])) + 1;
+
+// Counts frame times into fixed buckets, so a few long frames stand out
+// even when the average looks fine. Cheap enough to record every frame.
+class FrameHistogram
+{
+public:
+    void add(double ms)
+    {
+        int bucket = 0;
+        while (bucket < FRAME_HISTOGRAM_BUCKETS - 1 && ms > FRAME_HISTOGRAM_BOUNDS_MS[bucket])
+            ++bucket;
+        ++counts_[bucket];
+        ++frames_;
+        totalMs_ += ms;
+        maxMs_ = std::max(maxMs_, ms);
+    }
+
+    size_t frames() const { return frames_; }
+    double maxMs() const { return maxMs_; }
+    double meanMs() const { return frames_ ? totalMs_ / frames_ : 0.0; }
+
+    // One line per non-empty bucket, with a bar scaled to the fullest
+    void print(std::ostream& out) const
+    {
+        size_t fullest = 1;
+        for (size_t count : counts_)
+            fullest = std::max(fullest, count);
+
+        out << std::fixed << std::setprecision(1);
+        for (int b = 0; b < FRAME_HISTOGRAM_BUCKETS; ++b)
+        {
+            if (counts_[b] == 0)
+                continue;
+            if (b < FRAME_HISTOGRAM_BUCKETS - 1)
+                out << "    <= " << std::setw(5) << FRAME_HISTOGRAM_BOUNDS_MS[b] << " ms ";
+            else
+                out << "     > " << std::setw(5) << FRAME_HISTOGRAM_BOUNDS_MS[b - 1] << " ms ";
+            size_t bar = std::max<size_t>(1, counts_[b] * 40 / fullest);
+            out << std::setw(7) << counts_[b] << " " << std::string(bar, '#') << "\n";
+        }
+        out << "    mean " << meanMs() << " ms, max " << maxMs_ << " ms over " << frames_
+            << " frames\n";
+        out << std::defaultfloat << std::setprecision(6);
+    }
+
+private:
+    size_t counts_[FRAME_HISTOGRAM_BUCKETS] = {};
+    size_t frames_ = 0;
+    double totalMs_ = 0.0;
+    double maxMs_ = 0.0;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "terrain_renderer.h"
+
+// ============================================================================
+// FRAME PACKET SETTINGS
+// ============================================================================
+
+// Longest the simulation thread waits for the render thread to take the
+// last packet before replacing it, so a slow frame never stops input and
+// window events from being handled
+const int FRAME_PACKET_WAIT_MS = 50;
+
+// ============================================================================
+// FRAME PACKETS
+// ============================================================================
+
+// Everything the render thread needs to draw one frame, filled in by the
+// simulation thread
+struct FramePacket
+{
+    uint64_t sequence = 0;
+    TerrainFrame terrain;       // Camera, frustum, viewport and tessellation settings
+    bool wireframe = false;
+};
+
+// Hands packets from the simulation thread to the render thread. There are
+// two: the one the simulation thread is filling and the one the render
+// thread draws from, so preparing a frame overlaps drawing the last one.
+// The simulation thread keeps at most one packet waiting.
+class FramePacketExchange
+{
+public:
+    // Simulation thread. Waits until the render thread has taken the last
+    // packet, up to FRAME_PACKET_WAIT_MS, then stores a copy of this one.
+    // Returns false once closed.
+    bool publish(const FramePacket& packet)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        available_.wait_for(lock, std::chrono::milliseconds(FRAME_PACKET_WAIT_MS),
+                            [this] { return !pending_ || closed_; });
+        if (closed_)
+            return false;
+        if (pending_)
+            ++replaced_;
+        packet_ = packet;
+        pending_ = true;
+        ready_.notify_one();
+        return true;
+    }
+
+    // Render thread. Waits for a packet and copies it out; false once closed.
+    bool acquire(FramePacket& packet)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return pending_ || closed_; });
+        if (closed_)
+            return false;
+        packet = packet_;
+        pending_ = false;
+        available_.notify_one();
+        return true;
+    }
+
+    // Either thread; wakes and stops both
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        ready_.notify_all();
+        available_.notify_all();
+    }
+
+    // Packets the render thread never drew because a newer one replaced them
+    uint64_t replaced() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return replaced_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable available_;
+    FramePacket packet_;
+    bool pending_ = false;
+    bool closed_ = false;
+    uint64_t replaced_ = 0;
+};
@@ -0,0 +1,261 @@
+#include "frustum_culling.h"
+
+#include "cpu_features.h"
+
+Frustum extractFrustum(const glm::mat4& viewProjection)
+{
+    // Gribb/Hartmann: each plane is the 4th row of the matrix plus or minus
+    // one of the other rows (glm is column-major, so row r is m[c][r])
+    const glm::mat4& m = viewProjection;
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;  // Left
+    frustum.planes[1] = row3 - row0;  // Right
+    frustum.planes[2] = row3 + row1;  // Bottom
+    frustum.planes[3] = row3 - row1;  // Top
+    frustum.planes[4] = row3 + row2;  // Near
+    frustum.planes[5] = row3 - row2;  // Far
+
+    for (glm::vec4& plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+bool aabbInFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    for (const glm::vec4& plane : frustum.planes)
+    {
+        float x = plane.x >= 0.0f ? boundsMax.x : boundsMin.x;
+        float y = plane.y >= 0.0f ? boundsMax.y : boundsMin.y;
+        float z = plane.z >= 0.0f ? boundsMax.z : boundsMin.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void AabbSoA::clear()
+{
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+    count = 0;
+}
+
+void AabbSoA::push(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    // Drop the previous padding, append, then pad back to a multiple of 8
+    minX.resize(count); minY.resize(count); minZ.resize(count);
+    maxX.resize(count); maxY.resize(count); maxZ.resize(count);
+
+    minX.push_back(boundsMin.x); minY.push_back(boundsMin.y); minZ.push_back(boundsMin.z);
+    maxX.push_back(boundsMax.x); maxY.push_back(boundsMax.y); maxZ.push_back(boundsMax.z);
+    ++count;
+
+    size_t padded = (count + 7) & ~size_t(7);
+    minX.resize(padded, 0.0f); minY.resize(padded, 0.0f); minZ.resize(padded, 0.0f);
+    maxX.resize(padded, 0.0f); maxY.resize(padded, 0.0f); maxZ.resize(padded, 0.0f);
+}
+
+namespace {
+
+// For each plane only the box corner furthest along the plane normal
+// matters. The normal is the same for every box, so picking that corner is
+// a choice between the min and max arrays rather than a per-lane select.
+struct PlaneCorner
+{
+    const float* x;
+    const float* y;
+    const float* z;
+};
+
+inline PlaneCorner positiveCorner(const glm::vec4& plane, const AabbSoA& boxes)
+{
+    return {
+        plane.x >= 0.0f ? boxes.maxX.data() : boxes.minX.data(),
+        plane.y >= 0.0f ? boxes.maxY.data() : boxes.minY.data(),
+        plane.z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data()
+    };
+}
+
+size_t cullScalar(const Frustum& frustum, const AabbSoA& boxes, std::vector<uint32_t>& visible)
+{
+    PlaneCorner corners[6];
+    for (int p = 0; p < 6; ++p)
+        corners[p] = positiveCorner(frustum.planes[p], boxes);
+
+    size_t added = 0;
+    for (size_t b = 0; b < boxes.count; ++b)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+            float distance = plane.x * corners[p].x[b] + plane.y * corners[p].y[b] +
+                             plane.z * corners[p].z[b] + plane.w;
+            inside = distance >= 0.0f;
+        }
+        if (inside)
+        {
+            visible.push_back(static_cast<uint32_t>(b));
+            ++added;
+        }
+    }
+    return added;
+}
+
+#if TERRAIN_X86
+
+// Appends the set bits of mask (lane order) as box indices
+inline size_t appendVisible(unsigned int mask, size_t base, size_t count,
+                            std::vector<uint32_t>& visible)
+{
+    size_t added = 0;
+    while (mask)
+    {
+        unsigned int lane = 0;
+        while (!(mask & (1u << lane)))
+            ++lane;
+        mask &= mask - 1;
+        if (base + lane < count)
+        {
+            visible.push_back(static_cast<uint32_t>(base + lane));
+            ++added;
+        }
+    }
+    return added;
+}
+
+TERRAIN_TARGET("sse4.2")
+size_t cullSSE42(const Frustum& frustum, const AabbSoA& boxes, std::vector<uint32_t>& visible)
+{
+    PlaneCorner corners[6];
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        corners[p] = positiveCorner(frustum.planes[p], boxes);
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    size_t added = 0;
+    for (size_t b = 0; b < boxes.count; b += 4)
+    {
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; ++p)
+        {
+            // Same association as the scalar path so both agree on edge cases
+            __m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], _mm_loadu_ps(corners[p].x + b)),
+                                         _mm_mul_ps(planeY[p], _mm_loadu_ps(corners[p].y + b)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(planeZ[p], _mm_loadu_ps(corners[p].z + b)));
+            distance = _mm_add_ps(distance, planeW[p]);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+        }
+        unsigned int insideMask = ~static_cast<unsigned int>(_mm_movemask_ps(outside)) & 0xFu;
+        added += appendVisible(insideMask, b, boxes.count, visible);
+    }
+    return added;
+}
+
+TERRAIN_TARGET("avx2")
+size_t cullAVX2(const Frustum& frustum, const AabbSoA& boxes, std::vector<uint32_t>& visible)
+{
+    PlaneCorner corners[6];
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        corners[p] = positiveCorner(frustum.planes[p], boxes);
+        planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    size_t added = 0;
+    for (size_t b = 0; b < boxes.count; b += 8)
+    {
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(planeX[p], _mm256_loadu_ps(corners[p].x + b)),
+                                            _mm256_mul_ps(planeY[p], _mm256_loadu_ps(corners[p].y + b)));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(planeZ[p], _mm256_loadu_ps(corners[p].z + b)));
+            distance = _mm256_add_ps(distance, planeW[p]);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+        }
+        unsigned int insideMask = ~static_cast<unsigned int>(_mm256_movemask_ps(outside)) & 0xFFu;
+        added += appendVisible(insideMask, b, boxes.count, visible);
+    }
+    return added;
+}
+
+#endif // TERRAIN_X86
+
+using CullFn = size_t (*)(const Frustum&, const AabbSoA&, std::vector<uint32_t>&);
+
+CullFn kernelFunction(CullKernel kernel)
+{
+    switch (kernel)
+    {
+#if TERRAIN_X86
+    case CullKernel::AVX2:  return cullAVX2;
+    case CullKernel::SSE42: return cullSSE42;
+#endif
+    default:                return cullScalar;
+    }
+}
+
+CullKernel detectCullKernel()
+{
+    if (cpuHasAVX2())  return CullKernel::AVX2;
+    if (cpuHasSSE42()) return CullKernel::SSE42;
+    return CullKernel::Scalar;
+}
+
+const CullKernel g_activeKernel = detectCullKernel();
+const CullFn g_activeCullFn = kernelFunction(g_activeKernel);
+
+} // namespace
+
+CullKernel activeCullKernel()
+{
+    return g_activeKernel;
+}
+
+bool cullKernelSupported(CullKernel kernel)
+{
+    switch (kernel)
+    {
+    case CullKernel::AVX2:  return cpuHasAVX2();
+    case CullKernel::SSE42: return cpuHasSSE42();
+    default:                return true;
+    }
+}
+
+const char* cullKernelName(CullKernel kernel)
+{
+    switch (kernel)
+    {
+    case CullKernel::AVX2:  return "AVX2";
+    case CullKernel::SSE42: return "SSE4.2";
+    default:                return "scalar";
+    }
+}
+
+size_t cullAabbs(const Frustum& frustum, const AabbSoA& boxes, std::vector<uint32_t>& visible)
+{
+    return g_activeCullFn(frustum, boxes, visible);
+}
+
+size_t cullAabbsWith(CullKernel kernel, const Frustum& frustum, const AabbSoA& boxes,
+                     std::vector<uint32_t>& visible)
+{
+    return kernelFunction(kernel)(frustum, boxes, visible);
+}
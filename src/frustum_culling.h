@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// ============================================================================
+// FRUSTUM CULLING
+// ============================================================================
+
+// Six planes (left, right, bottom, top, near, far) as (normal, distance),
+// normals pointing into the frustum
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Extracts normalized planes from a projection * view matrix
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+// Scalar positive-vertex test for a single box, for tree traversals that
+// visit one node at a time
+bool aabbInFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+// Axis-aligned boxes stored as SoA so one SIMD register holds the same
+// coordinate of 4 or 8 boxes. Arrays are padded to a multiple of 8 with
+// boxes that are never reported.
+struct AabbSoA
+{
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+    size_t count = 0;
+
+    void clear();
+    void push(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
+
+enum class CullKernel
+{
+    Scalar,
+    SSE42,      // 4 boxes per instruction
+    AVX2        // 8 boxes per instruction
+};
+
+CullKernel activeCullKernel();
+bool cullKernelSupported(CullKernel kernel);
+const char* cullKernelName(CullKernel kernel);
+
+// Appends the index of every box that intersects the frustum to visible
+// (in ascending order) and returns how many were added. Uses the
+// positive-vertex test, so boxes are kept unless fully outside one plane.
+size_t cullAabbs(const Frustum& frustum, const AabbSoA& boxes, std::vector<uint32_t>& visible);
+size_t cullAabbsWith(CullKernel kernel, const Frustum& frustum, const AabbSoA& boxes,
+                     std::vector<uint32_t>& visible);
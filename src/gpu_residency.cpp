@@ -0,0 +1,226 @@
+#include "gpu_residency.h"
+
+#include <algorithm>
+#include <iterator>
+#include <glad/gl.h>
+
+#include "gpu_uploader.h"
+
+GpuResidency::GpuResidency(size_t budget)
+{
+    stats_.budget = budget;
+}
+
+GpuResidency::~GpuResidency()
+{
+    for (auto& tile : entries_)
+        glDeleteBuffers(1, &tile.second.buffer);
+    for (auto& pooled : pool_)
+        glDeleteBuffers(1, &pooled.second);
+}
+
+// ============================================================================
+// TRACKED OBJECTS
+// ============================================================================
+
+void GpuResidency::trackBuffer(size_t bytes)
+{
+    stats_.fixedBufferBytes += bytes;
+    updatePeak();
+}
+
+void GpuResidency::untrackBuffer(size_t bytes)
+{
+    stats_.fixedBufferBytes -= bytes;
+}
+
+void GpuResidency::trackTexture(size_t bytes)
+{
+    stats_.textureBytes += bytes;
+    updatePeak();
+}
+
+void GpuResidency::updatePeak()
+{
+    stats_.peakBytes = std::max(stats_.peakBytes, stats_.totalBytes());
+}
+
+void GpuResidency::untrackTexture(size_t bytes)
+{
+    stats_.textureBytes -= bytes;
+}
+
+// ============================================================================
+// TILES
+// ============================================================================
+
+void GpuResidency::beginFrame()
+{
+    ++frame_;
+}
+
+uint32_t GpuResidency::reserveTiles(uint32_t count)
+{
+    uint32_t first = nextTile_;
+    nextTile_ += count;
+    return first;
+}
+
+// Moves a resident tile's buffer to the pool
+void GpuResidency::poolTile(std::unordered_map<uint32_t, Entry>::iterator tile)
+{
+    const Entry& entry = tile->second;
+    pool_.emplace(entry.bytes, entry.buffer);
+    stats_.tileBytes -= entry.bytes;
+    stats_.pooledBytes += entry.bytes;
+    lru_.erase(entry.lruPosition);
+    entries_.erase(tile);
+    stats_.residentTiles = entries_.size();
+    stats_.pooledBuffers = pool_.size();
+}
+
+void GpuResidency::release(uint32_t tile)
+{
+    auto found = entries_.find(tile);
+    if (found == entries_.end())
+        return;
+    if (found->second.pending)
+        found->second.released = true;
+    else
+        poolTile(found);
+}
+
+unsigned int GpuResidency::touch(uint32_t tile)
+{
+    auto found = entries_.find(tile);
+    if (found == entries_.end())
+        return 0;
+    Entry& entry = found->second;
+    entry.lastVisibleFrame = frame_;
+    lru_.splice(lru_.begin(), lru_, entry.lruPosition);
+    return entry.buffer;
+}
+
+bool GpuResidency::fits(size_t bytes) const
+{
+    return stats_.totalBytes() + bytes <= stats_.budget;
+}
+
+unsigned int GpuResidency::takePooled(size_t bytes, size_t& capacity)
+{
+    auto found = pool_.lower_bound(bytes);
+    if (found == pool_.end() || found->first > bytes * GPU_POOL_MAX_SLACK)
+        return 0;
+    unsigned int buffer = found->second;
+    capacity = found->first;
+    stats_.pooledBytes -= capacity;
+    pool_.erase(found);
+    ++stats_.poolHits;
+    return buffer;
+}
+
+// Largest first, it frees the most
+void GpuResidency::deletePooled()
+{
+    auto largest = std::prev(pool_.end());
+    glDeleteBuffers(1, &largest->second);
+    stats_.pooledBytes -= largest->first;
+    pool_.erase(largest);
+    ++stats_.buffersDeleted;
+}
+
+// Moves the least recently visible tile's buffer to the pool, skipping
+// tiles still being uploaded. Fails if every other resident tile is
+// visible this frame.
+bool GpuResidency::evictOldest()
+{
+    for (auto position = lru_.rbegin(); position != lru_.rend(); ++position)
+    {
+        auto oldest = entries_.find(*position);
+        if (oldest->second.lastVisibleFrame == frame_)
+            return false;
+        if (oldest->second.pending)
+            continue;
+
+        poolTile(oldest);
+        ++stats_.evictions;
+        return true;
+    }
+    return false;
+}
+
+unsigned int GpuResidency::allocate(uint32_t tile, size_t bytes)
+{
+    // Reuse a free buffer; otherwise make room, preferring to drop pooled
+    // buffers over evicting tiles that may be seen again
+    size_t capacity = 0;
+    unsigned int buffer = takePooled(bytes, capacity);
+    while (!buffer && !fits(bytes))
+    {
+        if (!pool_.empty())
+            deletePooled();
+        else if (evictOldest())
+            buffer = takePooled(bytes, capacity);
+        else
+            break;  // Everything resident is in view: go over budget
+    }
+
+    if (!buffer)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+        capacity = bytes;
+        ++stats_.buffersCreated;
+    }
+
+    Entry& entry = entries_[tile];
+    entry.buffer = buffer;
+    entry.bytes = capacity;
+    entry.lastVisibleFrame = frame_;
+    entry.pending = true;
+    lru_.push_front(tile);
+    entry.lruPosition = lru_.begin();
+
+    stats_.tileBytes += capacity;
+    stats_.residentTiles = entries_.size();
+    stats_.pooledBuffers = pool_.size();
+    ++stats_.pendingTiles;
+    ++stats_.uploads;
+    updatePeak();
+    return buffer;
+}
+
+bool GpuResidency::isPending(uint32_t tile) const
+{
+    auto found = entries_.find(tile);
+    return found != entries_.end() && found->second.pending;
+}
+
+void GpuResidency::markUploaded(uint32_t tile)
+{
+    auto found = entries_.find(tile);
+    if (found == entries_.end() || !found->second.pending)
+        return;
+    found->second.pending = false;
+    --stats_.pendingTiles;
+    if (found->second.released)
+        poolTile(found);
+}
+
+void GpuResidency::collectUploads(GpuUploader& uploader)
+{
+    finishedUploads_.clear();
+    uploader.collect(finishedUploads_);
+    for (uint64_t tile : finishedUploads_)
+        markUploaded(static_cast<uint32_t>(tile));
+}
+
+unsigned int GpuResidency::upload(uint32_t tile, const void* data, size_t bytes)
+{
+    unsigned int buffer = allocate(tile, bytes);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+    markUploaded(tile);
+    return buffer;
+}
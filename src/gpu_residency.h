@@ -0,0 +1,135 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+class GpuUploader;
+
+// ============================================================================
+// GPU RESIDENCY SETTINGS
+// ============================================================================
+
+// Video memory the terrain may use by default (--vram-budget=MB)
+const size_t GPU_RESIDENCY_DEFAULT_BUDGET = size_t(1024) << 20;
+
+// A pooled buffer is reused for a tile of up to this factor fewer bytes;
+// smaller tiles get a buffer of their own rather than waste the space
+const size_t GPU_POOL_MAX_SLACK = 2;
+
+// ============================================================================
+// GPU RESIDENCY MANAGER
+// ============================================================================
+
+// Counters for sizing budgets. Bytes are what was requested from the driver.
+struct GpuResidencyStats
+{
+    size_t budget = 0;
+    size_t tileBytes = 0;           // Buffers holding resident tiles
+    size_t pooledBytes = 0;         // Free buffers kept for reuse
+    size_t fixedBufferBytes = 0;    // Tracked buffers that are never evicted
+    size_t textureBytes = 0;        // Tracked textures
+    size_t peakBytes = 0;           // Highest totalBytes() so far
+    size_t residentTiles = 0;
+    size_t pendingTiles = 0;        // Allocated, contents still uploading
+    size_t pooledBuffers = 0;
+    uint64_t uploads = 0;
+    uint64_t evictions = 0;
+    uint64_t poolHits = 0;          // Uploads that reused a pooled buffer
+    uint64_t buffersCreated = 0;
+    uint64_t buffersDeleted = 0;
+
+    size_t totalBytes() const
+    {
+        return tileBytes + pooledBytes + fixedBufferBytes + textureBytes;
+    }
+};
+
+// Keeps terrain tiles in GPU buffers within a video memory budget. Each tile
+// (identified by the caller, e.g. a chunk index) lives in its own buffer;
+// tiles that have not been visible for the longest are evicted to make room,
+// and their buffers go back to a pool that later uploads recycle instead of
+// creating and deleting buffer objects per tile. Long-lived textures and
+// buffers owned by a renderer are tracked too, so they count against the
+// same budget.
+//
+// Tiles visible in the current frame are never evicted, so the budget is
+// exceeded rather than leaving holes if it is smaller than one frame's
+// working set. All calls need the GL context.
+class GpuResidency
+{
+public:
+    explicit GpuResidency(size_t budget = GPU_RESIDENCY_DEFAULT_BUDGET);
+    ~GpuResidency();
+
+    GpuResidency(const GpuResidency&) = delete;
+    GpuResidency& operator=(const GpuResidency&) = delete;
+
+    // Objects owned elsewhere: counted, never evicted
+    void trackBuffer(size_t bytes);
+    void untrackBuffer(size_t bytes);
+    void trackTexture(size_t bytes);
+    void untrackTexture(size_t bytes);
+
+    // Tiles touched or uploaded after this are visible in the new frame.
+    // Called once per frame, before any renderer.
+    void beginFrame();
+
+    // Hands tile ids [first, first + count) to one owner, so several
+    // renderers (such as a preview and the full terrain) never share tiles
+    uint32_t reserveTiles(uint32_t count);
+
+    // Drops a tile; its buffer goes back to the pool, once any pending
+    // upload into it has finished
+    void release(uint32_t tile);
+
+    // Buffer holding the tile, or 0 if it is not resident. Marks it visible.
+    unsigned int touch(uint32_t tile);
+
+    // Uploads a tile that is not resident and marks it visible. Leaves the
+    // buffer bound to GL_ARRAY_BUFFER.
+    unsigned int upload(uint32_t tile, const void* data, size_t bytes);
+
+    // Makes a tile resident with a buffer of at least bytes whose contents
+    // are filled elsewhere (see GpuUploader, tagged with the tile id). The
+    // tile is pending, and never evicted, until its upload is collected.
+    unsigned int allocate(uint32_t tile, size_t bytes);
+    bool isPending(uint32_t tile) const;
+    void collectUploads(GpuUploader& uploader);
+
+    // Whether the tile has a buffer, without marking it visible
+    bool contains(uint32_t tile) const { return entries_.count(tile) != 0; }
+
+    // True if a tile of this size fits without evicting anything
+    bool fits(size_t bytes) const;
+
+    const GpuResidencyStats& stats() const { return stats_; }
+
+private:
+    struct Entry
+    {
+        unsigned int buffer = 0;
+        size_t bytes = 0;           // Buffer size, may exceed the tile's
+        std::list<uint32_t>::iterator lruPosition;
+        uint64_t lastVisibleFrame = 0;
+        bool pending = false;
+        bool released = false;      // Pending when released: pool it once uploaded
+    };
+
+    unsigned int takePooled(size_t bytes, size_t& capacity);
+    void deletePooled();
+    bool evictOldest();
+    void markUploaded(uint32_t tile);
+    void poolTile(std::unordered_map<uint32_t, Entry>::iterator tile);
+    void updatePeak();
+
+    std::unordered_map<uint32_t, Entry> entries_;
+    std::list<uint32_t> lru_;                       // Most recently visible first
+    std::multimap<size_t, unsigned int> pool_;      // Free buffers by size
+    std::vector<uint64_t> finishedUploads_;
+    uint64_t frame_ = 0;
+    uint32_t nextTile_ = 0;
+    GpuResidencyStats stats_;
+};
@@ -0,0 +1,168 @@
+#include "gpu_uploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <GLFW/glfw3.h>
+
+GpuUploader::~GpuUploader()
+{
+    stop();
+}
+
+bool GpuUploader::start(GLFWwindow* window)
+{
+    // A tiny invisible window, only there for its context
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    loaderWindow_ = glfwCreateWindow(1, 1, "Terrain loader", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!loaderWindow_)
+        return false;
+
+    stopping_ = false;
+    loaderThread_ = std::thread([this] { loaderLoop(); });
+    return true;
+}
+
+void GpuUploader::stop()
+{
+    if (!loaderWindow_)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    loaderThread_.join();
+
+    // Nothing reads the queues any more; drop what was never finished
+    Upload upload;
+    while (requests_.pop(upload))
+        glDeleteSync(upload.fence);
+    while (completed_.pop(upload))
+        fencing_.push_back(upload);
+    for (const Upload& pending : fencing_)
+        glDeleteSync(pending.fence);
+    fencing_.clear();
+    inFlight_ = 0;
+
+    glfwDestroyWindow(loaderWindow_);
+    loaderWindow_ = nullptr;
+}
+
+// ============================================================================
+// MAIN THREAD
+// ============================================================================
+
+bool GpuUploader::submit(uint64_t tag, unsigned int buffer, const void* data, size_t bytes)
+{
+    if (!loaderWindow_ || inFlight_ >= static_cast<size_t>(GPU_UPLOAD_MAX_IN_FLIGHT))
+        return false;
+
+    // The buffer's storage was allocated in this context; the loader waits
+    // on this fence on the GPU before copying into it. Flushed, or that
+    // wait could outlast the frame.
+    Upload upload;
+    upload.tag = tag;
+    upload.buffer = buffer;
+    upload.data = data;
+    upload.bytes = bytes;
+    upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    requests_.push(upload);
+    ++inFlight_;
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        signalled_ = true;
+    }
+    wake_.notify_one();
+    return true;
+}
+
+void GpuUploader::collect(std::vector<uint64_t>& finished)
+{
+    Upload upload;
+    while (completed_.pop(upload))
+        fencing_.push_back(upload);
+
+    // A zero timeout only polls the fence
+    for (size_t i = 0; i < fencing_.size(); )
+    {
+        GLenum state = glClientWaitSync(fencing_[i].fence, 0, 0);
+        if (state == GL_TIMEOUT_EXPIRED)
+        {
+            ++i;
+            continue;
+        }
+        glDeleteSync(fencing_[i].fence);
+        finished.push_back(fencing_[i].tag);
+        fencing_[i] = fencing_.back();
+        fencing_.pop_back();
+        --inFlight_;
+    }
+}
+
+// ============================================================================
+// LOADER THREAD
+// ============================================================================
+
+void GpuUploader::copyThroughStaging(const Upload& upload)
+{
+    const unsigned char* source = static_cast<const unsigned char*>(upload.data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, upload.buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer_);
+    for (size_t offset = 0; offset < upload.bytes; offset += GPU_UPLOAD_STAGING_BYTES)
+    {
+        size_t piece = std::min(GPU_UPLOAD_STAGING_BYTES, upload.bytes - offset);
+
+        // Orphan the staging storage so the map never waits on the previous
+        // piece's copy
+        glBufferData(GL_COPY_READ_BUFFER, GPU_UPLOAD_STAGING_BYTES, nullptr, GL_STREAM_DRAW);
+        void* staging = glMapBufferRange(GL_COPY_READ_BUFFER, 0, piece,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (staging)
+        {
+            std::memcpy(staging, source + offset, piece);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, piece);
+        }
+        else
+        {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset, piece, source + offset);
+        }
+    }
+}
+
+void GpuUploader::loaderLoop()
+{
+    glfwMakeContextCurrent(loaderWindow_);
+    glGenBuffers(1, &stagingBuffer_);
+
+    for (;;)
+    {
+        Upload upload;
+        while (requests_.pop(upload))
+        {
+            glWaitSync(upload.fence, 0, GL_TIMEOUT_IGNORED);
+            glDeleteSync(upload.fence);
+            copyThroughStaging(upload);
+
+            // Flushed so the main thread's poll can see the fence signal.
+            // Never full: at most GPU_UPLOAD_MAX_IN_FLIGHT are outstanding.
+            upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            completed_.push(upload);
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wake_.wait(lock, [this] { return signalled_ || stopping_; });
+        if (stopping_)
+            break;
+        signalled_ = false;
+    }
+
+    glDeleteBuffers(1, &stagingBuffer_);
+    stagingBuffer_ = 0;
+    glfwMakeContextCurrent(nullptr);
+}
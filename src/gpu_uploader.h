@@ -0,0 +1,98 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glad/gl.h>
+
+#include "spsc_queue.h"
+
+struct GLFWwindow;
+
+// ============================================================================
+// GPU UPLOAD SETTINGS
+// ============================================================================
+
+// Staging buffer the loader thread copies through; larger uploads go in
+// pieces of this size
+const size_t GPU_UPLOAD_STAGING_BYTES = size_t(4) << 20;
+
+// Uploads submitted but not yet collected. Keeps the queues from filling
+// and lets callers re-prioritise every frame.
+const int GPU_UPLOAD_MAX_IN_FLIGHT = 32;
+
+// ============================================================================
+// ASYNCHRONOUS BUFFER UPLOADER
+// ============================================================================
+
+// Fills GPU buffers from a loader thread, so the render loop never waits on
+// a transfer. The loader thread owns a hidden window whose GL context shares
+// objects with the main window. For each upload it copies the data into a
+// mapped staging buffer, copies that into the destination buffer on the GPU
+// and sets a fence; collect() hands back uploads whose fence has signalled,
+// polling without ever blocking.
+//
+// The destination buffer must already have storage (GpuResidency::allocate)
+// and the source data must stay valid until the upload is collected.
+// submit() and collect() belong to the thread drawing with the window's
+// context, the render thread. start() and stop() run on the main thread
+// while it holds that context: before the render thread starts and after
+// it has been joined.
+class GpuUploader
+{
+public:
+    GpuUploader() = default;
+    ~GpuUploader();
+
+    GpuUploader(const GpuUploader&) = delete;
+    GpuUploader& operator=(const GpuUploader&) = delete;
+
+    // Creates the shared context and starts the loader thread. window's
+    // context must be current. False if the context could not be created;
+    // callers then upload synchronously.
+    bool start(GLFWwindow* window);
+
+    // Joins the loader thread and destroys its context. Needs the window's
+    // context, and must run before any submitted source data is freed.
+    void stop();
+    bool isRunning() const { return loaderWindow_ != nullptr; }
+
+    // Queues a copy of bytes from data into buffer. tag comes back from
+    // collect(). Fails once GPU_UPLOAD_MAX_IN_FLIGHT uploads are pending.
+    bool submit(uint64_t tag, unsigned int buffer, const void* data, size_t bytes);
+    size_t inFlight() const { return inFlight_; }
+
+    // Appends the tags of uploads the GPU has finished to finished
+    void collect(std::vector<uint64_t>& finished);
+
+private:
+    struct Upload
+    {
+        uint64_t tag = 0;
+        unsigned int buffer = 0;
+        const void* data = nullptr;
+        size_t bytes = 0;
+        GLsync fence = nullptr;     // Main context: storage ready. Loader: copy done.
+    };
+
+    void loaderLoop();
+    void copyThroughStaging(const Upload& upload);
+
+    GLFWwindow* loaderWindow_ = nullptr;
+    std::thread loaderThread_;
+    unsigned int stagingBuffer_ = 0;    // Loader context
+
+    // Main thread
+    std::vector<Upload> fencing_;       // Handed back, fence not signalled yet
+    size_t inFlight_ = 0;
+
+    // Between the threads
+    SpscQueue<Upload, 64> requests_;
+    SpscQueue<Upload, 64> completed_;
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    bool signalled_ = false;
+    bool stopping_ = false;
+};
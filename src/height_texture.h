@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <glad/gl.h>
+
+#include "heightmap.h"
+#include "terrain_mesh.h"
+
+// ============================================================================
+// HEIGHT TEXTURES
+// ============================================================================
+
+// GPU layout for heightmap samples at their stored width: normalized R8 or
+// R16, or R32F. Shaders turn a fetched value into a world height with
+//     (value - offset) * scale
+// passed as the heightRange uniform.
+struct HeightTextureFormat
+{
+    GLenum internalFormat;
+    GLenum type;
+    size_t bytesPerTexel;
+    float offset;
+    float scale;
+};
+
+inline HeightTextureFormat heightTextureFormat(const HeightmapView& heightmap)
+{
+    HeightTextureFormat format;
+    float normalizedMax;    // Sample value a normalized texture reads as 1.0
+    switch (heightmap.format)
+    {
+    case HeightmapFormat::U16:
+        format.internalFormat = GL_R16;
+        format.type = GL_UNSIGNED_SHORT;
+        normalizedMax = 65535.0f;
+        break;
+    case HeightmapFormat::F32:
+        format.internalFormat = GL_R32F;
+        format.type = GL_FLOAT;
+        normalizedMax = 1.0f;
+        break;
+    default:
+        format.internalFormat = GL_R8;
+        format.type = GL_UNSIGNED_BYTE;
+        normalizedMax = 255.0f;
+        break;
+    }
+    format.bytesPerTexel = heightmapSampleBytes(heightmap.format);
+    format.offset = heightmap.range.offset / normalizedMax;
+    format.scale = normalizedMax / heightmap.range.span * HEIGHT_SCALE;
+    return format;
+}
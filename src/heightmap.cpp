@@ -0,0 +1,595 @@
+#include "heightmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <utility>
+#include <stb_image.h>
+
+#include "png_rows.h"
+#include "terrain_mesh.h"
+#include "thread_pool.h"
+#include "tiled_heightmap.h"
+
+size_t heightmapSampleBytes(HeightmapFormat format)
+{
+    switch (format)
+    {
+    case HeightmapFormat::U16: return 2;
+    case HeightmapFormat::F32: return 4;
+    default:                   return 1;
+    }
+}
+
+const char* downsampleFilterName(DownsampleFilter filter)
+{
+    switch (filter)
+    {
+    case DownsampleFilter::Point: return "point";
+    case DownsampleFilter::Max:   return "max";
+    default:                      return "box";
+    }
+}
+
+const char* heightmapFormatName(HeightmapFormat format)
+{
+    switch (format)
+    {
+    case HeightmapFormat::U16: return "16-bit";
+    case HeightmapFormat::F32: return "32-bit float";
+    default:                   return "8-bit";
+    }
+}
+
+float HeightmapView::normalizedAt(int x, int z) const
+{
+    size_t index = static_cast<size_t>(z) * width + x;
+    float sample;
+    switch (format)
+    {
+    case HeightmapFormat::U16: sample = static_cast<float>(samples<uint16_t>()[index]); break;
+    case HeightmapFormat::F32: sample = samples<float>()[index]; break;
+    default:                   sample = static_cast<float>(samples<uint8_t>()[index]); break;
+    }
+    return (sample - range.offset) / range.span;
+}
+
+float heightmapHeightAt(const HeightmapView& heightmap, float worldX, float worldZ)
+{
+    if (!heightmap.data) return 0.0f;
+
+    float tx = (worldX + 30.0f) / 60.0f * (heightmap.width - 1);
+    float tz = (worldZ + 30.0f) / 60.0f * (heightmap.height - 1);
+    if (tx < 0 || tx >= heightmap.width - 1 || tz < 0 || tz >= heightmap.height - 1)
+        return 0.0f;  // Outside terrain bounds
+
+    int x0 = static_cast<int>(tx);
+    int z0 = static_cast<int>(tz);
+    float fx = tx - x0;
+    float fz = tz - z0;
+
+    float h0 = heightmap.normalizedAt(x0, z0) * (1 - fx) + heightmap.normalizedAt(x0 + 1, z0) * fx;
+    float h1 = heightmap.normalizedAt(x0, z0 + 1) * (1 - fx) + heightmap.normalizedAt(x0 + 1, z0 + 1) * fx;
+    return (h0 * (1 - fz) + h1 * fz) * HEIGHT_SCALE;
+}
+
+// ============================================================================
+// LOADING
+// ============================================================================
+
+namespace {
+
+bool endsWith(const std::string& text, const char* suffix)
+{
+    size_t length = std::strlen(suffix);
+    if (text.size() < length)
+        return false;
+    for (size_t c = 0; c < length; ++c)
+    {
+        char a = text[text.size() - length + c];
+        if (a >= 'A' && a <= 'Z')
+            a = static_cast<char>(a - 'A' + 'a');
+        if (a != suffix[c])
+            return false;
+    }
+    return true;
+}
+
+// Settings for a raw heightmap: from the extension, then the sidecar
+struct RawLayout
+{
+    HeightmapFormat format = HeightmapFormat::U8;
+    int width = 0;              // 0 = square, from the file size
+    int height = 0;
+    size_t headerBytes = 0;
+    float minValue = 0.0f;      // r32 only
+    float maxValue = 1.0f;
+};
+
+bool isRawHeightmap(const std::string& path, RawLayout& layout)
+{
+    if (endsWith(path, ".r16"))
+        layout.format = HeightmapFormat::U16;
+    else if (endsWith(path, ".r32"))
+        layout.format = HeightmapFormat::F32;
+    else if (endsWith(path, ".r8") || endsWith(path, ".raw"))
+        layout.format = HeightmapFormat::U8;
+    else
+        return std::ifstream(path + ".hdr").good();   // Sidecar marks any file as raw
+    return true;
+}
+
+// Reads "<path>.hdr" if present. Returns false on a malformed sidecar.
+bool readSidecar(const std::string& path, RawLayout& layout, std::string& error)
+{
+    std::ifstream file(path + ".hdr");
+    if (!file.is_open())
+        return true;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        size_t equals = line.find('=');
+        if (equals == std::string::npos)
+            continue;
+
+        std::string key, value;
+        std::istringstream(line.substr(0, equals)) >> key;
+        std::istringstream(line.substr(equals + 1)) >> value;
+        if (key.empty())
+            continue;
+
+        if (key == "width")
+            layout.width = std::atoi(value.c_str());
+        else if (key == "height")
+            layout.height = std::atoi(value.c_str());
+        else if (key == "header")
+            layout.headerBytes = static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10));
+        else if (key == "min")
+            layout.minValue = std::strtof(value.c_str(), nullptr);
+        else if (key == "max")
+            layout.maxValue = std::strtof(value.c_str(), nullptr);
+        else if (key == "format")
+        {
+            if (value == "r8")       layout.format = HeightmapFormat::U8;
+            else if (value == "r16") layout.format = HeightmapFormat::U16;
+            else if (value == "r32") layout.format = HeightmapFormat::F32;
+            else
+            {
+                error = "unknown format '" + value + "' in " + path + ".hdr";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool hostIsLittleEndian()
+{
+    const uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Reduces source rows, fed top to bottom, to the output grid. Output sample
+// i covers source columns [i * step - step / 2, i * step - step / 2 + step)
+// clipped to the map, and the same for rows, so blocks tile the map and
+// each one is centred on the sample the point filter would pick. Only one
+// row of accumulators is held besides the output.
+class RowDownsampler
+{
+public:
+    RowDownsampler(int sourceWidth, int sourceHeight, int step, DownsampleFilter filter,
+                   HeightmapFormat sourceFormat, SampleRange sourceRange)
+        : sourceWidth_(sourceWidth), sourceHeight_(sourceHeight), step_(step), filter_(filter),
+          width_(sourceWidth / step), height_(sourceHeight / step),
+          sourceFormat_(sourceFormat), format_(sourceFormat), range_(sourceRange)
+    {
+        // Block means of integer samples need more than 8 bits
+        if (filter_ == DownsampleFilter::Box && sourceFormat_ != HeightmapFormat::F32)
+        {
+            format_ = HeightmapFormat::U16;
+            range_ = defaultSampleRange(HeightmapFormat::U16);
+        }
+        accumulator_.resize(width_);
+        output_.resize(static_cast<size_t>(width_) * height_ * heightmapSampleBytes(format_));
+        resetAccumulator();
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    HeightmapFormat format() const { return format_; }
+    SampleRange range() const { return range_; }
+    bool done() const { return outputRow_ >= height_; }
+
+    size_t bufferBytes() const
+    {
+        return accumulator_.size() * sizeof(double) + output_.size();
+    }
+
+    std::vector<unsigned char>& output() { return output_; }
+
+    // Returns false once every output row is complete
+    template <typename Sample>
+    bool addRow(int z, const Sample* row)
+    {
+        if (done())
+            return false;
+
+        if (filter_ == DownsampleFilter::Point)
+        {
+            if (z == outputRow_ * step_)
+            {
+                for (int i = 0; i < width_; ++i)
+                    accumulator_[i] = static_cast<double>(row[static_cast<size_t>(i) * step_]);
+                emitRow<Sample>(1);
+            }
+            return !done();
+        }
+
+        if (z < blockStart(outputRow_, sourceHeight_))
+            return true;
+        for (int i = 0; i < width_; ++i)
+        {
+            int x0 = blockStart(i, sourceWidth_);
+            int x1 = blockEnd(i, sourceWidth_);
+            double value = accumulator_[i];
+            if (filter_ == DownsampleFilter::Max)
+            {
+                for (int x = x0; x < x1; ++x)
+                    value = std::max(value, static_cast<double>(row[x]));
+            }
+            else
+            {
+                for (int x = x0; x < x1; ++x)
+                    value += static_cast<double>(row[x]);
+            }
+            accumulator_[i] = value;
+        }
+
+        if (z + 1 == blockEnd(outputRow_, sourceHeight_))
+            emitRow<Sample>(z + 1 - blockStart(outputRow_, sourceHeight_));
+        return !done();
+    }
+
+private:
+    int blockStart(int index, int limit) const
+    {
+        return std::min(limit, std::max(0, index * step_ - step_ / 2));
+    }
+
+    int blockEnd(int index, int limit) const
+    {
+        return std::min(limit, index * step_ - step_ / 2 + step_);
+    }
+
+    void resetAccumulator()
+    {
+        double initial = filter_ == DownsampleFilter::Max
+            ? -std::numeric_limits<double>::infinity() : 0.0;
+        std::fill(accumulator_.begin(), accumulator_.end(), initial);
+    }
+
+    template <typename Sample>
+    void emitRow(int blockRows)
+    {
+        size_t rowStart = static_cast<size_t>(outputRow_) * width_;
+        for (int i = 0; i < width_; ++i)
+        {
+            double value = accumulator_[i];
+            if (filter_ == DownsampleFilter::Box)
+                value /= static_cast<double>(blockRows) *
+                         (blockEnd(i, sourceWidth_) - blockStart(i, sourceWidth_));
+            store(rowStart + i, value);
+        }
+        ++outputRow_;
+        resetAccumulator();
+    }
+
+    void store(size_t index, double value)
+    {
+        switch (format_)
+        {
+        case HeightmapFormat::U16:
+        {
+            // Rescale 8-bit means to the full 16-bit range
+            if (sourceFormat_ == HeightmapFormat::U8)
+                value *= 257.0;
+            uint16_t sample = static_cast<uint16_t>(std::lround(std::min(value, 65535.0)));
+            std::memcpy(&output_[index * sizeof(uint16_t)], &sample, sizeof(sample));
+            break;
+        }
+        case HeightmapFormat::F32:
+        {
+            float sample = static_cast<float>(value);
+            std::memcpy(&output_[index * sizeof(float)], &sample, sizeof(sample));
+            break;
+        }
+        default:
+            output_[index] = static_cast<unsigned char>(value);
+            break;
+        }
+    }
+
+    int sourceWidth_;
+    int sourceHeight_;
+    int step_;
+    DownsampleFilter filter_;
+    int width_;
+    int height_;
+    HeightmapFormat sourceFormat_;
+    HeightmapFormat format_;
+    SampleRange range_;
+    std::vector<double> accumulator_;   // Sums (box) or maxima per output column
+    std::vector<unsigned char> output_;
+    int outputRow_ = 0;
+};
+
+} // namespace
+
+Heightmap::~Heightmap()
+{
+    if (decoded_)
+        stbi_image_free(decoded_);
+}
+
+Heightmap::Heightmap(Heightmap&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+Heightmap& Heightmap::operator=(Heightmap&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (decoded_)
+            stbi_image_free(decoded_);
+        view_ = other.view_;
+        decoded_ = other.decoded_;
+        mapping_ = std::move(other.mapping_);
+        samples_ = std::move(other.samples_);
+        peakLoadBytes_ = other.peakLoadBytes_;
+        error_ = std::move(other.error_);
+        other.view_ = HeightmapView();
+        other.decoded_ = nullptr;
+    }
+    return *this;
+}
+
+Heightmap Heightmap::load(const char* path)
+{
+    Heightmap heightmap;
+    RawLayout layout;
+
+    if (endsWith(path, ".hmt"))
+    {
+        TiledHeightmap tiled;
+        if (!tiled.open(path))
+        {
+            heightmap.error_ = tiled.error();
+            return heightmap;
+        }
+        ThreadPool pool;
+        heightmap.samples_.resize(static_cast<size_t>(tiled.width()) * tiled.height() *
+                                  heightmapSampleBytes(tiled.format()));
+        if (!tiled.decode(heightmap.samples_.data(), pool))
+        {
+            heightmap.samples_ = std::vector<unsigned char>();
+            heightmap.error_ = "corrupt tile data";
+            return heightmap;
+        }
+        heightmap.view_.data = heightmap.samples_.data();
+        heightmap.view_.width = tiled.width();
+        heightmap.view_.height = tiled.height();
+        heightmap.view_.format = tiled.format();
+        heightmap.view_.range = defaultSampleRange(tiled.format());
+        heightmap.peakLoadBytes_ = heightmap.samples_.size();
+        return heightmap;
+    }
+
+    if (!isRawHeightmap(path, layout))
+    {
+        // 16-bit images are decoded at full depth, so DEMs do not terrace
+        int width = 0, height = 0, channels = 0;
+        bool wide = stbi_is_16_bit(path) != 0;
+        if (wide)
+            heightmap.decoded_ = stbi_load_16(path, &width, &height, &channels, 1);
+        else
+            heightmap.decoded_ = stbi_load(path, &width, &height, &channels, 1);
+        if (!heightmap.decoded_)
+        {
+            heightmap.error_ = stbi_failure_reason();
+            return heightmap;
+        }
+        heightmap.view_.data = heightmap.decoded_;
+        heightmap.view_.width = width;
+        heightmap.view_.height = height;
+        heightmap.view_.format = wide ? HeightmapFormat::U16 : HeightmapFormat::U8;
+        heightmap.view_.range = defaultSampleRange(heightmap.view_.format);
+        heightmap.peakLoadBytes_ = static_cast<size_t>(width) * height * (wide ? 2 : 1);
+        return heightmap;
+    }
+
+    if (!readSidecar(path, layout, heightmap.error_))
+        return heightmap;
+    if (!hostIsLittleEndian() && layout.format != HeightmapFormat::U8)
+    {
+        heightmap.error_ = "raw heightmaps are little-endian and cannot be used in place on this host";
+        return heightmap;
+    }
+
+    MappedFile mapping;
+    if (!mapping.open(path))
+    {
+        heightmap.error_ = "cannot map file";
+        return heightmap;
+    }
+
+    const size_t sampleBytes = heightmapSampleBytes(layout.format);
+    if (layout.headerBytes % sampleBytes != 0 || layout.headerBytes >= mapping.size())
+    {
+        heightmap.error_ = "header size must be a multiple of the sample size and smaller than the file";
+        return heightmap;
+    }
+
+    size_t sampleCount = (mapping.size() - layout.headerBytes) / sampleBytes;
+    if (layout.width <= 0 || layout.height <= 0)
+    {
+        // Headerless square map
+        int side = static_cast<int>(std::lround(std::sqrt(static_cast<double>(sampleCount))));
+        if (static_cast<size_t>(side) * side != sampleCount)
+        {
+            heightmap.error_ = "file is not square; give width and height in " +
+                               std::string(path) + ".hdr";
+            return heightmap;
+        }
+        layout.width = side;
+        layout.height = side;
+    }
+    if (static_cast<size_t>(layout.width) * layout.height > sampleCount)
+    {
+        heightmap.error_ = "file is smaller than width x height samples";
+        return heightmap;
+    }
+    if (layout.format == HeightmapFormat::F32 && !(layout.maxValue != layout.minValue))
+    {
+        heightmap.error_ = "min and max must differ";
+        return heightmap;
+    }
+
+    heightmap.view_.data = static_cast<const unsigned char*>(mapping.data()) + layout.headerBytes;
+    heightmap.view_.width = layout.width;
+    heightmap.view_.height = layout.height;
+    heightmap.view_.format = layout.format;
+    heightmap.view_.range = defaultSampleRange(layout.format);
+    if (layout.format == HeightmapFormat::F32)
+        heightmap.view_.range = { layout.minValue, layout.maxValue - layout.minValue };
+    heightmap.mapping_ = std::move(mapping);
+    return heightmap;
+}
+
+Heightmap Heightmap::loadDownsampled(const char* path, int step, DownsampleFilter filter)
+{
+    Heightmap heightmap;
+    step = std::max(1, step);
+
+    auto finish = [&](RowDownsampler& downsampler, size_t sourceBytes) {
+        heightmap.peakLoadBytes_ = sourceBytes + downsampler.bufferBytes();
+        heightmap.samples_ = std::move(downsampler.output());
+        heightmap.view_.data = heightmap.samples_.data();
+        heightmap.view_.width = downsampler.width();
+        heightmap.view_.height = downsampler.height();
+        heightmap.view_.format = downsampler.format();
+        heightmap.view_.range = downsampler.range();
+    };
+    auto tooSmall = [&](int width, int height) {
+        if (width / step >= 2 && height / step >= 2)
+            return false;
+        heightmap.error_ = "heightmap is too small for a step of " + std::to_string(step);
+        return true;
+    };
+
+    // PNGs stream straight from the compressed file
+    RawLayout layout;
+    PngRowReader png;
+    if (!isRawHeightmap(path, layout) && png.open(path))
+    {
+        if (tooSmall(png.width(), png.height()))
+            return heightmap;
+
+        HeightmapFormat format = png.is16Bit() ? HeightmapFormat::U16 : HeightmapFormat::U8;
+        RowDownsampler downsampler(png.width(), png.height(), step, filter, format,
+                                   defaultSampleRange(format));
+        bool ok = png.readRows([&](int z, const void* row) {
+            if (png.is16Bit())
+                return downsampler.addRow(z, static_cast<const uint16_t*>(row));
+            return downsampler.addRow(z, static_cast<const uint8_t*>(row));
+        });
+        if (!ok || !downsampler.done())
+        {
+            heightmap.error_ = png.error().empty() ? "truncated image data" : png.error();
+            return heightmap;
+        }
+        finish(downsampler, png.bufferBytes());
+        return heightmap;
+    }
+
+    // Tiled files decode a row of tiles at a time, tiles in parallel
+    TiledHeightmap tiled;
+    if (endsWith(path, ".hmt"))
+    {
+        if (!tiled.open(path))
+        {
+            heightmap.error_ = tiled.error();
+            return heightmap;
+        }
+        if (tooSmall(tiled.width(), tiled.height()))
+            return heightmap;
+
+        HeightmapFormat format = tiled.format();
+        RowDownsampler downsampler(tiled.width(), tiled.height(), step, filter, format,
+                                   defaultSampleRange(format));
+        const size_t rowBytes = static_cast<size_t>(tiled.width()) * heightmapSampleBytes(format);
+        std::vector<unsigned char> band(rowBytes * tiled.tileSize());
+        ThreadPool pool;
+        for (int tz = 0; tz < tiled.tilesZ() && !downsampler.done(); ++tz)
+        {
+            if (!tiled.decodeTileRow(tz, band.data(), pool))
+            {
+                heightmap.error_ = "corrupt tile data";
+                return heightmap;
+            }
+            int firstRow = tz * tiled.tileSize();
+            int rows = std::min(tiled.tileSize(), tiled.height() - firstRow);
+            for (int r = 0; r < rows; ++r)
+            {
+                const unsigned char* row = band.data() + r * rowBytes;
+                if (format == HeightmapFormat::U16)
+                    downsampler.addRow(firstRow + r, reinterpret_cast<const uint16_t*>(row));
+                else
+                    downsampler.addRow(firstRow + r, row);
+            }
+        }
+        finish(downsampler, band.size());
+        return heightmap;
+    }
+
+    // Raw files are read through their mapping, dropping rows once used;
+    // other images have to be decoded whole first
+    Heightmap source = load(path);
+    if (!source.isValid())
+        return source;
+    const HeightmapView& view = source.view();
+    if (tooSmall(view.width, view.height))
+        return heightmap;
+
+    RowDownsampler downsampler(view.width, view.height, step, filter, view.format, view.range);
+    const size_t rowBytes = static_cast<size_t>(view.width) * heightmapSampleBytes(view.format);
+    const size_t headerBytes = source.isMapped()
+        ? static_cast<const unsigned char*>(view.data) -
+          static_cast<const unsigned char*>(source.mapping_.data())
+        : 0;
+    for (int z = 0; z < view.height && !downsampler.done(); ++z)
+    {
+        const void* row = static_cast<const unsigned char*>(view.data) + z * rowBytes;
+        switch (view.format)
+        {
+        case HeightmapFormat::U16: downsampler.addRow(z, static_cast<const uint16_t*>(row)); break;
+        case HeightmapFormat::F32: downsampler.addRow(z, static_cast<const float*>(row)); break;
+        default:                   downsampler.addRow(z, static_cast<const uint8_t*>(row)); break;
+        }
+        size_t consumed = headerBytes + (z + 1) * rowBytes;
+        if (source.isMapped() && (consumed - headerBytes) % (1 << 20) < rowBytes)
+            source.mapping_.discard(0, consumed);
+    }
+    finish(downsampler, source.isMapped() ? 0 : source.peakLoadBytes());
+    return heightmap;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// ============================================================================
+// HEIGHTMAP
+// ============================================================================
+
+enum class HeightmapFormat
+{
+    U8,     // 8-bit images, .r8 / .raw
+    U16,    // 16-bit PNGs, .r16 (little-endian)
+    F32     // .r32, little-endian
+};
+
+size_t heightmapSampleBytes(HeightmapFormat format);
+const char* heightmapFormatName(HeightmapFormat format);
+
+// Maps raw samples to 0..1 as (sample - offset) / span. Written this way so
+// 8-bit samples normalize exactly like the original byte / 255.0f.
+struct SampleRange
+{
+    float offset;
+    float span;
+};
+
+inline SampleRange defaultSampleRange(HeightmapFormat format)
+{
+    switch (format)
+    {
+    case HeightmapFormat::U16: return { 0.0f, 65535.0f };
+    case HeightmapFormat::F32: return { 0.0f, 1.0f };
+    default:                   return { 0.0f, 255.0f };
+    }
+}
+
+template <typename Sample> struct HeightmapSampleTraits;
+template <> struct HeightmapSampleTraits<uint8_t>  { static constexpr HeightmapFormat format = HeightmapFormat::U8; };
+template <> struct HeightmapSampleTraits<uint16_t> { static constexpr HeightmapFormat format = HeightmapFormat::U16; };
+template <> struct HeightmapSampleTraits<float>    { static constexpr HeightmapFormat format = HeightmapFormat::F32; };
+
+// Non-owning view of a heightmap, row-major, one sample per texel
+struct HeightmapView
+{
+    const void* data = nullptr;
+    int width = 0;
+    int height = 0;
+    HeightmapFormat format = HeightmapFormat::U8;
+    SampleRange range = { 0.0f, 255.0f };
+
+    template <typename Sample>
+    const Sample* samples() const { return static_cast<const Sample*>(data); }
+
+    // Sample (x, z) mapped to 0..1
+    float normalizedAt(int x, int z) const;
+};
+
+// Bilinear world-space height at full heightmap resolution, using the same
+// -30..30 world mapping as the terrain backends. Returns 0 outside the map.
+float heightmapHeightAt(const HeightmapView& heightmap, float worldX, float worldZ);
+
+// How Heightmap::loadDownsampled reduces each step x step block of source
+// samples to one grid sample
+enum class DownsampleFilter
+{
+    Point,  // Top-left sample only, as the mesh generator samples a full map
+    Box,    // Mean of the block
+    Max     // Highest sample, so peaks survive
+};
+
+const char* downsampleFilterName(DownsampleFilter filter);
+
+// Owns the samples behind a HeightmapView: an image decoded by stb_image, a
+// decoded tiled file or a raw file mapped straight into memory
+class Heightmap {
+public:
+    Heightmap() = default;
+    ~Heightmap();
+
+    Heightmap(const Heightmap&) = delete;
+    Heightmap& operator=(const Heightmap&) = delete;
+    Heightmap(Heightmap&& other) noexcept;
+    Heightmap& operator=(Heightmap&& other) noexcept;
+
+    bool isValid() const { return view_.data != nullptr; }
+    const HeightmapView& view() const { return view_; }
+    bool isMapped() const { return mapping_.isOpen(); }
+    const std::string& error() const { return error_; }
+
+    // Raw files (.r8, .r16, .r32, .raw) are memory-mapped and used in place.
+    // Their size and format come from the extension, or from an optional
+    // sidecar "<path>.hdr" with key = value lines:
+    //   width, height   Sample grid (default: square, from the file size)
+    //   format          r8, r16 or r32
+    //   header          Bytes to skip before the first sample (default 0)
+    //   min, max        r32 values that map to the bottom and top of the
+    //                   terrain (default 0 and 1)
+    // Tiled .hmt files (see tiled_heightmap.h) are decoded on all cores.
+    // Anything else is decoded with stb_image: 16-bit PNGs keep all 16 bits,
+    // other images are read as 8-bit.
+    static Heightmap load(const char* path);
+
+    // Loads the map already reduced by step on both axes, streaming source
+    // rows through the filter so only the output grid is ever held in full.
+    // PNGs are decoded row by row, tiled files one row of tiles at a time and
+    // raw files are read through their mapping; other images are decoded
+    // whole first. The result has
+    // width / step x height / step samples, and sample (i, j) stands for
+    // source sample (i * step, j * step), with blocks centred on it. Box
+    // filtering 8- or 16-bit maps gives 16-bit samples, otherwise the source
+    // format is kept.
+    static Heightmap loadDownsampled(const char* path, int step, DownsampleFilter filter);
+
+    // Largest amount of memory the loader held at once (decoded image or
+    // streaming buffers, plus the result), not counting file mappings
+    size_t peakLoadBytes() const { return peakLoadBytes_; }
+
+private:
+    HeightmapView view_;
+    void* decoded_ = nullptr;   // stb_image allocation
+    MappedFile mapping_;
+    std::vector<unsigned char> samples_;    // Decoded tiles or loadDownsampled output
+    size_t peakLoadBytes_ = 0;
+    std::string error_;
+};
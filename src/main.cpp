@@ -1,11 +1,42 @@
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "benchmark.h"
+#include "cdlod.h"
+#include "collision_grid.h"
+#include "displaced.h"
+#include "clipmap.h"
+#include "fixed_timestep.h"
+#include "frame_histogram.h"
+#include "frame_packet.h"
+#include "frustum_culling.h"
+#include "gpu_residency.h"
+#include "gpu_uploader.h"
+#include "heightmap.h"
+#include "mesh_renderer.h"
+#include "process_memory.h"
 #include "shader.h"
+#include "terrain_build.h"
+#include "terrain_cache.h"
+#include "terrain_collision.h"
+#include "terrain_mesh.h"
+#include "terrain_raycast.h"
+#include "terrain_renderer.h"
+#include "thread_pool.h"
+#include "tile_streamer.h"
+#include "tiled_heightmap.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -28,26 +59,83 @@ float lastY = 300.0f;
 bool firstMouse = true;
 
 // Time
-float deltaTime = 0.0f;
+float deltaTime = 0.0f;     // Of the last frame
 float lastFrame = 0.0f;
 
+// Camera movement and collision run in fixed ticks (--tick-rate=HZ); frames
+// draw the camera between the last two ticks, at simulationAlpha
+double simulationTickRate = SIMULATION_DEFAULT_TICK_RATE;
+glm::vec3 previousCameraPos = cameraPos;
+float simulationAlpha = 1.0f;
+
+// Frames are not capped unless --vsync waits for the display
+bool vsyncEnabled = false;
+
 // Display toggles
 bool wireframeMode = false;
 bool tKeyPressed = false;
+bool patchCullingEnabled = true;   // Frustum/backface culling in the TCS
+bool cKeyPressed = false;
+bool screenSpaceTessellation = true;   // Tess levels from projected edge length
+bool lKeyPressed = false;
+
+// Screen-space tessellation target: triangle edges are split until they
+// cover about this many pixels
+const float TESS_TARGET_PIXELS_PER_EDGE = 8.0f;
+
+// Framebuffer size, kept up to date by framebuffer_size_callback
+int framebufferWidth = 800;
+int framebufferHeight = 600;
 
 // Cursor control - click and hold to look around
 bool cameraControlActive = false;
 
-// Forward declaration for collision detection
-struct TerrainMesh;
+// Primitives generated by the terrain draw last frame, shown in the title
+GLuint64 terrainPrimitives = 0;
 
 // Collision detection
-const float CAMERA_HEIGHT_OFFSET = 0.15f;  // Height above terrain
-TerrainMesh* g_terrainMesh = nullptr;       // Global access for collision
-
-// Terrain settings
-const int HEIGHTMAP_STEP = 5;        // Reduced from 8 for more detail
-const float HEIGHT_SCALE = 3.0f;     // Increased for taller peaks
+const float CAMERA_HEIGHT_OFFSET = 0.15f;  // Height above terrain, and collision sphere radius
+CollisionGrid* g_collisionGrid = nullptr;   // Camera sweeps, and mesh backend heights
+HeightmapView g_heightmap;                  // Used instead by texture backends
+TileStreamer* g_tileStreamer = nullptr;     // Or, when streaming, resident tiles
+TerrainRaycaster* g_terrainRaycaster = nullptr;   // Mouse picking, unless streaming
+
+// Worker threads for terrain mesh generation (0 = one per hardware thread).
+// Overridden with --threads=N on the command line.
+int meshThreadCount = 0;
+
+// Vertex layout uploaded to the GPU. Compact stores 8 bytes per vertex and
+// rebuilds X/Z/UV in the vertex shader; --vertex-format=full selects the
+// original 32-byte layout for comparison.
+TerrainVertexFormat terrainVertexFormat = TerrainVertexFormat::Compact;
+
+// Terrain renderer: the baked chunk mesh with tessellation, or the CDLOD
+// quadtree / geometry clipmap (--backend=cdlod|clipmap), which scale to
+// much larger heightmaps, or the mesh's flat grid displaced from a height
+// texture (--backend=displaced)
+TerrainBackend terrainBackend = TerrainBackend::Mesh;
+
+// How the mesh backend reduces the heightmap to its grid while streaming it
+// in (--downsample=box|max|point). Point matches sampling every
+// HEIGHTMAP_STEP-th texel of the full map.
+DownsampleFilter downsampleFilter = DownsampleFilter::Box;
+
+// Where the mesh backend bakes its vertex/index buffers, keyed by a hash of
+// the heightmap and the mesh settings (--cache-dir=DIR, --no-cache)
+std::string terrainCacheDir = "cache";
+bool terrainCacheEnabled = true;
+
+// Memory for decoded tiles when the clipmap streams a .hmt pyramid
+// (--tile-budget=MB)
+size_t tileStreamBudget = TILE_STREAM_DEFAULT_BUDGET;
+
+// Video memory for terrain buffers and textures; mesh chunks out of view
+// are evicted beyond it (--vram-budget=MB)
+size_t vramBudget = GPU_RESIDENCY_DEFAULT_BUDGET;
+
+// Mesh chunks are uploaded from a loader thread with its own shared GL
+// context unless --sync-uploads asks for the old blocking uploads
+bool asyncUploads = true;
 
 // Skybox cube vertices (36 vertices, 6 faces)
 const float skyboxVertices[] = {
@@ -102,162 +190,101 @@ const float skyboxVertices[] = {
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
-void processInput(GLFWwindow* window);
+void processInput(GLFWwindow* window, float tickSeconds);
 float getTerrainHeightAt(float worldX, float worldZ);
+glm::vec3 renderCameraPos();
+glm::mat4 cameraView();
+glm::mat4 cameraProjection();
+void pickTerrain(GLFWwindow* window);
 
 // ============================================================================
-// TERRAIN MESH GENERATION
+// COLLISION DETECTION
 // ============================================================================
 
-struct TerrainVertex
+float getTerrainHeightAt(float worldX, float worldZ)
 {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texCoord;
-};
+    if (g_heightmap.data) return heightmapHeightAt(g_heightmap, worldX, worldZ);
+    if (g_tileStreamer) return g_tileStreamer->heightAt(worldX, worldZ);
+    if (g_collisionGrid) return g_collisionGrid->heightAt(worldX, worldZ);
+    return 0.0f;
+}
 
-struct TerrainMesh
+// Camera position blended between the last two simulation ticks
+glm::vec3 renderCameraPos()
 {
-    std::vector<TerrainVertex> vertices;
-    std::vector<unsigned int> indices;
-    int gridWidth;
-    int gridHeight;
-};
+    return glm::mix(previousCameraPos, cameraPos, simulationAlpha);
+}
 
-TerrainMesh generateTerrainMesh(const unsigned char* heightmapData, 
-                                int imgWidth, int imgHeight, int step)
+glm::mat4 cameraView()
 {
-    TerrainMesh mesh;
-    
-    mesh.gridWidth = imgWidth / step;
-    mesh.gridHeight = imgHeight / step;
-    
-    // Reserve space for vertices
-    mesh.vertices.resize(mesh.gridWidth * mesh.gridHeight);
-    
-    // Generate vertex positions and UVs
-    for (int j = 0; j < mesh.gridHeight; ++j)
-    {
-        for (int i = 0; i < mesh.gridWidth; ++i)
-        {
-            // Sample heightmap
-            int imgX = i * step;
-            int imgY = j * step;
-            int imgIndex = imgY * imgWidth + imgX;
-            unsigned char heightByte = heightmapData[imgIndex];
-            float normalizedHeight = static_cast<float>(heightByte) / 255.0f;
-            
-            // Map grid position to 3D X, Z coordinates
-            // World: -30 to 30 (60x60 world)
-            float x = (static_cast<float>(i) / (mesh.gridWidth - 1)) * 60.0f - 30.0f;
-            float z = (static_cast<float>(j) / (mesh.gridHeight - 1)) * 60.0f - 30.0f;
-            float y = normalizedHeight * HEIGHT_SCALE;
-            
-            // Calculate UV coordinates (0 to 1)
-            float u = static_cast<float>(i) / (mesh.gridWidth - 1);
-            float v = static_cast<float>(j) / (mesh.gridHeight - 1);
-            
-            // Store vertex data
-            int vertexIndex = j * mesh.gridWidth + i;
-            mesh.vertices[vertexIndex].position = glm::vec3(x, y, z);
-            mesh.vertices[vertexIndex].texCoord = glm::vec2(u, v);
-        }
-    }
-    
-    // Compute normals using height differences
-    for (int j = 0; j < mesh.gridHeight; ++j)
-    {
-        for (int i = 0; i < mesh.gridWidth; ++i)
-        {
-            auto getHeight = [&](int gi, int gj) -> float {
-                gi = std::max(0, std::min(gi, mesh.gridWidth - 1));
-                gj = std::max(0, std::min(gj, mesh.gridHeight - 1));
-                return mesh.vertices[gj * mesh.gridWidth + gi].position.y;
-            };
-            
-            float hLeft  = getHeight(i - 1, j);
-            float hRight = getHeight(i + 1, j);
-            float hDown  = getHeight(i, j - 1);
-            float hUp    = getHeight(i, j + 1);
-            
-            glm::vec3 tangentX = glm::vec3(2.0f, hRight - hLeft, 0.0f);
-            glm::vec3 tangentZ = glm::vec3(0.0f, hUp - hDown, 2.0f);
-            glm::vec3 normal = glm::normalize(glm::cross(tangentZ, tangentX));
-            
-            int vertexIndex = j * mesh.gridWidth + i;
-            mesh.vertices[vertexIndex].normal = normal;
-        }
-    }
-    
-    // Generate indices for triangle mesh
-    mesh.indices.reserve((mesh.gridWidth - 1) * (mesh.gridHeight - 1) * 6);
-    
-    for (int j = 0; j < mesh.gridHeight - 1; ++j)
-    {
-        for (int i = 0; i < mesh.gridWidth - 1; ++i)
-        {
-            unsigned int topLeft     = j * mesh.gridWidth + i;
-            unsigned int topRight    = j * mesh.gridWidth + (i + 1);
-            unsigned int bottomLeft  = (j + 1) * mesh.gridWidth + i;
-            unsigned int bottomRight = (j + 1) * mesh.gridWidth + (i + 1);
-            
-            // First triangle (top-left, bottom-left, top-right)
-            mesh.indices.push_back(topLeft);
-            mesh.indices.push_back(bottomLeft);
-            mesh.indices.push_back(topRight);
-            
-            // Second triangle (top-right, bottom-left, bottom-right)
-            mesh.indices.push_back(topRight);
-            mesh.indices.push_back(bottomLeft);
-            mesh.indices.push_back(bottomRight);
-        }
-    }
-    
-    return mesh;
+    glm::vec3 eye = renderCameraPos();
+    return glm::lookAt(eye, eye + cameraFront, cameraUp);
 }
 
-// ============================================================================
-// COLLISION DETECTION
-// ============================================================================
+glm::mat4 cameraProjection()
+{
+    float aspect = framebufferHeight > 0
+        ? static_cast<float>(framebufferWidth) / framebufferHeight : 800.0f / 600.0f;
+    return glm::perspective(glm::radians(fov), aspect, 0.1f, 180.0f);  // Far plane for 60x60 map
+}
 
-float getTerrainHeightAt(float worldX, float worldZ)
+// Casts a ray from the camera through the cursor (or the screen centre while
+// looking around) and reports the terrain point it hits
+void pickTerrain(GLFWwindow* window)
 {
-    if (!g_terrainMesh) return 0.0f;
-    
-    // Convert world coordinates back to grid coordinates
-    // World space: -30 to 30, Grid space: 0 to gridWidth-1
-    float gridX = (worldX + 30.0f) / 60.0f * (g_terrainMesh->gridWidth - 1);
-    float gridZ = (worldZ + 30.0f) / 60.0f * (g_terrainMesh->gridHeight - 1);
-    
-    // Clamp to valid grid range
-    if (gridX < 0 || gridX >= g_terrainMesh->gridWidth - 1 ||
-        gridZ < 0 || gridZ >= g_terrainMesh->gridHeight - 1)
+    if (!g_terrainRaycaster)
     {
-        return 0.0f;  // Outside terrain bounds
+        std::cout << "Terrain picking unavailable: no collision grid\n";
+        return;
     }
-    
-    // Get integer grid coordinates
-    int x0 = static_cast<int>(gridX);
-    int z0 = static_cast<int>(gridZ);
-    int x1 = x0 + 1;
-    int z1 = z0 + 1;
-    
-    // Get fractional part for interpolation
-    float fx = gridX - x0;
-    float fz = gridZ - z0;
-    
-    // Get heights at four corners of grid cell
-    float h00 = g_terrainMesh->vertices[z0 * g_terrainMesh->gridWidth + x0].position.y;
-    float h10 = g_terrainMesh->vertices[z0 * g_terrainMesh->gridWidth + x1].position.y;
-    float h01 = g_terrainMesh->vertices[z1 * g_terrainMesh->gridWidth + x0].position.y;
-    float h11 = g_terrainMesh->vertices[z1 * g_terrainMesh->gridWidth + x1].position.y;
-    
-    // Bilinear interpolation
-    float h0 = h00 * (1 - fx) + h10 * fx;
-    float h1 = h01 * (1 - fx) + h11 * fx;
-    float height = h0 * (1 - fz) + h1 * fz;
-    
-    return height;
+
+    // Cursor positions are in window coordinates, which differ from
+    // framebuffer pixels on high-DPI displays
+    double cursorX = 0.0, cursorY = 0.0;
+    int windowWidth = 0, windowHeight = 0;
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    if (windowWidth <= 0 || windowHeight <= 0)
+        return;
+    float ndcX = cameraControlActive ? 0.0f : static_cast<float>(2.0 * cursorX / windowWidth - 1.0);
+    float ndcY = cameraControlActive ? 0.0f : static_cast<float>(1.0 - 2.0 * cursorY / windowHeight);
+
+    // Unproject onto the near and far planes; the ray runs between them
+    glm::mat4 inverseViewProjection = glm::inverse(cameraProjection() * cameraView());
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 ray = glm::vec3(farPoint) / farPoint.w - origin;
+    float length = glm::length(ray);
+
+    TerrainRayHit hit;
+    if (g_terrainRaycaster->raycast(origin, ray / length, length, hit))
+        std::cout << "Picked terrain at (" << hit.position.x << ", " << hit.position.y << ", "
+                  << hit.position.z << "), " << hit.distance << " from the camera\n";
+    else
+        std::cout << "No terrain under the cursor\n";
+}
+
+// Milliseconds since a steady_clock time point
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printGeneratedMesh(const TerrainMesh& terrain, double meshMs, unsigned int threads)
+{
+    std::cout << "Generated terrain mesh:\n";
+    std::cout << "  Vertices: " << terrain.vertexCount() << "\n";
+    std::cout << "  Triangles: " << terrain.triangleCount() << "\n";
+    std::cout << "  Grid size: " << terrain.gridWidth << " x " << terrain.gridHeight << "\n";
+    std::cout << "  Build time: " << meshMs << " ms (" << threads << " threads)\n";
+    std::cout << "  Vertex format: "
+              << (terrain.format == TerrainVertexFormat::Compact ? "compact" : "full")
+              << " (" << terrain.vertexBytes() / terrain.vertexCount() << " bytes/vertex, "
+              << terrain.vertexBytes() / (1024.0 * 1024.0) << " MB VBO)\n";
+    std::cout << "  Chunks: " << terrain.chunksX << " x " << terrain.chunksZ
+              << " (shared 16-bit index buffer, "
+              << terrain.indices.size() * sizeof(uint16_t) / 1024.0 << " KB)\n";
 }
 
 // ============================================================================
@@ -266,6 +293,87 @@ float getTerrainHeightAt(float worldX, float worldZ)
 
 int main(int argc, char* argv[])
 {
+    // Time to first frame and to full quality are measured from here
+    auto programStart = std::chrono::steady_clock::now();
+
+    // Parse command line: [--bench] [--threads=N] [--vertex-format=full|compact]
+    //                     [--tess=screen|distance] [--backend=mesh|cdlod|clipmap|displaced]
+    //                     [--downsample=box|max|point] [--cache-dir=DIR]
+    //                     [--no-cache] [--convert-tiled=OUT.hmt]
+    //                     [--tile-budget=MB] [--vram-budget=MB]
+    //                     [--sync-uploads] [--tick-rate=HZ] [--vsync] [heightmap]
+    const char* heightmapPath = "assets/heightmapper-1764410934226.png";  // Default fallback
+    bool runBench = false;
+    const char* tiledOutputPath = nullptr;
+    for (int a = 1; a < argc; ++a)
+    {
+        if (std::strcmp(argv[a], "--bench") == 0)
+            runBench = true;
+        else if (std::strncmp(argv[a], "--threads=", 10) == 0)
+            meshThreadCount = std::max(0, std::atoi(argv[a] + 10));
+        else if (std::strcmp(argv[a], "--vertex-format=full") == 0)
+            terrainVertexFormat = TerrainVertexFormat::Full;
+        else if (std::strcmp(argv[a], "--vertex-format=compact") == 0)
+            terrainVertexFormat = TerrainVertexFormat::Compact;
+        else if (std::strcmp(argv[a], "--tess=screen") == 0)
+            screenSpaceTessellation = true;
+        else if (std::strcmp(argv[a], "--tess=distance") == 0)
+            screenSpaceTessellation = false;
+        else if (std::strcmp(argv[a], "--backend=mesh") == 0)
+            terrainBackend = TerrainBackend::Mesh;
+        else if (std::strcmp(argv[a], "--backend=cdlod") == 0)
+            terrainBackend = TerrainBackend::CDLOD;
+        else if (std::strcmp(argv[a], "--backend=clipmap") == 0)
+            terrainBackend = TerrainBackend::Clipmap;
+        else if (std::strcmp(argv[a], "--backend=displaced") == 0)
+            terrainBackend = TerrainBackend::Displaced;
+        else if (std::strcmp(argv[a], "--downsample=box") == 0)
+            downsampleFilter = DownsampleFilter::Box;
+        else if (std::strcmp(argv[a], "--downsample=max") == 0)
+            downsampleFilter = DownsampleFilter::Max;
+        else if (std::strcmp(argv[a], "--downsample=point") == 0)
+            downsampleFilter = DownsampleFilter::Point;
+        else if (std::strncmp(argv[a], "--cache-dir=", 12) == 0)
+            terrainCacheDir = argv[a] + 12;
+        else if (std::strcmp(argv[a], "--no-cache") == 0)
+            terrainCacheEnabled = false;
+        else if (std::strncmp(argv[a], "--convert-tiled=", 16) == 0)
+            tiledOutputPath = argv[a] + 16;
+        else if (std::strncmp(argv[a], "--tile-budget=", 14) == 0)
+            tileStreamBudget = static_cast<size_t>(std::max(1, std::atoi(argv[a] + 14))) << 20;
+        else if (std::strncmp(argv[a], "--vram-budget=", 14) == 0)
+            vramBudget = static_cast<size_t>(std::max(1, std::atoi(argv[a] + 14))) << 20;
+        else if (std::strcmp(argv[a], "--sync-uploads") == 0)
+            asyncUploads = false;
+        else if (std::strncmp(argv[a], "--tick-rate=", 12) == 0)
+            simulationTickRate = std::max(1, std::atoi(argv[a] + 12));
+        else if (std::strcmp(argv[a], "--vsync") == 0)
+            vsyncEnabled = true;
+        else
+            heightmapPath = argv[a];  // Use command-line argument
+    }
+
+    if (runBench)
+        return runBenchmarks(heightmapPath);
+
+    // Re-encode the heightmap as a tiled .hmt file and exit
+    if (tiledOutputPath)
+    {
+        Heightmap source = Heightmap::load(heightmapPath);
+        std::string error = source.error();
+        ThreadPool pool(meshThreadCount);
+        if (!source.isValid() ||
+            !writeTiledHeightmap(tiledOutputPath, source.view(), TILED_HEIGHTMAP_TILE_SIZE, pool, error))
+        {
+            std::cerr << "Failed to convert heightmap: " << heightmapPath << "\n";
+            std::cerr << "Reason: " << error << "\n";
+            return -1;
+        }
+        std::cout << "Wrote " << tiledOutputPath << " (" << source.view().width << " x "
+                  << source.view().height << " " << heightmapFormatName(source.view().format) << ")\n";
+        return 0;
+    }
+
     // Initialize GLFW
     if (!glfwInit())
     {
@@ -290,6 +398,8 @@ int main(int argc, char* argv[])
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(vsyncEnabled ? 1 : 0);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
     // Initialize GLAD
     if (!gladLoadGL((GLADloadfunc)glfwGetProcAddress))
@@ -312,94 +422,211 @@ int main(int argc, char* argv[])
     // ========================================================================
     // LOAD HEIGHTMAP
     // ========================================================================
-    
-    const char* heightmapPath = "assets/mtfuji.png";
-    if (argc >= 2)
+
+    // The mesh backend's buffers depend only on the heightmap bytes and a few
+    // settings, so they are baked to <cache dir>/<hash>.terrain. A warm start
+    // maps that file and uploads from it without decoding the heightmap or
+    // generating the mesh.
+    TerrainCache terrainCache;
+    TerrainCacheKey terrainCacheKeyValue;
+    bool haveTerrainCacheKey = false;
+    if (terrainBackend == TerrainBackend::Mesh && terrainCacheEnabled)
     {
-        heightmapPath = argv[1];  // Use command-line argument
+        auto cacheStart = std::chrono::steady_clock::now();
+        haveTerrainCacheKey = terrainCacheKey(heightmapPath, terrainVertexFormat,
+                                              downsampleFilter, terrainCacheKeyValue);
+        std::string cachePath = terrainCachePath(terrainCacheDir, terrainCacheKeyValue);
+        if (haveTerrainCacheKey && terrainCache.open(cachePath, terrainCacheKeyValue))
+        {
+            double cacheMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - cacheStart).count();
+            std::cout << "Loaded baked terrain: " << cachePath << "\n";
+            std::cout << "  Heightmap: " << heightmapPath << "\n";
+            std::cout << "  Load time: " << cacheMs << " ms (hash + map, "
+                      << terrainCache.fileBytes() / (1024.0 * 1024.0) << " MB)\n";
+        }
     }
-    else
+
+    // The clipmap pages tiled pyramids in as the camera moves instead of
+    // loading them, so maps larger than memory work
+    const size_t pathLength = std::strlen(heightmapPath);
+    const bool streamTiles = terrainBackend == TerrainBackend::Clipmap && pathLength > 4 &&
+                             std::strcmp(heightmapPath + pathLength - 4, ".hmt") == 0;
+    TileStreamer tileStreamer(tileStreamBudget);
+    if (streamTiles)
     {
-        heightmapPath = "assets/heightmapper-1764410934226.png";  // Default fallback
+        if (!tileStreamer.open(heightmapPath))
+        {
+            std::cerr << "Failed to load heightmap: " << heightmapPath << "\n";
+            std::cerr << "Reason: " << tileStreamer.error() << "\n";
+            glfwTerminate();
+            return -1;
+        }
+        std::cout << "Streaming heightmap: " << heightmapPath << "\n";
+        std::cout << "  Size: " << tileStreamer.width() << " x " << tileStreamer.height() << " "
+                  << heightmapFormatName(tileStreamer.format()) << ", " << tileStreamer.levelCount()
+                  << " levels of " << tileStreamer.tileSize() << "x" << tileStreamer.tileSize()
+                  << " tiles\n";
+        std::cout << "  Tile budget: " << (tileStreamer.memoryBudget() >> 20) << " MB\n";
     }
-    int imgWidth = 0, imgHeight = 0, imgChannels = 0;
-    
-    unsigned char* imageData = stbi_load(heightmapPath, &imgWidth, &imgHeight, 
-                                         &imgChannels, 1);
-    
-    if (!imageData)
+
+    // The mesh backend loads its heightmap on the background build (see
+    // BUILD TERRAIN), so the window can draw while that runs
+    Heightmap heightmapFile;
+    HeightmapView heightmap;
+    if (terrainBackend != TerrainBackend::Mesh && !streamTiles)
     {
-        std::cerr << "Failed to load heightmap: " << heightmapPath << "\n";
-        std::cerr << "Reason: " << stbi_failure_reason() << "\n";
-        glfwTerminate();
-        return -1;
+        // Raw .r16/.r32 files are memory-mapped and used in place; images are
+        // decoded with stb_image, 16-bit PNGs at full depth
+        auto loadStart = std::chrono::steady_clock::now();
+        heightmapFile = Heightmap::load(heightmapPath);
+        double loadMs = millisecondsSince(loadStart);
+
+        if (!heightmapFile.isValid())
+        {
+            std::cerr << "Failed to load heightmap: " << heightmapPath << "\n";
+            std::cerr << "Reason: " << heightmapFile.error() << "\n";
+            glfwTerminate();
+            return -1;
+        }
+
+        heightmap = heightmapFile.view();
+        std::cout << "Loaded heightmap: " << heightmapPath << "\n";
+        std::cout << "  Size: " << heightmap.width << " x " << heightmap.height << "\n";
+        std::cout << "  Samples: " << heightmapFormatName(heightmap.format)
+                  << (heightmapFile.isMapped() ? " (memory-mapped)" : " (decoded)") << "\n";
+        std::cout << "  Load time: " << loadMs << " ms, peak "
+                  << heightmapFile.peakLoadBytes() / (1024.0 * 1024.0) << " MB\n";
     }
-    
-    std::cout << "Loaded heightmap: " << heightmapPath << "\n";
-    std::cout << "  Size: " << imgWidth << " x " << imgHeight << "\n";
-    std::cout << "  Channels: 1 (grayscale)\n";
 
     // ========================================================================
-    // GENERATE TERRAIN MESH
+    // BUILD TERRAIN
     // ========================================================================
     
-    TerrainMesh terrain = generateTerrainMesh(imageData, imgWidth, imgHeight, 
-                                              HEIGHTMAP_STEP);
-    stbi_image_free(imageData);
-    
-    // Set global pointer for collision detection
-    g_terrainMesh = &terrain;
-    
-    std::cout << "Generated terrain mesh:\n";
-    std::cout << "  Vertices: " << terrain.vertices.size() << "\n";
-    std::cout << "  Triangles: " << terrain.indices.size() / 3 << "\n";
-    std::cout << "  Grid size: " << terrain.gridWidth << " x " << terrain.gridHeight << "\n";
+    ThreadPool meshPool(meshThreadCount);
+    std::unique_ptr<TerrainMesh> terrainMesh;
+    auto gpuResidency = std::make_unique<GpuResidency>(vramBudget);
+    GpuUploader gpuUploader;
+    if (asyncUploads && terrainBackend == TerrainBackend::Mesh && !gpuUploader.start(window))
+        std::cerr << "Warning: could not create a loader context, uploading synchronously\n";
+    std::unique_ptr<TerrainRenderer> terrainRenderer;
+    auto meshStart = std::chrono::steady_clock::now();
+
+    // Progressive mesh startup: the background build's preview is drawn
+    // first, then the full mesh renderer is warmed up behind it and swapped
+    // in once its visible chunks are on the GPU. The preview mesh is kept
+    // until exit, since uploads may still be reading it after the swap.
+    std::unique_ptr<TerrainBuild> terrainBuild;
+    std::unique_ptr<TerrainMesh> previewMesh;
+    std::unique_ptr<CollisionGrid> collisionGrid;
+    std::unique_ptr<TerrainRaycaster> terrainRaycaster;
+    std::unique_ptr<MeshTerrainRenderer> pendingRenderer;
+    MeshTerrainRenderer* fullMeshRenderer = nullptr;
+
+    // Texture backends keep the heightmap in memory for collision (and, for
+    // the clipmap, to stream strips from)
+    if (terrainBackend == TerrainBackend::CDLOD)
+    {
+        auto cdlod = std::make_unique<CdlodTerrainRenderer>(heightmap, meshPool, *gpuResidency);
+        double buildMs = millisecondsSince(meshStart);
+        g_heightmap = heightmap;
+
+        std::cout << "Built CDLOD quadtree:\n";
+        std::cout << "  Levels: " << cdlod->levelCount()
+                  << " (" << CDLOD_GRID_SIZE << "x" << CDLOD_GRID_SIZE << " grid patch)\n";
+        std::cout << "  Min/max tree: " << cdlod->treeBytes() / 1024.0 << " KB\n";
+        std::cout << "  Height texture: " << cdlod->textureBytes() / (1024.0 * 1024.0) << " MB\n";
+        std::cout << "  Build time: " << buildMs << " ms (" << meshPool.size() << " threads)\n";
+        terrainRenderer = std::move(cdlod);
+    }
+    else if (terrainBackend == TerrainBackend::Displaced)
+    {
+        auto displaced = std::make_unique<DisplacedTerrainRenderer>(heightmap, meshPool, *gpuResidency);
+        double buildMs = millisecondsSince(meshStart);
+        g_heightmap = heightmap;
+
+        std::cout << "Displaced terrain grid:\n";
+        std::cout << "  Grid size: " << displaced->gridWidth() << " x " << displaced->gridHeight()
+                  << " (" << displaced->chunkCount() << " chunks, no vertex buffer)\n";
+        std::cout << "  Index buffer: " << displaced->indexBytes() / 1024.0 << " KB\n";
+        std::cout << "  Height texture: " << displaced->textureBytes() / (1024.0 * 1024.0) << " MB\n";
+        std::cout << "  Build time: " << buildMs << " ms (" << meshPool.size() << " threads)\n";
+        terrainRenderer = std::move(displaced);
+    }
+    else if (terrainBackend == TerrainBackend::Clipmap)
+    {
+        std::unique_ptr<ClipmapTerrainRenderer> clipmap;
+        if (streamTiles)
+        {
+            clipmap = std::make_unique<ClipmapTerrainRenderer>(tileStreamer, *gpuResidency);
+            g_tileStreamer = &tileStreamer;
+        }
+        else
+        {
+            clipmap = std::make_unique<ClipmapTerrainRenderer>(heightmap, *gpuResidency);
+            g_heightmap = heightmap;
+        }
 
-    // ========================================================================
-    // SETUP OPENGL BUFFERS
-    // ========================================================================
-    
-    unsigned int terrainVAO, terrainVBO, terrainEBO;
-    glGenVertexArrays(1, &terrainVAO);
-    glGenBuffers(1, &terrainVBO);
-    glGenBuffers(1, &terrainEBO);
-    
-    glBindVertexArray(terrainVAO);
-    
-    // Upload vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, terrainVBO);
-    glBufferData(GL_ARRAY_BUFFER, 
-                 terrain.vertices.size() * sizeof(TerrainVertex),
-                 terrain.vertices.data(), 
-                 GL_STATIC_DRAW);
-    
-    // Upload index data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 terrain.indices.size() * sizeof(unsigned int),
-                 terrain.indices.data(),
-                 GL_STATIC_DRAW);
-    
-    // Position attribute (location = 0)
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)0);
-    
-    // Normal attribute (location = 1)
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), 
-                        (void*)offsetof(TerrainVertex, normal));
-    
-    // UV attribute (location = 2)
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), 
-                        (void*)offsetof(TerrainVertex, texCoord));
-    
-    glBindVertexArray(0);
+        std::cout << "Geometry clipmap:\n";
+        std::cout << "  Levels: " << clipmap->levelCount()
+                  << " (" << CLIPMAP_GRID_SIZE << "x" << CLIPMAP_GRID_SIZE << " quads each)\n";
+        std::cout << "  Height textures: " << clipmap->textureBytes() / 1024.0 << " KB\n";
+        terrainRenderer = std::move(clipmap);
+    }
+    else if (terrainCache.isOpen())
+    {
+        // Buffers go to the GPU straight from the mapping; collision reads
+        // the cached grid in place
+        const TerrainMeshBuffers& baked = terrainCache.buffers();
+        g_heightmap = terrainCache.grid();
+
+        std::cout << "Baked terrain mesh:\n";
+        std::cout << "  Grid size: " << baked.gridWidth << " x " << baked.gridHeight << "\n";
+        std::cout << "  Vertex format: "
+                  << (baked.format == TerrainVertexFormat::Compact ? "compact" : "full")
+                  << " (" << baked.vertexBytes / (1024.0 * 1024.0) << " MB VBO)\n";
+        std::cout << "  Chunks: " << baked.chunkCount << "\n";
+
+        auto mesh = std::make_unique<MeshTerrainRenderer>(baked, *gpuResidency, &gpuUploader);
+        fullMeshRenderer = mesh.get();
+        terrainRenderer = std::move(mesh);
+    }
+    else
+    {
+        TerrainBuild::Settings buildSettings;
+        buildSettings.heightmapPath = heightmapPath;
+        buildSettings.filter = downsampleFilter;
+        buildSettings.format = terrainVertexFormat;
+        if (haveTerrainCacheKey)
+        {
+            buildSettings.cachePath = terrainCachePath(terrainCacheDir, terrainCacheKeyValue);
+            buildSettings.cacheKey = terrainCacheKeyValue;
+        }
+        terrainBuild = std::make_unique<TerrainBuild>(buildSettings, meshPool);
+        std::cout << "Building terrain in the background: " << heightmapPath << "\n";
+    }
+
+    // Picking and camera sweeps run against a collision grid. Backends that
+    // keep the heightmap in memory get one here; the mesh build delivers its
+    // own with the preview.
+    if (g_heightmap.data)
+    {
+        collisionGrid = std::make_unique<CollisionGrid>(g_heightmap);
+        g_collisionGrid = collisionGrid.get();
+        terrainRaycaster = std::make_unique<TerrainRaycaster>(*collisionGrid);
+        g_terrainRaycaster = terrainRaycaster.get();
+        std::cout << "Picking grid: " << collisionGrid->width() << " x " << collisionGrid->height()
+                  << ", " << (collisionGrid->bytes() + terrainRaycaster->bytes()) / 1024.0
+                  << " KB with its min/max pyramid\n";
+    }
+
+    const GpuResidencyStats& vramAtStart = gpuResidency->stats();
+    std::cout << "GPU residency: " << vramAtStart.totalBytes() / (1024.0 * 1024.0) << " MB of "
+              << (vramBudget >> 20) << " MB budget";
+    if (vramAtStart.residentTiles > 0)
+        std::cout << " (" << vramAtStart.residentTiles << " chunks resident)";
+    std::cout << "\n";
 
-    // ========================================================================
-    // SETUP SKYBOX
-    // ========================================================================
-    
     // ========================================================================
     // SETUP SKYBOX
     // ========================================================================
@@ -424,158 +651,445 @@ int main(int argc, char* argv[])
     // LOAD SHADERS
     // ========================================================================
     
-    Shader terrainShader("shaders/vertex.glsl", "shaders/fragment.glsl",
-                         "shaders/tess_control.glsl", "shaders/tess_eval.glsl");
-    
     Shader skyboxShader("shaders/skybox_vertex.glsl", "shaders/skybox_fragment.glsl");
     
-    if (!terrainShader.isValid() || !skyboxShader.isValid())
+    if ((terrainRenderer && !terrainRenderer->isValid()) || !skyboxShader.isValid())
     {
         std::cerr << "ERROR: Failed to load shaders. Check shaders/ directory.\n";
+        terrainBuild.reset();
+        gpuUploader.stop();
+        terrainRenderer.reset();   // Needs the GL context
+        gpuResidency.reset();
         glfwTerminate();
         return -1;
     }
     
     std::cout << "Shaders loaded successfully\n";
-    
-    // Set tessellation patch size
-    glPatchParameteri(GL_PATCH_VERTICES, 3);
+
+    // Primitives generated by the terrain draw. Two queries in flight so
+    // reading last frame's result never stalls on the GPU.
+    unsigned int primitiveQueries[2];
+    glGenQueries(2, primitiveQueries);
+    bool primitiveQueryPending[2] = { false, false };
+    int frameParity = 0;
+
+    // Frame-to-frame times, and separately those of frames that started or
+    // were waiting on chunk uploads, printed on exit
+    FrameHistogram frameTimes;
+    FrameHistogram uploadFrameTimes;
+    bool uploadsLastFrame = false;
+    size_t framesRendered = 0;
+
+    double firstFrameMs = -1.0;
+    double fullQualityMs = -1.0;
+    int exitCode = 0;
+
+    // Simulation ticks and what they cost, printed on exit
+    FixedTimestep simulationClock(simulationTickRate);
+    const float tickSeconds = static_cast<float>(simulationClock.tickSeconds());
+    double tickTotalMs = 0.0;
+    double tickMaxMs = 0.0;
+
+    // Give the background build until the first-frame budget to produce
+    // the preview, so the first frame is rarely just sky
+    while (terrainBuild && !terrainBuild->previewReady() && !terrainBuild->failed() &&
+           millisecondsSince(programStart) < STARTUP_FIRST_FRAME_BUDGET_MS)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Between the two threads: frame packets one way; the collision grid
+    // from the mesh build, the window title and failure the other
+    FramePacketExchange framePackets;
+    std::mutex renderStatusMutex;
+    std::unique_ptr<CollisionGrid> collisionGridHandoff;
+    std::string windowTitle;
+    std::atomic<bool> renderStopped{ false };
 
     // ========================================================================
-    // RENDER LOOP
+    // RENDER THREAD
     // ========================================================================
-    
-    while (!glfwWindowShouldClose(window))
+
+    // Owns the GL context from here until it stops: polls the mesh build,
+    // collects uploads and draws each packet the simulation thread hands
+    // over. It touches no camera or input state of its own.
+    auto renderLoop = [&]()
+    {
+        glfwMakeContextCurrent(window);
+        auto lastFrameStart = std::chrono::steady_clock::now();
+        auto lastTitleUpdate = lastFrameStart;
+        int viewportWidth = 0;
+        int viewportHeight = 0;
+        FramePacket packet;
+
+        while (framePackets.acquire(packet))
+        {
+            auto frameStart = std::chrono::steady_clock::now();
+            double frameMs = std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count();
+            lastFrameStart = frameStart;
+            if (framesRendered > 0)
+            {
+                frameTimes.add(frameMs);
+                if (uploadsLastFrame)
+                    uploadFrameTimes.add(frameMs);
+            }
+            uint64_t uploadsBefore = gpuResidency->stats().uploads;
+
+            // Chunk uploads finished since last frame can be drawn now
+            gpuResidency->beginFrame();
+            if (gpuUploader.isRunning())
+                gpuResidency->collectUploads(gpuUploader);
+
+            // Pick up what the background build has finished
+            if (terrainBuild)
+            {
+                if (terrainBuild->failed())
+                {
+                    std::cerr << "Failed to load heightmap: " << heightmapPath << "\n";
+                    std::cerr << "Reason: " << terrainBuild->error() << "\n";
+                    exitCode = -1;
+                    break;
+                }
+
+                std::unique_ptr<TerrainMesh> preview = terrainBuild->takePreview();
+                if (preview)
+                {
+                    const TerrainBuild::LoadInfo& load = terrainBuild->loadInfo();
+                    std::cout << "Loaded heightmap: " << heightmapPath << "\n";
+                    std::cout << "  Downsampled to: " << load.width << " x " << load.height
+                              << " (step " << HEIGHTMAP_STEP << ", " << downsampleFilterName(downsampleFilter)
+                              << " filter)\n";
+                    std::cout << "  Samples: " << heightmapFormatName(load.format)
+                              << (load.mapped ? " (memory-mapped)" : " (streamed)") << "\n";
+                    std::cout << "  Load time: " << load.loadMs << " ms, peak "
+                              << load.peakLoadBytes / (1024.0 * 1024.0) << " MB\n";
+                    std::cout << "Preview terrain: " << preview->gridWidth << " x " << preview->gridHeight
+                              << " grid (every " << load.previewStep << " samples), built in "
+                              << load.previewMs << " ms\n";
+
+                    // Collision belongs to the simulation thread
+                    {
+                        std::lock_guard<std::mutex> lock(renderStatusMutex);
+                        collisionGridHandoff = terrainBuild->takeCollisionGrid();
+                    }
+
+                    previewMesh = std::move(preview);
+                    terrainRenderer = std::make_unique<MeshTerrainRenderer>(*previewMesh, *gpuResidency,
+                                                                            &gpuUploader);
+                }
+
+                std::unique_ptr<TerrainMesh> mesh = terrainBuild->takeMesh();
+                if (mesh)
+                {
+                    terrainMesh = std::move(mesh);
+                    if (terrainBuild->cacheWritten())
+                        std::cout << "Baked terrain to: " << terrainBuild->cacheMessage() << "\n";
+                    else if (!terrainBuild->cacheMessage().empty())
+                        std::cerr << "Warning: could not bake terrain cache: "
+                                  << terrainBuild->cacheMessage() << "\n";
+                    printGeneratedMesh(*terrainMesh, terrainBuild->meshMs(), meshPool.size());
+                    if (firstFrameMs >= 0.0)
+                        std::cout << "  Time to first frame: " << firstFrameMs << " ms\n";
+
+                    pendingRenderer = std::make_unique<MeshTerrainRenderer>(*terrainMesh, *gpuResidency,
+                                                                            &gpuUploader);
+                    fullMeshRenderer = pendingRenderer.get();
+                    terrainBuild.reset();
+                }
+
+                if (terrainRenderer && !terrainRenderer->isValid())
+                {
+                    std::cerr << "ERROR: Failed to load shaders. Check shaders/ directory.\n";
+                    exitCode = -1;
+                    break;
+                }
+            }
+
+            const TerrainFrame& frame = packet.terrain;
+            if (frame.viewportWidth != viewportWidth || frame.viewportHeight != viewportHeight)
+            {
+                viewportWidth = frame.viewportWidth;
+                viewportHeight = frame.viewportHeight;
+                glViewport(0, 0, viewportWidth, viewportHeight);
+            }
+
+            // Toggle wireframe mode
+            glPolygonMode(GL_FRONT_AND_BACK, packet.wireframe ? GL_LINE : GL_FILL);
+
+            // Clear buffers
+            glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // ===== RENDER SKYBOX =====
+            glDepthFunc(GL_LEQUAL); // Change depth function for skybox
+            skyboxShader.use();
+            skyboxShader.setMat4("view", &frame.view[0][0]);
+            skyboxShader.setMat4("projection", &frame.projection[0][0]);
+
+            glBindVertexArray(skyboxVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS); // Restore default depth function
+
+            // ===== RENDER TERRAIN =====
+            // Collect the query issued two frames ago, if the GPU is done with it
+            unsigned int query = primitiveQueries[frameParity];
+            if (primitiveQueryPending[frameParity])
+            {
+                GLint available = 0;
+                glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &terrainPrimitives);
+                    primitiveQueryPending[frameParity] = false;
+                }
+            }
+            // With nothing on screen yet the full mesh draws straight away
+            if (pendingRenderer && !terrainRenderer)
+                terrainRenderer = std::move(pendingRenderer);
+
+            bool issueQuery = terrainRenderer && !primitiveQueryPending[frameParity];
+            if (issueQuery)
+                glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+
+            if (terrainRenderer)
+                terrainRenderer->render(frame);
+
+            if (issueQuery)
+            {
+                glEndQuery(GL_PRIMITIVES_GENERATED);
+                primitiveQueryPending[frameParity] = true;
+            }
+            frameParity ^= 1;
+
+            // Full quality: every chunk in view drawn from the full mesh, or
+            // for the texture backends, the first frame
+            bool fullQuality = fullMeshRenderer
+                ? terrainRenderer.get() == fullMeshRenderer && fullMeshRenderer->chunksWaiting() == 0
+                : terrainRenderer && !terrainBuild;
+            if (fullQuality && fullQualityMs < 0.0)
+            {
+                fullQualityMs = millisecondsSince(programStart);
+                std::cout << "  Time to full quality: " << fullQualityMs << " ms\n";
+            }
+
+            // Otherwise it replaces the preview once it can draw everything
+            // in view. It is warmed up after the preview has drawn, so its
+            // uploads only evict chunks the preview no longer needs.
+            if (pendingRenderer && pendingRenderer->prepare(frame))
+                terrainRenderer = std::move(pendingRenderer);
+
+            // Once every chunk is on the GPU nothing is evicted again, and
+            // collision has its own grid, so the CPU mesh can go. If the mesh
+            // does not fit --vram-budget it stays, to upload evicted chunks from.
+            if (terrainMesh && terrainRenderer.get() == fullMeshRenderer && gpuUploader.inFlight() == 0 &&
+                fullMeshRenderer->allChunksResident())
+            {
+                size_t residentBefore = processResidentBytes();
+                fullMeshRenderer->releaseVertexSource();
+                terrainMesh.reset();
+                previewMesh.reset();
+                releaseFreedMemory();
+                size_t residentAfter = processResidentBytes();
+                std::cout << "Freed CPU terrain mesh after upload: RSS "
+                          << residentBefore / (1024.0 * 1024.0) << " MB -> "
+                          << residentAfter / (1024.0 * 1024.0) << " MB\n";
+            }
+
+            // Culling counters for the title a few times per second; the
+            // simulation thread sets it
+            if (terrainRenderer && frameStart - lastTitleUpdate > std::chrono::milliseconds(250))
+            {
+                const GpuResidencyStats& vram = gpuResidency->stats();
+                std::string title = "Terrain Renderer | " + terrainRenderer->stats() +
+                                    " | primitives " + std::to_string(terrainPrimitives) +
+                                    " | vram " + std::to_string(vram.totalBytes() >> 20) + " / " +
+                                    std::to_string(vram.budget >> 20) + " MB, evicted " +
+                                    std::to_string(vram.evictions) +
+                                    (frame.patchCulling ? "" : " (patch culling off)");
+                std::lock_guard<std::mutex> lock(renderStatusMutex);
+                windowTitle = std::move(title);
+                lastTitleUpdate = frameStart;
+            }
+
+            uploadsLastFrame = gpuResidency->stats().uploads != uploadsBefore ||
+                               gpuUploader.inFlight() > 0;
+            ++framesRendered;
+
+            glfwSwapBuffers(window);
+
+            if (firstFrameMs < 0.0)
+            {
+                firstFrameMs = millisecondsSince(programStart);
+                std::cout << "Time to first frame: " << firstFrameMs << " ms ("
+                          << (fullQuality ? "full terrain" : terrainRenderer ? "coarse preview" : "sky only")
+                          << ")\n";
+            }
+        }
+
+        // Hand the context back for cleanup on the main thread
+        renderStopped = true;
+        framePackets.close();
+        glfwMakeContextCurrent(nullptr);
+    };
+
+    // ========================================================================
+    // SIMULATION LOOP
+    // ========================================================================
+
+    // The main thread keeps window events, input and the simulation, and
+    // prepares each frame's packet while the render thread draws the last
+    glfwMakeContextCurrent(nullptr);
+    std::thread renderThread(renderLoop);
+
+    FramePacket packet;
+    while (!glfwWindowShouldClose(window) && !renderStopped)
     {
+        glfwPollEvents();
+
         // Update time
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        // Process input
-        processInput(window);
-
-        // Toggle wireframe mode
-        glPolygonMode(GL_FRONT_AND_BACK, wireframeMode ? GL_LINE : GL_FILL);
+        // Collision from the mesh build, once the render thread has it
+        {
+            std::lock_guard<std::mutex> lock(renderStatusMutex);
+            if (collisionGridHandoff)
+            {
+                collisionGrid = std::move(collisionGridHandoff);
+                g_collisionGrid = collisionGrid.get();
+                std::cout << "Collision grid: " << collisionGrid->width() << " x "
+                          << collisionGrid->height() << ", " << collisionGrid->bytes() / 1024.0
+                          << " KB\n";
+                terrainRaycaster = std::make_unique<TerrainRaycaster>(*collisionGrid);
+                g_terrainRaycaster = terrainRaycaster.get();
+                std::cout << "Picking pyramid: " << terrainRaycaster->levelCount() << " levels, "
+                          << terrainRaycaster->bytes() / 1024.0 << " KB\n";
+            }
+            if (!windowTitle.empty())
+            {
+                glfwSetWindowTitle(window, windowTitle.c_str());
+                windowTitle.clear();
+            }
+        }
 
-        // Clear buffers
-        glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Run the simulation ticks this frame's time covers. The first
+        // frame's time is startup, so it runs none.
+        int ticks = packet.sequence > 0 ? simulationClock.advance(deltaTime) : 0;
+        for (int t = 0; t < ticks; ++t)
+        {
+            auto tickStart = std::chrono::steady_clock::now();
+            previousCameraPos = cameraPos;
+            processInput(window, tickSeconds);
+            double tickMs = millisecondsSince(tickStart);
+            tickTotalMs += tickMs;
+            tickMaxMs = std::max(tickMaxMs, tickMs);
+        }
+        simulationAlpha = simulationClock.alpha();
 
         // Setup matrices (used by both skybox and terrain)
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glm::mat4 projection = glm::perspective(glm::radians(fov), 800.0f / 600.0f, 
-                                                0.1f, 180.0f);  // Far plane for 60x60 map
-
-        // ===== RENDER SKYBOX =====
-        glDepthFunc(GL_LEQUAL); // Change depth function for skybox
-        skyboxShader.use();
-        skyboxShader.setMat4("view", &view[0][0]);
-        skyboxShader.setMat4("projection", &projection[0][0]);
-        
-        glBindVertexArray(skyboxVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // Restore default depth function
-
-        // ===== RENDER TERRAIN =====
-        terrainShader.use();
-        
-        glm::mat4 model = glm::mat4(1.0f);
-        terrainShader.setMat4("model", &model[0][0]);
-        terrainShader.setMat4("view", &view[0][0]);
-        terrainShader.setMat4("projection", &projection[0][0]);
-        terrainShader.setVec3("viewPos", &cameraPos[0]);
-
-        // Draw terrain
-        glBindVertexArray(terrainVAO);
-        glDrawElements(GL_PATCHES, static_cast<GLsizei>(terrain.indices.size()),
-                       GL_UNSIGNED_INT, (void*)0);
-
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        TerrainFrame& frame = packet.terrain;
+        frame.view = cameraView();
+        frame.projection = cameraProjection();
+        frame.cameraPos = renderCameraPos();
+        frame.frustum = extractFrustum(frame.projection * frame.view);
+        frame.viewportWidth = framebufferWidth;
+        frame.viewportHeight = framebufferHeight;
+        frame.patchCulling = patchCullingEnabled;
+        frame.screenSpaceTessellation = screenSpaceTessellation;
+        frame.targetPixelsPerEdge = TESS_TARGET_PIXELS_PER_EDGE;
+        packet.wireframe = wireframeMode;
+        ++packet.sequence;
+
+        if (!framePackets.publish(packet))
+            break;
+    }
+
+    framePackets.close();
+    renderThread.join();
+    glfwMakeContextCurrent(window);
+
+    std::cout << "Frame times:\n";
+    frameTimes.print(std::cout);
+    if (uploadFrameTimes.frames() > 0)
+    {
+        std::cout << "Frame times while uploading ("
+                  << (gpuUploader.isRunning() ? "loader thread" : "synchronous") << "):\n";
+        uploadFrameTimes.print(std::cout);
     }
+    std::cout << "Simulation: " << simulationClock.ticks() << " ticks at " << simulationTickRate
+              << " Hz, " << (simulationClock.ticks() ? tickTotalMs * 1000.0 / simulationClock.ticks() : 0.0)
+              << " us mean, " << tickMaxMs * 1000.0 << " us max per tick";
+    if (simulationClock.droppedTicks() > 0)
+        std::cout << ", " << simulationClock.droppedTicks() << " dropped after long frames";
+    std::cout << "\n";
+    std::cout << "Frame packets: " << packet.sequence << " prepared, " << framePackets.replaced()
+              << " replaced before the render thread drew them\n";
+
+    // Counters for sizing --vram-budget
+    const GpuResidencyStats& vram = gpuResidency->stats();
+    std::cout << "GPU residency: peak " << vram.peakBytes / (1024.0 * 1024.0) << " MB, "
+              << vram.uploads << " uploads, " << vram.evictions << " evictions, "
+              << vram.poolHits << " pooled buffer reuses, " << vram.buffersCreated
+              << " buffers created\n";
 
     // Cleanup
-    glDeleteVertexArrays(1, &terrainVAO);
-    glDeleteBuffers(1, &terrainVBO);
-    glDeleteBuffers(1, &terrainEBO);
+    glDeleteQueries(2, primitiveQueries);
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
+    terrainBuild.reset();   // Waits for the mesh in progress
+    gpuUploader.stop();     // Reads mesh data until joined
+    pendingRenderer.reset();
+    terrainRenderer.reset();
+    gpuResidency.reset();
+    g_heightmap = HeightmapView();
+    g_tileStreamer = nullptr;
+    g_collisionGrid = nullptr;
+    g_terrainRaycaster = nullptr;
+    heightmapFile = Heightmap();
+    terrainCache = TerrainCache();
     
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
 
 // ============================================================================
 // CALLBACK FUNCTIONS
 // ============================================================================
 
+// The render thread applies the new size with the next frame packet
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
-void processInput(GLFWwindow* window)
+void processInput(GLFWwindow* window, float tickSeconds)
 {
-    float cameraSpeed = 20.0f * deltaTime;  // Faster speed for 50x50 map
+    float cameraSpeed = 20.0f * tickSeconds;  // Faster speed for 50x50 map
 
-    // Test each movement direction separately for collision
-    glm::vec3 proposedPos = cameraPos;
-
-    // Forward/Back movement (W/S)
+    // All movement keys combine into one motion for the tick
+    glm::vec3 cameraRight = glm::normalize(glm::cross(cameraFront, cameraUp));
+    glm::vec3 motion(0.0f);
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-    {
-        proposedPos = cameraPos + cameraSpeed * cameraFront;
-        float terrainHeight = getTerrainHeightAt(proposedPos.x, proposedPos.z);
-        if (proposedPos.y >= terrainHeight + CAMERA_HEIGHT_OFFSET)
-            cameraPos = proposedPos;  // Accept movement
-        else
-            cameraPos.y = terrainHeight + CAMERA_HEIGHT_OFFSET;  // Clamp Y only
-    }
+        motion += cameraSpeed * cameraFront;
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-    {
-        proposedPos = cameraPos - cameraSpeed * cameraFront;
-        float terrainHeight = getTerrainHeightAt(proposedPos.x, proposedPos.z);
-        if (proposedPos.y >= terrainHeight + CAMERA_HEIGHT_OFFSET)
-            cameraPos = proposedPos;  // Accept movement
-        else
-            cameraPos.y = terrainHeight + CAMERA_HEIGHT_OFFSET;  // Clamp Y only
-    }
-
-    // Left/Right movement (A/D)
-    glm::vec3 cameraRight = glm::normalize(glm::cross(cameraFront, cameraUp));
+        motion -= cameraSpeed * cameraFront;
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-    {
-        proposedPos = cameraPos - cameraSpeed * cameraRight;
-        float terrainHeight = getTerrainHeightAt(proposedPos.x, proposedPos.z);
-        if (proposedPos.y >= terrainHeight + CAMERA_HEIGHT_OFFSET)
-            cameraPos = proposedPos;  // Accept movement
-        else
-            cameraPos.y = terrainHeight + CAMERA_HEIGHT_OFFSET;  // Clamp Y only
-    }
+        motion -= cameraSpeed * cameraRight;
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-    {
-        proposedPos = cameraPos + cameraSpeed * cameraRight;
-        float terrainHeight = getTerrainHeightAt(proposedPos.x, proposedPos.z);
-        if (proposedPos.y >= terrainHeight + CAMERA_HEIGHT_OFFSET)
-            cameraPos = proposedPos;  // Accept movement
-        else
-            cameraPos.y = terrainHeight + CAMERA_HEIGHT_OFFSET;  // Clamp Y only
-    }
-
-    // Vertical movement (Space/Ctrl) - no horizontal collision check needed
+        motion += cameraSpeed * cameraRight;
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-        cameraPos.y += cameraSpeed;
+        motion.y += cameraSpeed;
     if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
-    {
-        cameraPos.y -= cameraSpeed;
-        // Still can't go below terrain
-        float terrainHeight = getTerrainHeightAt(cameraPos.x, cameraPos.z);
-        if (cameraPos.y < terrainHeight + CAMERA_HEIGHT_OFFSET)
-            cameraPos.y = terrainHeight + CAMERA_HEIGHT_OFFSET;
-    }
+        motion.y -= cameraSpeed;
+
+    // Sweep the camera's sphere along the whole motion, so a low tick rate
+    // cannot carry it through a ridge, and slide along what it hits. Tile
+    // streaming has no collision grid and only checks where it ends up.
+    if (g_collisionGrid)
+        cameraPos = moveSphere(*g_collisionGrid, cameraPos, motion, CAMERA_HEIGHT_OFFSET);
+    else
+        cameraPos += motion;
 
     // Final safety check - ensure we're always above terrain
     float finalTerrainHeight = getTerrainHeightAt(cameraPos.x, cameraPos.z);
@@ -597,6 +1111,38 @@ void processInput(GLFWwindow* window)
         tKeyPressed = false;
     }
 
+    // Toggle patch culling in the tessellation control shader (C key), to
+    // compare the primitives counter in the window title
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+    {
+        if (!cKeyPressed)
+        {
+            patchCullingEnabled = !patchCullingEnabled;
+            cKeyPressed = true;
+            std::cout << "Patch culling: " << (patchCullingEnabled ? "ON" : "OFF") << "\n";
+        }
+    }
+    else
+    {
+        cKeyPressed = false;
+    }
+
+    // Switch between screen-space and distance-based tessellation (L key)
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
+    {
+        if (!lKeyPressed)
+        {
+            screenSpaceTessellation = !screenSpaceTessellation;
+            lKeyPressed = true;
+            std::cout << "Tessellation: "
+                      << (screenSpaceTessellation ? "screen-space" : "distance") << "\n";
+        }
+    }
+    else
+    {
+        lKeyPressed = false;
+    }
+
     // Exit (Escape key)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -661,4 +1207,8 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
             firstMouse = true; // Reset for next time
         }
     }
+
+    // Right click picks the terrain point under the cursor
+    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
+        pickTerrain(window);
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        data_ = other.data_;
+        size_ = other.size_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+#ifdef _WIN32
+        fileHandle_ = other.fileHandle_;
+        mappingHandle_ = other.mappingHandle_;
+        other.fileHandle_ = nullptr;
+        other.mappingHandle_ = nullptr;
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+    close();
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    data_ = view;
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    fileHandle_ = file;
+    mappingHandle_ = mapping;
+    return true;
+}
+
+void MappedFile::discard(size_t, size_t)
+{
+    // Unused file-backed pages are trimmed from the working set on demand
+}
+
+void MappedFile::close()
+{
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mappingHandle_)
+        CloseHandle(mappingHandle_);
+    if (fileHandle_)
+        CloseHandle(fileHandle_);
+    data_ = nullptr;
+    size_ = 0;
+    fileHandle_ = nullptr;
+    mappingHandle_ = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_t length = static_cast<size_t>(info.st_size);
+    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);   // The mapping keeps its own reference to the file
+    if (view == MAP_FAILED)
+        return false;
+
+    // Heightmaps are read front to back during mesh generation
+    madvise(view, length, MADV_SEQUENTIAL);
+
+    data_ = view;
+    size_ = length;
+    return true;
+}
+
+void MappedFile::discard(size_t offset, size_t length)
+{
+    // madvise works on whole pages; only drop pages fully inside the range
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = std::min(offset + length, size_) / page * page;
+    if (data_ && begin < end)
+        madvise(static_cast<char*>(data_) + begin, end - begin, MADV_DONTNEED);
+}
+
+void MappedFile::close()
+{
+    if (data_)
+        munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+
+// ============================================================================
+// MEMORY-MAPPED FILE
+// ============================================================================
+
+// Read-only mapping of a whole file (mmap on POSIX, a file mapping on
+// Windows). The mapping is page-aligned, so any sample type can be read from
+// it in place.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Returns false (and stays closed) if the file cannot be mapped
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const void* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Hints that a range will not be read again, so its pages can leave the
+    // working set (they are read back from the file if touched)
+    void discard(size_t offset, size_t length);
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+#endif
+};
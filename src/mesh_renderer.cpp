@@ -0,0 +1,278 @@
+#include "mesh_renderer.h"
+
+#include <cstddef>
+#include <glad/gl.h>
+
+MeshTerrainRenderer::MeshTerrainRenderer(const TerrainMesh& mesh, GpuResidency& residency,
+                                         GpuUploader* uploader)
+    : MeshTerrainRenderer(mesh.buffers(), residency, uploader)
+{
+}
+
+MeshTerrainRenderer::MeshTerrainRenderer(const TerrainMeshBuffers& mesh, GpuResidency& residency,
+                                         GpuUploader* uploader)
+    : mesh_(mesh),
+      chunks_(mesh.chunks, mesh.chunks + mesh.chunkCount),
+      compactVertices_(mesh.format == TerrainVertexFormat::Compact),
+      vertexSize_(compactVertices_ ? sizeof(CompactTerrainVertex) : sizeof(TerrainVertex)),
+      residency_(residency),
+      uploader_(uploader),
+      firstTile_(residency.reserveTiles(static_cast<uint32_t>(mesh.chunkCount))),
+      shader_(compactVertices_ ? "shaders/vertex_compact.glsl" : "shaders/vertex.glsl",
+              "shaders/fragment.glsl",
+              "shaders/tess_control.glsl", "shaders/tess_eval.glsl")
+{
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &ebo_);
+
+    glBindVertexArray(vao_);
+
+    // Upload index data, shared by every chunk
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 mesh.indexCount * sizeof(uint16_t),
+                 mesh.indices,
+                 GL_STATIC_DRAW);
+    residency_.trackBuffer(mesh.indexCount * sizeof(uint16_t));
+
+    // Attribute pointers are set per chunk in bindVertexBuffer
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    if (!compactVertices_)
+        glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+
+    // Grid layout for the compact vertex shader (ignored by vertex.glsl)
+    shader_.use();
+    shader_.setInt("gridWidth", mesh.gridWidth);
+    shader_.setInt("gridHeight", mesh.gridHeight);
+    shader_.setFloat("heightScale", HEIGHT_SCALE);
+
+    // Chunk bounds for frustum culling, padded by the displacement added in
+    // the tessellation evaluation shader
+    for (const TerrainChunk& chunk : chunks_)
+    {
+        glm::vec3 pad(0.0f, TERRAIN_DISPLACEMENT_BOUND, 0.0f);
+        chunkBounds_.push(chunk.boundsMin - pad, chunk.boundsMax + pad);
+    }
+    visibleChunks_.reserve(chunks_.size());
+    visibleBuffers_.reserve(chunks_.size());
+
+    // Synchronous uploads happen here, before the first frame; otherwise
+    // the first frames pick what the camera sees first
+    if (!asyncUploads())
+        prefetchChunks();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+MeshTerrainRenderer::~MeshTerrainRenderer()
+{
+    for (uint32_t c = 0; c < chunks_.size(); ++c)
+        residency_.release(chunkTile(c));
+    residency_.untrackBuffer(mesh_.indexCount * sizeof(uint16_t));
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &ebo_);
+}
+
+// Only the rows the chunk uses are stored (see generateTerrainMesh)
+size_t MeshTerrainRenderer::chunkVertexBytes(const TerrainChunk& chunk) const
+{
+    return static_cast<size_t>(chunk.quadsZ + 1) * TERRAIN_CHUNK_SIZE * vertexSize_;
+}
+
+bool MeshTerrainRenderer::asyncUploads() const
+{
+    return uploader_ && uploader_->isRunning();
+}
+
+// Starts uploading a chunk that is not resident. Returns its buffer if the
+// upload was synchronous.
+unsigned int MeshTerrainRenderer::loadChunk(uint32_t chunkIndex)
+{
+    if (!mesh_.vertexData)
+        return 0;
+
+    const TerrainChunk& chunk = chunks_[chunkIndex];
+    const unsigned char* vertices = static_cast<const unsigned char*>(mesh_.vertexData) +
+                                    static_cast<size_t>(chunk.baseVertex) * vertexSize_;
+    const size_t bytes = chunkVertexBytes(chunk);
+    if (!asyncUploads())
+    {
+        ++uploadsLastFrame_;
+        return residency_.upload(chunkTile(chunkIndex), vertices, bytes);
+    }
+
+    if (uploader_->inFlight() >= static_cast<size_t>(GPU_UPLOAD_MAX_IN_FLIGHT))
+        return 0;
+    unsigned int buffer = residency_.allocate(chunkTile(chunkIndex), bytes);
+    uploader_->submit(chunkTile(chunkIndex), buffer, vertices, bytes);
+    ++uploadsLastFrame_;
+    return 0;
+}
+
+// Chunks out of view are uploaded in order while they fit the budget
+void MeshTerrainRenderer::prefetchChunks()
+{
+    if (!mesh_.vertexData)
+        return;
+
+    for (; nextPrefetch_ < chunks_.size(); ++nextPrefetch_)
+    {
+        if (residency_.contains(chunkTile(nextPrefetch_)))
+            continue;
+        if (!residency_.fits(chunkVertexBytes(chunks_[nextPrefetch_])) ||
+            (asyncUploads() && uploader_->inFlight() >= static_cast<size_t>(GPU_UPLOAD_MAX_IN_FLIGHT)))
+            break;
+        loadChunk(nextPrefetch_);
+    }
+}
+
+// Chunks start at vertex 0 of their own buffer
+void MeshTerrainRenderer::bindVertexBuffer(unsigned int buffer)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (compactVertices_)
+    {
+        // Height attribute (location = 0), R16 unorm
+        glVertexAttribPointer(0, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactTerrainVertex),
+                              (void*)offsetof(CompactTerrainVertex, height));
+
+        // Octahedral normal (location = 1). Left unnormalized and scaled in
+        // the shader, since GL 4.1 and 4.2+ disagree on snorm conversion.
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_FALSE, sizeof(CompactTerrainVertex),
+                              (void*)offsetof(CompactTerrainVertex, octNormal));
+    }
+    else
+    {
+        // Position attribute (location = 0)
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)0);
+
+        // Normal attribute (location = 1)
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex),
+                            (void*)offsetof(TerrainVertex, normal));
+
+        // UV attribute (location = 2)
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex),
+                            (void*)offsetof(TerrainVertex, texCoord));
+    }
+}
+
+bool MeshTerrainRenderer::allChunksResident() const
+{
+    for (uint32_t c = 0; c < chunks_.size(); ++c)
+    {
+        if (!residency_.contains(chunkTile(c)) || residency_.isPending(chunkTile(c)))
+            return false;
+    }
+    return true;
+}
+
+void MeshTerrainRenderer::releaseVertexSource()
+{
+    // The index buffer was uploaded during construction; only its size is
+    // still needed
+    mesh_.vertexData = nullptr;
+    mesh_.indices = nullptr;
+}
+
+bool MeshTerrainRenderer::isValid() const
+{
+    return shader_.isValid();
+}
+
+void MeshTerrainRenderer::render(const TerrainFrame& frame)
+{
+    shader_.use();
+
+    glm::mat4 model = glm::mat4(1.0f);
+    shader_.setMat4("model", &model[0][0]);
+    shader_.setMat4("view", &frame.view[0][0]);
+    shader_.setMat4("projection", &frame.projection[0][0]);
+    shader_.setVec3("viewPos", &frame.cameraPos[0]);
+
+    // Model is identity, so the frame's frustum planes also serve the
+    // per-patch culling in the TCS
+    shader_.setVec4Array("frustumPlanes", 6, &frame.frustum.planes[0][0]);
+    shader_.setFloat("displacementBound", TERRAIN_DISPLACEMENT_BOUND);
+    shader_.setInt("patchCulling", frame.patchCulling ? 1 : 0);
+
+    // Screen-space tessellation needs the real viewport size
+    shader_.setInt("tessMode", frame.screenSpaceTessellation ? 1 : 0);
+    shader_.setVec2("viewportSize", static_cast<float>(frame.viewportWidth),
+                    static_cast<float>(frame.viewportHeight));
+    shader_.setFloat("targetPixelsPerEdge", frame.targetPixelsPerEdge);
+
+    prepare(frame);
+
+    // Draw visible chunks that are ready, one call each over the shared
+    // index buffer
+    if (compactVertices_)
+        shader_.setInt("chunkBaseVertex", 0);
+    glPatchParameteri(GL_PATCH_VERTICES, 3);
+    glBindVertexArray(vao_);
+    for (size_t i = 0; i < visibleChunks_.size(); ++i)
+    {
+        unsigned int buffer = visibleBuffers_[i];
+        if (!buffer)
+            continue;
+
+        const TerrainChunk& chunk = chunks_[visibleChunks_[i]];
+        bindVertexBuffer(buffer);
+        if (compactVertices_)
+        {
+            shader_.setInt("chunkOriginX", chunk.originX);
+            shader_.setInt("chunkOriginZ", chunk.originZ);
+        }
+        glDrawElements(GL_PATCHES, static_cast<GLsizei>(chunk.indexCount),
+                       GL_UNSIGNED_SHORT, (void*)0);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool MeshTerrainRenderer::prepare(const TerrainFrame& frame)
+{
+    // Cull chunks against the view frustum
+    visibleChunks_.clear();
+    cullAabbs(frame.frustum, chunkBounds_, visibleChunks_);
+
+    // Mark every visible chunk first, so loading one below can only evict
+    // chunks out of view, never one still to be looked at this frame
+    visibleBuffers_.clear();
+    for (uint32_t chunkIndex : visibleChunks_)
+    {
+        unsigned int buffer = residency_.touch(chunkTile(chunkIndex));
+        visibleBuffers_.push_back(residency_.isPending(chunkTile(chunkIndex)) ? 0 : buffer);
+    }
+
+    // Upload visible chunks that were evicted or never fitted, then
+    // prefetch with what is left of the in-flight limit
+    uploadsLastFrame_ = 0;
+    chunksWaiting_ = 0;
+    for (size_t i = 0; i < visibleChunks_.size(); ++i)
+    {
+        if (visibleBuffers_[i])
+            continue;
+        if (!residency_.contains(chunkTile(visibleChunks_[i])))
+            visibleBuffers_[i] = loadChunk(visibleChunks_[i]);
+        if (!visibleBuffers_[i])
+            ++chunksWaiting_;
+    }
+    if (asyncUploads())
+        prefetchChunks();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return chunksWaiting_ == 0;
+}
+
+std::string MeshTerrainRenderer::stats() const
+{
+    std::string text = "chunks visible " + std::to_string(visibleChunks_.size()) + " / " +
+                       std::to_string(chunkBounds_.count) + ", resident " +
+                       std::to_string(residency_.stats().residentTiles);
+    if (uploadsLastFrame_ > 0)
+        text += " (+" + std::to_string(uploadsLastFrame_) + ")";
+    if (chunksWaiting_ > 0)
+        text += ", waiting " + std::to_string(chunksWaiting_);
+    return text;
+}
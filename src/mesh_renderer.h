@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "frustum_culling.h"
+#include "gpu_residency.h"
+#include "gpu_uploader.h"
+#include "shader.h"
+#include "terrain_mesh.h"
+#include "terrain_renderer.h"
+
+// Draws a chunked TerrainMesh through the tessellation pipeline, culling
+// chunks against the frustum on the CPU first. Each chunk's vertices live in
+// their own buffer, made resident through the GpuResidency manager: chunks
+// are uploaded ahead of time while they fit the budget, and otherwise when
+// they come into view, evicting the ones out of view the longest.
+//
+// With a running GpuUploader, uploads happen on its loader thread and a
+// chunk is drawn from the frame its upload has finished (the residency
+// manager collects them, see GpuResidency::collectUploads); visible chunks
+// are sent first, the rest are prefetched a few per frame. Without one,
+// chunks are uploaded synchronously, all that fit during construction.
+class MeshTerrainRenderer : public TerrainRenderer
+{
+public:
+    MeshTerrainRenderer(const TerrainMesh& mesh, GpuResidency& residency,
+                        GpuUploader* uploader = nullptr);
+
+    // Evicted chunks are uploaded again from the buffers, so they must
+    // outlive the renderer, or at least last until releaseVertexSource
+    MeshTerrainRenderer(const TerrainMeshBuffers& buffers, GpuResidency& residency,
+                        GpuUploader* uploader = nullptr);
+    ~MeshTerrainRenderer() override;
+
+    bool isValid() const override;
+    void render(const TerrainFrame& frame) override;
+    std::string stats() const override;
+
+    // Culls and starts uploads for the frame without drawing. True once
+    // every visible chunk can be drawn, so a replacement renderer can be
+    // warmed up behind the one on screen.
+    bool prepare(const TerrainFrame& frame);
+    size_t chunksWaiting() const { return chunksWaiting_; }
+
+    // True once every chunk has finished uploading. Nothing is evicted
+    // after that, since chunks are only evicted to make room for others.
+    bool allChunksResident() const;
+
+    // Stops reading the buffers passed to the constructor, so the CPU copy
+    // can be freed. Only valid once allChunksResident() and no uploads are
+    // left in flight.
+    void releaseVertexSource();
+
+private:
+    size_t chunkVertexBytes(const TerrainChunk& chunk) const;
+    bool asyncUploads() const;
+    uint32_t chunkTile(uint32_t chunkIndex) const { return firstTile_ + chunkIndex; }
+    unsigned int loadChunk(uint32_t chunkIndex);
+    void prefetchChunks();
+    void bindVertexBuffer(unsigned int buffer);
+
+    TerrainMeshBuffers mesh_;
+    std::vector<TerrainChunk> chunks_;
+    bool compactVertices_;
+    size_t vertexSize_;
+    GpuResidency& residency_;
+    GpuUploader* uploader_;
+    uint32_t firstTile_;                        // Residency tile of chunk 0
+    Shader shader_;
+    unsigned int vao_ = 0;
+    unsigned int ebo_ = 0;
+
+    AabbSoA chunkBounds_;
+    std::vector<uint32_t> visibleChunks_;
+    std::vector<unsigned int> visibleBuffers_;  // Per visible chunk, 0 until drawable
+    uint32_t nextPrefetch_ = 0;
+    size_t uploadsLastFrame_ = 0;
+    size_t chunksWaiting_ = 0;                  // Visible last frame, not drawn yet
+};
@@ -0,0 +1,664 @@
+#include "png_rows.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// ============================================================================
+// INFLATE
+// ============================================================================
+
+// Codes up to this many bits decode with a single table lookup
+const int HUFFMAN_FAST_BITS = 9;
+const int HUFFMAN_FAST_MASK = (1 << HUFFMAN_FAST_BITS) - 1;
+
+// Output ring: a back-reference reaches at most 32 KB, and output is handed
+// on in blocks of 32 KB, so 128 KB always holds both
+const size_t INFLATE_WINDOW_SIZE = 1 << 17;
+const size_t INFLATE_WINDOW_MASK = INFLATE_WINDOW_SIZE - 1;
+const size_t INFLATE_FLUSH_SIZE = 1 << 15;
+const size_t INFLATE_MAX_DISTANCE = 1 << 15;
+
+const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const uint8_t CODE_LENGTH_ORDER[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Canonical Huffman code. Short codes are looked up directly; longer ones
+// are walked one bit at a time through the per-length counts.
+struct Huffman
+{
+    uint16_t fast[1 << HUFFMAN_FAST_BITS];  // (length << 9) | symbol, 0 = not a short code
+    uint16_t count[16];                     // Codes of each length
+    uint16_t symbols[288];                  // Symbols in canonical order
+};
+
+bool buildHuffman(Huffman& huffman, const uint8_t* lengths, int symbolCount)
+{
+    std::memset(huffman.fast, 0, sizeof(huffman.fast));
+    std::memset(huffman.count, 0, sizeof(huffman.count));
+    for (int s = 0; s < symbolCount; ++s)
+        ++huffman.count[lengths[s]];
+    huffman.count[0] = 0;
+
+    // Incomplete codes are allowed (a single distance code is common),
+    // over-subscribed ones are not
+    int left = 1;
+    for (int length = 1; length < 16; ++length)
+    {
+        left = (left << 1) - huffman.count[length];
+        if (left < 0)
+            return false;
+    }
+
+    uint16_t offset[16];
+    uint16_t nextCode[16];
+    offset[1] = 0;
+    nextCode[1] = 0;
+    for (int length = 1; length < 15; ++length)
+    {
+        offset[length + 1] = static_cast<uint16_t>(offset[length] + huffman.count[length]);
+        nextCode[length + 1] = static_cast<uint16_t>((nextCode[length] + huffman.count[length]) << 1);
+    }
+
+    for (int s = 0; s < symbolCount; ++s)
+    {
+        int length = lengths[s];
+        if (length == 0)
+            continue;
+        huffman.symbols[offset[length]++] = static_cast<uint16_t>(s);
+
+        int code = nextCode[length]++;
+        if (length > HUFFMAN_FAST_BITS)
+            continue;
+
+        // The stream is read LSB first, so the table is indexed by the
+        // bit-reversed code
+        int reversed = 0;
+        for (int b = 0; b < length; ++b)
+            reversed |= ((code >> b) & 1) << (length - 1 - b);
+        for (int k = reversed; k <= HUFFMAN_FAST_MASK; k += 1 << length)
+            huffman.fast[k] = static_cast<uint16_t>((length << 9) | s);
+    }
+    return true;
+}
+
+// Reads the zlib stream across the IDAT chunks it is split over
+class BitReader
+{
+public:
+    BitReader(const uint8_t* const* data, const size_t* sizes, size_t segmentCount)
+        : data_(data), sizes_(sizes), segmentCount_(segmentCount) {}
+
+    uint32_t bits(int count)
+    {
+        if (count_ < count)
+            refill();
+        uint32_t value = static_cast<uint32_t>(buffer_ & ((uint64_t(1) << count) - 1));
+        buffer_ >>= count;
+        count_ -= count;
+        return value;
+    }
+
+    void alignToByte()
+    {
+        int drop = count_ & 7;
+        buffer_ >>= drop;
+        count_ -= drop;
+    }
+
+    int decode(const Huffman& huffman)
+    {
+        if (count_ < 16)
+            refill();
+        uint16_t entry = huffman.fast[buffer_ & HUFFMAN_FAST_MASK];
+        if (entry)
+        {
+            int length = entry >> 9;
+            buffer_ >>= length;
+            count_ -= length;
+            return entry & 511;
+        }
+
+        int code = 0, first = 0, index = 0;
+        for (int length = 1; length < 16; ++length)
+        {
+            code |= static_cast<int>(bits(1));
+            int count = huffman.count[length];
+            if (code - count < first)
+                return huffman.symbols[index + (code - first)];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    // True once more than the bit buffer's worth of padding has been
+    // consumed past the end of the data
+    bool overrun() const { return padding_ > 8; }
+
+private:
+    void refill()
+    {
+        while (count_ <= 56)
+        {
+            buffer_ |= static_cast<uint64_t>(nextByte()) << count_;
+            count_ += 8;
+        }
+    }
+
+    uint8_t nextByte()
+    {
+        while (segment_ < segmentCount_ && position_ == sizes_[segment_])
+        {
+            ++segment_;
+            position_ = 0;
+        }
+        if (segment_ == segmentCount_)
+        {
+            ++padding_;
+            return 0;
+        }
+        return data_[segment_][position_++];
+    }
+
+    const uint8_t* const* data_;
+    const size_t* sizes_;
+    size_t segmentCount_;
+    size_t segment_ = 0;
+    size_t position_ = 0;
+    uint64_t buffer_ = 0;
+    int count_ = 0;
+    size_t padding_ = 0;
+};
+
+// Inflates a zlib stream, handing the output on in blocks. Stops early
+// (successfully) if the sink returns false.
+class Inflater
+{
+public:
+    using Sink = std::function<bool(const uint8_t*, size_t)>;
+
+    Inflater(BitReader& reader, const Sink& sink)
+        : reader_(reader), sink_(sink), window_(INFLATE_WINDOW_SIZE) {}
+
+    bool run(std::string& error)
+    {
+        uint32_t cmf = reader_.bits(8);
+        uint32_t flags = reader_.bits(8);
+        if ((cmf & 15) != 8 || ((cmf << 8) | flags) % 31 != 0 || (flags & 32))
+        {
+            error = "bad zlib header";
+            return false;
+        }
+
+        bool last = false;
+        while (!last && !stopped_)
+        {
+            last = reader_.bits(1) != 0;
+            uint32_t type = reader_.bits(2);
+            bool ok;
+            if (type == 0)
+                ok = storedBlock(error);
+            else if (type == 1)
+                ok = fixedBlock(error);
+            else if (type == 2)
+                ok = dynamicBlock(error);
+            else
+            {
+                error = "bad deflate block type";
+                ok = false;
+            }
+            if (!ok)
+                return false;
+            if (reader_.overrun())
+            {
+                error = "truncated image data";
+                return false;
+            }
+        }
+        flush();
+        return true;
+    }
+
+private:
+    void put(uint8_t value)
+    {
+        window_[written_ & INFLATE_WINDOW_MASK] = value;
+        if (++written_ - flushed_ >= INFLATE_FLUSH_SIZE)
+            flush();
+    }
+
+    void flush()
+    {
+        while (flushed_ < written_ && !stopped_)
+        {
+            size_t start = flushed_ & INFLATE_WINDOW_MASK;
+            size_t length = std::min(written_ - flushed_, INFLATE_WINDOW_SIZE - start);
+            stopped_ = !sink_(&window_[start], length);
+            flushed_ += length;
+        }
+    }
+
+    bool storedBlock(std::string& error)
+    {
+        reader_.alignToByte();
+        uint32_t length = reader_.bits(16);
+        uint32_t inverted = reader_.bits(16);
+        if ((length ^ 0xFFFF) != inverted)
+        {
+            error = "corrupt stored block";
+            return false;
+        }
+        for (uint32_t b = 0; b < length && !stopped_; ++b)
+            put(static_cast<uint8_t>(reader_.bits(8)));
+        return true;
+    }
+
+    bool fixedBlock(std::string& error)
+    {
+        if (!fixedBuilt_)
+        {
+            uint8_t lengths[288 + 30];
+            std::memset(lengths, 8, 144);
+            std::memset(lengths + 144, 9, 112);
+            std::memset(lengths + 256, 7, 24);
+            std::memset(lengths + 280, 8, 8);
+            std::memset(lengths + 288, 5, 30);
+            buildHuffman(fixedLiterals_, lengths, 288);
+            buildHuffman(fixedDistances_, lengths + 288, 30);
+            fixedBuilt_ = true;
+        }
+        return codes(fixedLiterals_, fixedDistances_, error);
+    }
+
+    bool dynamicBlock(std::string& error)
+    {
+        int literalCount = static_cast<int>(reader_.bits(5)) + 257;
+        int distanceCount = static_cast<int>(reader_.bits(5)) + 1;
+        int codeLengthCount = static_cast<int>(reader_.bits(4)) + 4;
+
+        uint8_t codeLengthLengths[19] = {};
+        for (int c = 0; c < codeLengthCount; ++c)
+            codeLengthLengths[CODE_LENGTH_ORDER[c]] = static_cast<uint8_t>(reader_.bits(3));
+        Huffman codeLengths;
+        if (!buildHuffman(codeLengths, codeLengthLengths, 19))
+        {
+            error = "corrupt code lengths";
+            return false;
+        }
+
+        // Literal and distance lengths form one sequence; repeats may run
+        // from one into the other
+        uint8_t lengths[288 + 32] = {};
+        int total = literalCount + distanceCount;
+        for (int n = 0; n < total; )
+        {
+            int symbol = reader_.decode(codeLengths);
+            int repeat = 0;
+            uint8_t value = 0;
+            if (symbol < 0)
+            {
+                error = "corrupt code lengths";
+                return false;
+            }
+            if (symbol < 16)
+            {
+                lengths[n++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+            if (symbol == 16)
+            {
+                if (n == 0)
+                {
+                    error = "corrupt code lengths";
+                    return false;
+                }
+                value = lengths[n - 1];
+                repeat = 3 + static_cast<int>(reader_.bits(2));
+            }
+            else if (symbol == 17)
+                repeat = 3 + static_cast<int>(reader_.bits(3));
+            else
+                repeat = 11 + static_cast<int>(reader_.bits(7));
+
+            if (n + repeat > total)
+            {
+                error = "corrupt code lengths";
+                return false;
+            }
+            std::memset(lengths + n, value, repeat);
+            n += repeat;
+        }
+
+        if (!buildHuffman(literals_, lengths, literalCount) ||
+            !buildHuffman(distances_, lengths + literalCount, distanceCount))
+        {
+            error = "corrupt Huffman code";
+            return false;
+        }
+        return codes(literals_, distances_, error);
+    }
+
+    bool codes(const Huffman& literals, const Huffman& distances, std::string& error)
+    {
+        while (!stopped_)
+        {
+            int symbol = reader_.decode(literals);
+            if (symbol < 256)
+            {
+                if (symbol < 0)
+                {
+                    error = "corrupt literal";
+                    return false;
+                }
+                put(static_cast<uint8_t>(symbol));
+                continue;
+            }
+            if (symbol == 256)
+                return true;
+
+            symbol -= 257;
+            if (symbol >= 29)
+            {
+                error = "corrupt length";
+                return false;
+            }
+            size_t length = LENGTH_BASE[symbol] + reader_.bits(LENGTH_EXTRA[symbol]);
+
+            int distanceSymbol = reader_.decode(distances);
+            if (distanceSymbol < 0 || distanceSymbol >= 30)
+            {
+                error = "corrupt distance";
+                return false;
+            }
+            size_t distance = DISTANCE_BASE[distanceSymbol] + reader_.bits(DISTANCE_EXTRA[distanceSymbol]);
+            if (distance > written_ || distance > INFLATE_MAX_DISTANCE)
+            {
+                error = "distance too far back";
+                return false;
+            }
+
+            for (size_t b = 0; b < length; ++b)
+                put(window_[(written_ - distance) & INFLATE_WINDOW_MASK]);
+        }
+        return true;
+    }
+
+    BitReader& reader_;
+    const Sink& sink_;
+    std::vector<uint8_t> window_;
+    size_t written_ = 0;
+    size_t flushed_ = 0;
+    bool stopped_ = false;
+
+    Huffman literals_;
+    Huffman distances_;
+    Huffman fixedLiterals_;
+    Huffman fixedDistances_;
+    bool fixedBuilt_ = false;
+};
+
+// ============================================================================
+// PNG
+// ============================================================================
+
+uint32_t readBigEndian32(const uint8_t* bytes)
+{
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+           (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+// stb_image's luminance for one requested channel
+inline uint8_t luminance8(int r, int g, int b)
+{
+    return static_cast<uint8_t>((r * 77 + g * 150 + b * 29) >> 8);
+}
+
+inline uint16_t luminance16(int r, int g, int b)
+{
+    return static_cast<uint16_t>((r * 77 + g * 150 + b * 29) >> 8);
+}
+
+inline uint8_t paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return static_cast<uint8_t>(a);
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+} // namespace
+
+bool PngRowReader::open(const char* path)
+{
+    static const uint8_t signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+
+    if (!file_.open(path))
+    {
+        error_ = "cannot map file";
+        return false;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(file_.data());
+    const size_t size = file_.size();
+    if (size < 8 || std::memcmp(bytes, signature, 8) != 0)
+    {
+        error_ = "not a PNG";
+        return false;
+    }
+
+    bool sawHeader = false;
+    for (size_t offset = 8; offset + 12 <= size; )
+    {
+        uint32_t length = readBigEndian32(bytes + offset);
+        const uint8_t* type = bytes + offset + 4;
+        const uint8_t* data = bytes + offset + 8;
+        if (length > size - offset - 12)
+        {
+            error_ = "truncated chunk";
+            return false;
+        }
+
+        if (std::memcmp(type, "IHDR", 4) == 0 && length >= 13)
+        {
+            width_ = static_cast<int>(readBigEndian32(data));
+            height_ = static_cast<int>(readBigEndian32(data + 4));
+            bitDepth_ = data[8];
+            colorType_ = data[9];
+            if (data[10] != 0 || data[11] != 0)
+            {
+                error_ = "unknown compression or filter method";
+                return false;
+            }
+            if (data[12] != 0)
+            {
+                error_ = "interlaced PNGs cannot be streamed";
+                return false;
+            }
+            sawHeader = true;
+        }
+        else if (std::memcmp(type, "PLTE", 4) == 0)
+        {
+            for (uint32_t e = 0; e < length / 3 && e < 256; ++e)
+                std::memcpy(palette_[e], data + e * 3, 3);
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0)
+        {
+            idat_.push_back({ data, length });
+        }
+        else if (std::memcmp(type, "IEND", 4) == 0)
+        {
+            break;
+        }
+        offset += 12 + static_cast<size_t>(length);
+    }
+
+    if (!sawHeader || idat_.empty() || width_ <= 0 || height_ <= 0)
+    {
+        error_ = "missing header or image data";
+        return false;
+    }
+
+    switch (colorType_)
+    {
+    case 0: channels_ = 1; break;   // Grey
+    case 2: channels_ = 3; break;   // RGB
+    case 3: channels_ = 1; break;   // Palette
+    case 4: channels_ = 2; break;   // Grey + alpha
+    case 6: channels_ = 4; break;   // RGBA
+    default:
+        error_ = "unknown colour type";
+        return false;
+    }
+    if (!(bitDepth_ == 8 || (bitDepth_ == 16 && colorType_ != 3)))
+    {
+        error_ = "only 8- and 16-bit PNGs can be streamed";
+        return false;
+    }
+
+    stride_ = static_cast<size_t>(width_) * channels_ * (bitDepth_ / 8);
+    scanline_.assign(stride_ + 1, 0);
+    previous_.assign(stride_, 0);
+    grey_.assign(static_cast<size_t>(width_) * (bitDepth_ / 8), 0);
+    return true;
+}
+
+size_t PngRowReader::bufferBytes() const
+{
+    return INFLATE_WINDOW_SIZE + scanline_.size() + previous_.size() + grey_.size() +
+           4 * sizeof(Huffman);
+}
+
+bool PngRowReader::readRows(const std::function<bool(int, const void*)>& onRow)
+{
+    std::vector<const uint8_t*> data;
+    std::vector<size_t> sizes;
+    for (const Segment& segment : idat_)
+    {
+        data.push_back(segment.data);
+        sizes.push_back(segment.size);
+    }
+    BitReader reader(data.data(), sizes.data(), data.size());
+
+    // Reassembles scanlines from the inflated blocks
+    bool stopped = false;
+    Inflater::Sink sink = [&](const uint8_t* bytes, size_t length) {
+        while (length > 0 && row_ < height_)
+        {
+            size_t take = std::min(length, scanline_.size() - scanlineFill_);
+            std::memcpy(&scanline_[scanlineFill_], bytes, take);
+            scanlineFill_ += take;
+            bytes += take;
+            length -= take;
+            if (scanlineFill_ == scanline_.size())
+            {
+                scanlineFill_ = 0;
+                if (!processScanline(onRow))
+                {
+                    stopped = true;
+                    return false;
+                }
+            }
+        }
+        return row_ < height_;
+    };
+
+    row_ = 0;
+    scanlineFill_ = 0;
+    std::fill(previous_.begin(), previous_.end(), 0);
+    Inflater inflater(reader, sink);
+    if (!inflater.run(error_) || !error_.empty())
+        return false;
+    if (row_ < height_ && !stopped)
+    {
+        error_ = "truncated image data";
+        return false;
+    }
+    return true;
+}
+
+// Unfilters the completed scanline, converts it to grey and hands it on.
+// Returns false to stop decoding (caller request or a bad filter).
+bool PngRowReader::processScanline(const std::function<bool(int, const void*)>& onRow)
+{
+    const int filter = scanline_[0];
+    uint8_t* line = &scanline_[1];
+    const uint8_t* up = previous_.data();
+    const size_t bpp = static_cast<size_t>(channels_) * (bitDepth_ / 8);
+
+    switch (filter)
+    {
+    case 0:
+        break;
+    case 1:
+        for (size_t i = bpp; i < stride_; ++i)
+            line[i] = static_cast<uint8_t>(line[i] + line[i - bpp]);
+        break;
+    case 2:
+        for (size_t i = 0; i < stride_; ++i)
+            line[i] = static_cast<uint8_t>(line[i] + up[i]);
+        break;
+    case 3:
+        for (size_t i = 0; i < bpp; ++i)
+            line[i] = static_cast<uint8_t>(line[i] + (up[i] >> 1));
+        for (size_t i = bpp; i < stride_; ++i)
+            line[i] = static_cast<uint8_t>(line[i] + ((line[i - bpp] + up[i]) >> 1));
+        break;
+    case 4:
+        for (size_t i = 0; i < bpp; ++i)
+            line[i] = static_cast<uint8_t>(line[i] + paeth(0, up[i], 0));
+        for (size_t i = bpp; i < stride_; ++i)
+            line[i] = static_cast<uint8_t>(line[i] + paeth(line[i - bpp], up[i], up[i - bpp]));
+        break;
+    default:
+        error_ = "bad scanline filter";
+        return false;
+    }
+    std::memcpy(previous_.data(), line, stride_);
+
+    if (bitDepth_ == 8)
+    {
+        uint8_t* out = grey_.data();
+        for (int x = 0; x < width_; ++x)
+        {
+            const uint8_t* pixel = line + static_cast<size_t>(x) * channels_;
+            if (colorType_ == 3)
+                out[x] = luminance8(palette_[pixel[0]][0], palette_[pixel[0]][1], palette_[pixel[0]][2]);
+            else if (channels_ >= 3)
+                out[x] = luminance8(pixel[0], pixel[1], pixel[2]);
+            else
+                out[x] = pixel[0];
+        }
+    }
+    else
+    {
+        uint16_t* out = reinterpret_cast<uint16_t*>(grey_.data());
+        for (int x = 0; x < width_; ++x)
+        {
+            const uint8_t* pixel = line + static_cast<size_t>(x) * channels_ * 2;
+            int first = (pixel[0] << 8) | pixel[1];
+            if (channels_ >= 3)
+                out[x] = luminance16(first, (pixel[2] << 8) | pixel[3], (pixel[4] << 8) | pixel[5]);
+            else
+                out[x] = static_cast<uint16_t>(first);
+        }
+    }
+
+    return onRow(row_++, grey_.data());
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// ============================================================================
+// STREAMING PNG DECODER
+// ============================================================================
+
+// Decodes a PNG one row at a time, so a heightmap can be consumed without
+// ever holding the whole image. The compressed file is memory-mapped; the
+// working set is the 32 KB inflate window plus two scanlines.
+//
+// Rows come out as one grey sample per pixel, computed exactly like
+// stb_image with one requested channel (luminance for colour images), so the
+// result matches stbi_load / stbi_load_16. Interlaced images and bit depths
+// below 8 are not supported; open() fails and the caller falls back to
+// stb_image.
+class PngRowReader {
+public:
+    bool open(const char* path);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool is16Bit() const { return bitDepth_ == 16; }   // Rows are uint16_t, else uint8_t
+
+    // Calls onRow(z, row) for z = 0 .. height - 1 in order. onRow returns
+    // false to stop early. Returns false if the image data is corrupt or
+    // truncated.
+    bool readRows(const std::function<bool(int, const void*)>& onRow);
+
+    // Memory used while decoding, not counting the file mapping
+    size_t bufferBytes() const;
+
+    const std::string& error() const { return error_; }
+
+private:
+    struct Segment
+    {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    bool processScanline(const std::function<bool(int, const void*)>& onRow);
+
+    MappedFile file_;
+    std::vector<Segment> idat_;         // Compressed stream, split over IDAT chunks
+    uint8_t palette_[256][3] = {};
+
+    int width_ = 0;
+    int height_ = 0;
+    int bitDepth_ = 0;
+    int colorType_ = 0;
+    int channels_ = 0;
+    size_t stride_ = 0;                 // Scanline bytes, excluding the filter byte
+
+    std::vector<uint8_t> scanline_;     // Filter byte + current scanline
+    std::vector<uint8_t> previous_;     // Previous unfiltered scanline
+    std::vector<uint8_t> grey_;         // Output row (uint8_t or uint16_t samples)
+    size_t scanlineFill_ = 0;
+    int row_ = 0;
+
+    std::string error_;
+};
@@ -0,0 +1,67 @@
+#include "process_memory.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+void releaseFreedMemory()
+{
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+#ifdef _WIN32
+
+size_t processResidentBytes()
+{
+    // K32 entry point lives in kernel32, so psapi.lib is not needed
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.WorkingSetSize;
+}
+
+#elif defined(__APPLE__)
+
+size_t processResidentBytes()
+{
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+}
+
+#else
+
+size_t processResidentBytes()
+{
+    // Second field of statm is resident pages
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    unsigned long totalPages = 0;
+    unsigned long residentPages = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &totalPages, &residentPages);
+    std::fclose(statm);
+    if (fields != 2)
+        return 0;
+    return static_cast<size_t>(residentPages) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+#endif
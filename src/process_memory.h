@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+
+// ============================================================================
+// PROCESS MEMORY
+// ============================================================================
+
+// Resident set size of this process in bytes (working set on Windows), or 0
+// where it cannot be read
+size_t processResidentBytes();
+
+// Hands memory the allocator is holding on to after large frees back to the
+// OS, so a drop in RSS shows up. glibc keeps freed heap pages otherwise;
+// elsewhere this does nothing.
+void releaseFreedMemory();
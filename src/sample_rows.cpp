@@ -0,0 +1,209 @@
+#include "sample_rows.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include "cpu_features.h"
+
+namespace {
+
+template <typename Sample>
+void convertRowScalar(const Sample* samples, int stride, int count,
+                      SampleRange range, float scale, float* out)
+{
+    for (int k = 0; k < count; ++k)
+    {
+        float sample = static_cast<float>(samples[static_cast<size_t>(k) * stride]);
+        out[k] = (sample - range.offset) / range.span * scale;
+    }
+}
+
+#if TERRAIN_X86
+
+// Loads of 4 or 8 consecutive row samples as floats, one overload per
+// sample type. Unit stride widens straight from memory; larger strides
+// (HEIGHTMAP_STEP) pick the samples up one by one.
+
+TERRAIN_TARGET("sse4.2")
+inline __m128 loadSamples4(const uint8_t* samples, size_t stride)
+{
+    if (stride == 1)
+    {
+        int32_t packed;
+        std::memcpy(&packed, samples, sizeof(packed));
+        return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+    }
+    return _mm_cvtepi32_ps(_mm_setr_epi32(samples[0], samples[stride],
+                                          samples[2 * stride], samples[3 * stride]));
+}
+
+TERRAIN_TARGET("sse4.2")
+inline __m128 loadSamples4(const uint16_t* samples, size_t stride)
+{
+    if (stride == 1)
+        return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples))));
+    return _mm_cvtepi32_ps(_mm_setr_epi32(samples[0], samples[stride],
+                                          samples[2 * stride], samples[3 * stride]));
+}
+
+TERRAIN_TARGET("sse4.2")
+inline __m128 loadSamples4(const float* samples, size_t stride)
+{
+    if (stride == 1)
+        return _mm_loadu_ps(samples);
+    return _mm_setr_ps(samples[0], samples[stride], samples[2 * stride], samples[3 * stride]);
+}
+
+TERRAIN_TARGET("avx2")
+inline __m256 loadSamples8(const uint8_t* samples, size_t stride)
+{
+    if (stride == 1)
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples))));
+    return _mm256_cvtepi32_ps(_mm256_setr_epi32(
+        samples[0], samples[stride], samples[2 * stride], samples[3 * stride],
+        samples[4 * stride], samples[5 * stride], samples[6 * stride], samples[7 * stride]));
+}
+
+TERRAIN_TARGET("avx2")
+inline __m256 loadSamples8(const uint16_t* samples, size_t stride)
+{
+    if (stride == 1)
+        return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples))));
+    return _mm256_cvtepi32_ps(_mm256_setr_epi32(
+        samples[0], samples[stride], samples[2 * stride], samples[3 * stride],
+        samples[4 * stride], samples[5 * stride], samples[6 * stride], samples[7 * stride]));
+}
+
+TERRAIN_TARGET("avx2")
+inline __m256 loadSamples8(const float* samples, size_t stride)
+{
+    if (stride == 1)
+        return _mm256_loadu_ps(samples);
+    return _mm256_setr_ps(
+        samples[0], samples[stride], samples[2 * stride], samples[3 * stride],
+        samples[4 * stride], samples[5 * stride], samples[6 * stride], samples[7 * stride]);
+}
+
+// Subtract, divide, multiply in the scalar order (no reciprocal, no FMA)
+// so every kernel produces the same bits
+
+template <typename Sample>
+TERRAIN_TARGET("sse4.2")
+void convertRowSSE42(const Sample* samples, int stride, int count,
+                     SampleRange range, float scale, float* out)
+{
+    const size_t step = static_cast<size_t>(stride);
+    const __m128 offset = _mm_set1_ps(range.offset);
+    const __m128 span = _mm_set1_ps(range.span);
+    const __m128 scaleVec = _mm_set1_ps(scale);
+
+    int k = 0;
+    for (; k + 4 <= count; k += 4)
+    {
+        __m128 value = loadSamples4(samples + k * step, step);
+        _mm_storeu_ps(out + k, _mm_mul_ps(_mm_div_ps(_mm_sub_ps(value, offset), span), scaleVec));
+    }
+    convertRowScalar(samples + k * step, stride, count - k, range, scale, out + k);
+}
+
+template <typename Sample>
+TERRAIN_TARGET("avx2")
+void convertRowAVX2(const Sample* samples, int stride, int count,
+                    SampleRange range, float scale, float* out)
+{
+    const size_t step = static_cast<size_t>(stride);
+    const __m256 offset = _mm256_set1_ps(range.offset);
+    const __m256 span = _mm256_set1_ps(range.span);
+    const __m256 scaleVec = _mm256_set1_ps(scale);
+
+    int k = 0;
+    for (; k + 8 <= count; k += 8)
+    {
+        __m256 value = loadSamples8(samples + k * step, step);
+        _mm256_storeu_ps(out + k, _mm256_mul_ps(_mm256_div_ps(_mm256_sub_ps(value, offset), span),
+                                                scaleVec));
+    }
+    convertRowScalar(samples + k * step, stride, count - k, range, scale, out + k);
+}
+
+#endif // TERRAIN_X86
+
+template <typename Sample>
+using SampleRowFn = void (*)(const Sample*, int, int, SampleRange, float, float*);
+
+template <typename Sample>
+SampleRowFn<Sample> kernelFunction(SampleKernel kernel)
+{
+    switch (kernel)
+    {
+#if TERRAIN_X86
+    case SampleKernel::AVX2:  return convertRowAVX2<Sample>;
+    case SampleKernel::SSE42: return convertRowSSE42<Sample>;
+#endif
+    default:                  return convertRowScalar<Sample>;
+    }
+}
+
+SampleKernel detectSampleKernel()
+{
+    if (cpuHasAVX2())  return SampleKernel::AVX2;
+    if (cpuHasSSE42()) return SampleKernel::SSE42;
+    return SampleKernel::Scalar;
+}
+
+const SampleKernel g_activeKernel = detectSampleKernel();
+
+} // namespace
+
+SampleKernel activeSampleKernel()
+{
+    return g_activeKernel;
+}
+
+bool sampleKernelSupported(SampleKernel kernel)
+{
+    switch (kernel)
+    {
+    case SampleKernel::AVX2:  return cpuHasAVX2();
+    case SampleKernel::SSE42: return cpuHasSSE42();
+    default:                  return true;
+    }
+}
+
+const char* sampleKernelName(SampleKernel kernel)
+{
+    switch (kernel)
+    {
+    case SampleKernel::AVX2:  return "AVX2";
+    case SampleKernel::SSE42: return "SSE4.2";
+    default:                  return "scalar";
+    }
+}
+
+template <typename Sample>
+void convertSampleRow(const Sample* samples, int stride, int count,
+                      SampleRange range, float scale, float* out)
+{
+    kernelFunction<Sample>(g_activeKernel)(samples, stride, count, range, scale, out);
+}
+
+template <typename Sample>
+void convertSampleRowWith(SampleKernel kernel, const Sample* samples, int stride, int count,
+                          SampleRange range, float scale, float* out)
+{
+    kernelFunction<Sample>(kernel)(samples, stride, count, range, scale, out);
+}
+
+template void convertSampleRow<uint8_t>(const uint8_t*, int, int, SampleRange, float, float*);
+template void convertSampleRow<uint16_t>(const uint16_t*, int, int, SampleRange, float, float*);
+template void convertSampleRow<float>(const float*, int, int, SampleRange, float, float*);
+
+template void convertSampleRowWith<uint8_t>(SampleKernel, const uint8_t*, int, int,
+                                            SampleRange, float, float*);
+template void convertSampleRowWith<uint16_t>(SampleKernel, const uint16_t*, int, int,
+                                             SampleRange, float, float*);
+template void convertSampleRowWith<float>(SampleKernel, const float*, int, int,
+                                          SampleRange, float, float*);
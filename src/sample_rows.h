@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+#include "heightmap.h"
+
+// Heightmap sample to height conversion for one row of grid vertices.
+//
+// Sample k of the row is samples[k * stride] and becomes
+//     (sample - range.offset) / range.span * scale
+// evaluated in that order, so 8-bit rows give exactly the byte / 255.0f
+// heights of the serial generator. Every sample type has its own kernels;
+// samples stay in their stored width until this point.
+
+enum class SampleKernel
+{
+    Scalar,
+    SSE42,      // 4 samples per instruction
+    AVX2        // 8 samples per instruction
+};
+
+SampleKernel activeSampleKernel();
+bool sampleKernelSupported(SampleKernel kernel);
+const char* sampleKernelName(SampleKernel kernel);
+
+// Instantiated for uint8_t, uint16_t and float
+template <typename Sample>
+void convertSampleRow(const Sample* samples, int stride, int count,
+                      SampleRange range, float scale, float* out);
+
+// Same as above with an explicit kernel, for benchmarks and accuracy checks
+template <typename Sample>
+void convertSampleRowWith(SampleKernel kernel, const Sample* samples, int stride, int count,
+                          SampleRange range, float scale, float* out);
@@ -127,11 +127,26 @@ public:
             glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
     }
 
+    void setInt(const std::string &name, int value) const {
+        if (ID != 0)
+            glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    }
+
+    void setVec2(const std::string &name, float x, float y) const {
+        if (ID != 0)
+            glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    }
+
     void setVec3(const std::string &name, const float* value) const {
         if (ID != 0)
             glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, value);
     }
 
+    void setVec4Array(const std::string &name, int count, const float* values) const {
+        if (ID != 0)
+            glUniform4fv(glGetUniformLocation(ID, name.c_str()), count, values);
+    }
+
     bool isValid() const {
         return ID != 0;
     }
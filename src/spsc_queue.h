@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// ============================================================================
+// SINGLE-PRODUCER, SINGLE-CONSUMER QUEUE
+// ============================================================================
+
+// Fixed-capacity lock-free ring buffer for handing items from exactly one
+// thread to exactly one other. push() and pop() never block; they fail when
+// the queue is full or empty. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscQueue {
+public:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Queue capacity must be a power of two");
+
+    // Producer thread only
+    bool push(T item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items_[tail & (Capacity - 1)] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool pop(T& item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = std::move(items_[head & (Capacity - 1)]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items_[Capacity];
+    // Separate cache lines, so the two threads do not share a line
+    alignas(64) std::atomic<size_t> head_{ 0 };
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+};
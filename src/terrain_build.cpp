@@ -0,0 +1,100 @@
+#include "terrain_build.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "terrain_cache.h"
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TerrainBuild::TerrainBuild(const Settings& settings, ThreadPool& pool)
+    : settings_(settings),
+      pool_(pool)
+{
+    thread_ = std::thread([this] { run(); });
+}
+
+TerrainBuild::~TerrainBuild()
+{
+    cancelled_ = true;
+    thread_.join();
+}
+
+std::unique_ptr<TerrainMesh> TerrainBuild::takePreview()
+{
+    if (stage_.load(std::memory_order_acquire) < PreviewReady)
+        return nullptr;
+    return std::move(preview_);
+}
+
+std::unique_ptr<CollisionGrid> TerrainBuild::takeCollisionGrid()
+{
+    if (stage_.load(std::memory_order_acquire) < PreviewReady)
+        return nullptr;
+    return std::move(collisionGrid_);
+}
+
+std::unique_ptr<TerrainMesh> TerrainBuild::takeMesh()
+{
+    if (stage_.load(std::memory_order_acquire) != MeshReady)
+        return nullptr;
+    return std::move(mesh_);
+}
+
+void TerrainBuild::run()
+{
+    // The mesh only needs every HEIGHTMAP_STEP-th sample, so the map is
+    // streamed through a downsampler instead of held at full resolution
+    auto loadStart = std::chrono::steady_clock::now();
+    Heightmap heightmap = Heightmap::loadDownsampled(settings_.heightmapPath.c_str(),
+                                                     HEIGHTMAP_STEP, settings_.filter);
+    if (!heightmap.isValid())
+    {
+        error_ = heightmap.error();
+        stage_.store(Failed, std::memory_order_release);
+        return;
+    }
+    const HeightmapView& view = heightmap.view();
+    loadInfo_.width = view.width;
+    loadInfo_.height = view.height;
+    loadInfo_.format = view.format;
+    loadInfo_.mapped = heightmap.isMapped();
+    loadInfo_.peakLoadBytes = heightmap.peakLoadBytes();
+    loadInfo_.loadMs = millisecondsSince(loadStart);
+
+    // Preview: the same grid at a coarser step, a single chunk
+    auto previewStart = std::chrono::steady_clock::now();
+    int longest = std::max(view.width, view.height);
+    loadInfo_.previewStep = std::max(1, (longest + STARTUP_PREVIEW_GRID_SIZE - 1) /
+                                        STARTUP_PREVIEW_GRID_SIZE);
+    preview_ = std::make_unique<TerrainMesh>(
+        generateTerrainMesh(view, loadInfo_.previewStep, settings_.format, pool_));
+    loadInfo_.previewMs = millisecondsSince(previewStart);
+
+    // Collision reads the same grid the full mesh is built from
+    collisionGrid_ = std::make_unique<CollisionGrid>(view);
+    stage_.store(PreviewReady, std::memory_order_release);
+
+    if (cancelled_)
+        return;
+
+    auto meshStart = std::chrono::steady_clock::now();
+    mesh_ = std::make_unique<TerrainMesh>(generateTerrainMesh(view, 1, settings_.format, pool_));
+    meshMs_ = millisecondsSince(meshStart);
+
+    if (!settings_.cachePath.empty() && !cancelled_)
+    {
+        cacheWritten_ = writeTerrainCache(settings_.cachePath, settings_.cacheKey, *mesh_, view,
+                                          cacheMessage_);
+        if (cacheWritten_)
+            cacheMessage_ = settings_.cachePath;
+    }
+    stage_.store(MeshReady, std::memory_order_release);
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "collision_grid.h"
+#include "heightmap.h"
+#include "terrain_cache.h"
+#include "terrain_mesh.h"
+#include "thread_pool.h"
+
+// ============================================================================
+// PROGRESSIVE STARTUP SETTINGS
+// ============================================================================
+
+// The first frame waits at most this long after startup for the preview
+// terrain; past it the window shows the sky alone until the preview lands
+const double STARTUP_FIRST_FRAME_BUDGET_MS = 100.0;
+
+// Longest side of the preview grid, in vertices
+const int STARTUP_PREVIEW_GRID_SIZE = 128;
+
+// ============================================================================
+// BACKGROUND TERRAIN BUILD
+// ============================================================================
+
+// Loads the heightmap and generates the mesh backend's terrain on a
+// background thread while the window is already drawing. Results come out
+// in two steps: a coarse preview mesh made from every few samples of the
+// downsampled grid as soon as it has loaded, along with the collision grid,
+// then the full mesh, baked to
+// the terrain cache first when a cache path is given. The render thread
+// polls for each once per frame and takes ownership.
+class TerrainBuild
+{
+public:
+    struct Settings
+    {
+        std::string heightmapPath;
+        DownsampleFilter filter = DownsampleFilter::Box;
+        TerrainVertexFormat format = TerrainVertexFormat::Compact;
+        std::string cachePath;      // Empty: do not bake
+        TerrainCacheKey cacheKey;
+    };
+
+    // What was loaded, for the startup report
+    struct LoadInfo
+    {
+        int width = 0;              // Downsampled grid
+        int height = 0;
+        HeightmapFormat format = HeightmapFormat::U8;
+        bool mapped = false;
+        size_t peakLoadBytes = 0;
+        double loadMs = 0.0;
+        int previewStep = 1;
+        double previewMs = 0.0;
+    };
+
+    // Starts the build; pool generates the meshes and must outlive it
+    TerrainBuild(const Settings& settings, ThreadPool& pool);
+
+    // Waits for the build, skipping what has not started yet
+    ~TerrainBuild();
+
+    TerrainBuild(const TerrainBuild&) = delete;
+    TerrainBuild& operator=(const TerrainBuild&) = delete;
+
+    // Render thread. Each result is handed out once, after it is ready.
+    bool previewReady() const { return stage_.load(std::memory_order_acquire) >= PreviewReady; }
+    std::unique_ptr<TerrainMesh> takePreview();
+    std::unique_ptr<CollisionGrid> takeCollisionGrid();     // With the preview
+    std::unique_ptr<TerrainMesh> takeMesh();
+    bool failed() const { return stage_.load(std::memory_order_acquire) == Failed; }
+
+    // Valid from the matching stage on
+    const LoadInfo& loadInfo() const { return loadInfo_; }          // Preview
+    double meshMs() const { return meshMs_; }                       // Mesh
+    const std::string& cacheMessage() const { return cacheMessage_; }  // Mesh
+    bool cacheWritten() const { return cacheWritten_; }             // Mesh
+    const std::string& error() const { return error_; }            // Failed
+
+private:
+    enum Stage
+    {
+        Loading,
+        PreviewReady,
+        MeshReady,
+        Failed
+    };
+
+    void run();
+
+    Settings settings_;
+    ThreadPool& pool_;
+    std::thread thread_;
+    std::atomic<int> stage_{ Loading };
+    std::atomic<bool> cancelled_{ false };
+
+    // Written by the build thread before the stage that publishes them
+    LoadInfo loadInfo_;
+    std::unique_ptr<TerrainMesh> preview_;
+    std::unique_ptr<CollisionGrid> collisionGrid_;
+    std::unique_ptr<TerrainMesh> mesh_;
+    double meshMs_ = 0.0;
+    bool cacheWritten_ = false;
+    std::string cacheMessage_;
+    std::string error_;
+};
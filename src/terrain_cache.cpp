@@ -0,0 +1,306 @@
+#include "terrain_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const char CACHE_MAGIC[8] = { 'T', 'R', 'N', 'C', 'A', 'C', 'H', 'E' };
+const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+const size_t CACHE_ALIGNMENT = 64;
+
+struct CacheSection
+{
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+// Written as-is at the start of the file. Caches are machine-local, so the
+// header records the host's byte order and struct sizes instead of
+// converting anything.
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t key;
+    uint64_t sourceBytes;
+    uint32_t vertexFormat;
+    uint32_t vertexSize;
+    uint32_t chunkSize;
+    uint32_t gridFormat;
+    int32_t gridWidth;
+    int32_t gridHeight;
+    int32_t chunksX;
+    int32_t chunksZ;
+    float gridRangeOffset;
+    float gridRangeSpan;
+    CacheSection vertices;
+    CacheSection indices;
+    CacheSection chunks;
+    CacheSection grid;
+};
+
+// ----------------------------------------------------------------------------
+// Hashing: four independent multiply-rotate lanes over 32-byte blocks, then
+// an avalanche of the combined state. Fast enough to hash a heightmap on
+// every launch. A collision would serve another map's mesh, which is why
+// the cache header also records the source size.
+// ----------------------------------------------------------------------------
+
+const uint64_t HASH_PRIME1 = 0x9E3779B185EBCA87ull;
+const uint64_t HASH_PRIME2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t HASH_PRIME3 = 0x165667B19E3779F9ull;
+
+inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t hashRound(uint64_t lane, uint64_t word)
+{
+    return rotateLeft(lane + word * HASH_PRIME2, 31) * HASH_PRIME1;
+}
+
+inline uint64_t loadWord(const unsigned char* bytes)
+{
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t lanes[4] = { seed + HASH_PRIME1, seed + HASH_PRIME2, seed, seed - HASH_PRIME1 };
+
+    size_t offset = 0;
+    for (; offset + 32 <= size; offset += 32)
+    {
+        lanes[0] = hashRound(lanes[0], loadWord(bytes + offset));
+        lanes[1] = hashRound(lanes[1], loadWord(bytes + offset + 8));
+        lanes[2] = hashRound(lanes[2], loadWord(bytes + offset + 16));
+        lanes[3] = hashRound(lanes[3], loadWord(bytes + offset + 24));
+    }
+
+    uint64_t hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+                    rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+    hash += size;
+    for (; offset + 8 <= size; offset += 8)
+        hash = rotateLeft(hash ^ hashRound(0, loadWord(bytes + offset)), 27) * HASH_PRIME1 + HASH_PRIME3;
+    for (; offset < size; ++offset)
+        hash = rotateLeft(hash ^ (bytes[offset] * HASH_PRIME3), 11) * HASH_PRIME1;
+
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+size_t alignUp(size_t value)
+{
+    return (value + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+}
+
+bool sectionInFile(const CacheSection& section, size_t fileBytes)
+{
+    return section.offset % CACHE_ALIGNMENT == 0 && section.offset <= fileBytes &&
+           section.bytes <= fileBytes - section.offset;
+}
+
+} // namespace
+
+bool terrainCacheKey(const char* heightmapPath, TerrainVertexFormat format,
+                     DownsampleFilter filter, TerrainCacheKey& key)
+{
+    MappedFile source;
+    if (!source.open(heightmapPath))
+        return false;
+    uint64_t hash = hashBytes(source.data(), source.size(), 0);
+
+    // The sidecar decides how a raw file is read
+    std::string sidecarPath = std::string(heightmapPath) + ".hdr";
+    std::ifstream sidecar(sidecarPath, std::ios::binary);
+    if (sidecar)
+    {
+        std::vector<char> text((std::istreambuf_iterator<char>(sidecar)),
+                               std::istreambuf_iterator<char>());
+        hash = hashBytes(text.data(), text.size(), hash);
+    }
+
+    float heightScale = HEIGHT_SCALE;
+    uint32_t heightScaleBits;
+    std::memcpy(&heightScaleBits, &heightScale, sizeof(heightScaleBits));
+    const uint64_t settings[] = {
+        TERRAIN_CACHE_VERSION,
+        static_cast<uint64_t>(HEIGHTMAP_STEP),
+        heightScaleBits,
+        static_cast<uint64_t>(TERRAIN_CHUNK_SIZE),
+        static_cast<uint64_t>(format),
+        static_cast<uint64_t>(filter),
+    };
+    key.hash = hashBytes(settings, sizeof(settings), hash);
+    key.sourceBytes = source.size();
+    return true;
+}
+
+std::string terrainCachePath(const std::string& directory, const TerrainCacheKey& key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.terrain", static_cast<unsigned long long>(key.hash));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool TerrainCache::open(const std::string& path, const TerrainCacheKey& key)
+{
+    file_.close();
+    MappedFile file;
+    if (!file.open(path.c_str()) || file.size() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    const TerrainVertexFormat format = static_cast<TerrainVertexFormat>(header.vertexFormat);
+    const size_t vertexSize = format == TerrainVertexFormat::Compact
+        ? sizeof(CompactTerrainVertex) : sizeof(TerrainVertex);
+    const HeightmapFormat gridFormat = static_cast<HeightmapFormat>(header.gridFormat);
+
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != TERRAIN_CACHE_VERSION || header.byteOrder != CACHE_BYTE_ORDER ||
+        header.key != key.hash || header.sourceBytes != key.sourceBytes ||
+        header.vertexSize != vertexSize ||
+        header.chunkSize != sizeof(TerrainChunk) || header.gridFormat > 2 ||
+        header.gridWidth < 2 || header.gridHeight < 2 || header.chunksX < 1 || header.chunksZ < 1)
+        return false;
+
+    const size_t chunkCount = static_cast<size_t>(header.chunksX) * header.chunksZ;
+    if (!sectionInFile(header.vertices, file.size()) || !sectionInFile(header.indices, file.size()) ||
+        !sectionInFile(header.chunks, file.size()) || !sectionInFile(header.grid, file.size()) ||
+        header.vertices.bytes % vertexSize != 0 || header.indices.bytes % sizeof(uint16_t) != 0 ||
+        header.chunks.bytes != chunkCount * sizeof(TerrainChunk) ||
+        header.grid.bytes != static_cast<size_t>(header.gridWidth) * header.gridHeight *
+                             heightmapSampleBytes(gridFormat))
+        return false;
+
+    const unsigned char* base = static_cast<const unsigned char*>(file.data());
+    const TerrainChunk* chunks = reinterpret_cast<const TerrainChunk*>(base + header.chunks.offset);
+    const size_t vertexCount = header.vertices.bytes / vertexSize;
+    const size_t indexCount = header.indices.bytes / sizeof(uint16_t);
+
+    // Draws must stay inside the buffers even if the file was tampered with
+    for (size_t c = 0; c < chunkCount; ++c)
+    {
+        size_t rows = static_cast<size_t>(chunks[c].quadsZ) + 1;
+        if (chunks[c].quadsZ < 0 || chunks[c].indexCount > indexCount ||
+            chunks[c].baseVertex + rows * TERRAIN_CHUNK_SIZE > vertexCount)
+            return false;
+    }
+
+    buffers_.format = format;
+    buffers_.vertexData = base + header.vertices.offset;
+    buffers_.vertexBytes = header.vertices.bytes;
+    buffers_.indices = reinterpret_cast<const uint16_t*>(base + header.indices.offset);
+    buffers_.indexCount = indexCount;
+    buffers_.chunks = chunks;
+    buffers_.chunkCount = chunkCount;
+    buffers_.gridWidth = header.gridWidth;
+    buffers_.gridHeight = header.gridHeight;
+
+    grid_.data = base + header.grid.offset;
+    grid_.width = header.gridWidth;
+    grid_.height = header.gridHeight;
+    grid_.format = gridFormat;
+    grid_.range = { header.gridRangeOffset, header.gridRangeSpan };
+
+    file_ = std::move(file);
+    return true;
+}
+
+bool writeTerrainCache(const std::string& path, const TerrainCacheKey& key, const TerrainMesh& mesh,
+                       const HeightmapView& grid, std::string& error)
+{
+    if (grid.width != mesh.gridWidth || grid.height != mesh.gridHeight)
+    {
+        error = "grid does not match the mesh";
+        return false;
+    }
+
+    const TerrainMeshBuffers buffers = mesh.buffers();
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = TERRAIN_CACHE_VERSION;
+    header.byteOrder = CACHE_BYTE_ORDER;
+    header.key = key.hash;
+    header.sourceBytes = key.sourceBytes;
+    header.vertexFormat = static_cast<uint32_t>(mesh.format);
+    header.vertexSize = static_cast<uint32_t>(mesh.format == TerrainVertexFormat::Compact
+        ? sizeof(CompactTerrainVertex) : sizeof(TerrainVertex));
+    header.chunkSize = sizeof(TerrainChunk);
+    header.gridFormat = static_cast<uint32_t>(grid.format);
+    header.gridWidth = grid.width;
+    header.gridHeight = grid.height;
+    header.chunksX = mesh.chunksX;
+    header.chunksZ = mesh.chunksZ;
+    header.gridRangeOffset = grid.range.offset;
+    header.gridRangeSpan = grid.range.span;
+
+    const void* sources[4] = { buffers.vertexData, buffers.indices, buffers.chunks, grid.data };
+    CacheSection* sections[4] = { &header.vertices, &header.indices, &header.chunks, &header.grid };
+    const size_t sizes[4] = {
+        buffers.vertexBytes,
+        buffers.indexCount * sizeof(uint16_t),
+        buffers.chunkCount * sizeof(TerrainChunk),
+        static_cast<size_t>(grid.width) * grid.height * heightmapSampleBytes(grid.format),
+    };
+    size_t offset = alignUp(sizeof(CacheHeader));
+    for (int s = 0; s < 4; ++s)
+    {
+        sections[s]->offset = offset;
+        sections[s]->bytes = sizes[s];
+        offset = alignUp(offset + sizes[s]);
+    }
+
+    std::error_code ec;
+    std::filesystem::path target(path);
+    if (target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), ec);
+
+    // Unique temporary name, in case two instances bake at once
+    std::filesystem::path temporary = target;
+    temporary += ".tmp" + std::to_string(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        const char padding[CACHE_ALIGNMENT] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        size_t written = sizeof(header);
+        for (int s = 0; s < 4; ++s)
+        {
+            out.write(padding, static_cast<std::streamsize>(sections[s]->offset - written));
+            out.write(static_cast<const char*>(sources[s]), static_cast<std::streamsize>(sizes[s]));
+            written = sections[s]->offset + sizes[s];
+        }
+        if (!out)
+        {
+            out.close();
+            std::filesystem::remove(temporary, ec);
+            error = "cannot write " + temporary.string();
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, target, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temporary, ec);
+        error = "cannot rename cache into place: " + ec.message();
+        return false;
+    }
+    return true;
+}
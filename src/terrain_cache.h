@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "heightmap.h"
+#include "mapped_file.h"
+#include "terrain_mesh.h"
+
+// ============================================================================
+// BAKED TERRAIN CACHE
+// ============================================================================
+
+// Bump whenever the cache layout or anything that feeds the baked data
+// (mesh generation, normals, vertex encoding, downsampling) changes
+const uint32_t TERRAIN_CACHE_VERSION = 2;
+
+// Identifies the heightmap and settings a cache was baked from. The hash
+// names the file; the source size is stored alongside it and checked too,
+// so a hash collision between maps of different sizes is caught instead of
+// serving the wrong mesh.
+struct TerrainCacheKey
+{
+    uint64_t hash = 0;
+    uint64_t sourceBytes = 0;   // Heightmap file size
+};
+
+// Content hash of the heightmap file (and its .hdr sidecar, if any) combined
+// with every setting that shapes the baked mesh: HEIGHTMAP_STEP,
+// HEIGHT_SCALE, the chunk size, the vertex format, the downsample filter and
+// the cache version. Returns false if the heightmap cannot be read.
+bool terrainCacheKey(const char* heightmapPath, TerrainVertexFormat format,
+                     DownsampleFilter filter, TerrainCacheKey& key);
+
+// "<directory>/<hash as 16 hex digits>.terrain"
+std::string terrainCachePath(const std::string& directory, const TerrainCacheKey& key);
+
+// A baked mesh file, mapped read-only. Sections sit at 64-byte aligned
+// offsets in the order header, vertices, indices, chunks, grid samples, so
+// the vertex and index blobs go straight to glBufferData and the grid
+// serves collision queries in place.
+class TerrainCache {
+public:
+    // Returns false if the file is missing, from another version or build,
+    // keyed differently, or truncated
+    bool open(const std::string& path, const TerrainCacheKey& key);
+
+    bool isOpen() const { return file_.isOpen(); }
+    const TerrainMeshBuffers& buffers() const { return buffers_; }
+    const HeightmapView& grid() const { return grid_; }
+    size_t fileBytes() const { return file_.size(); }
+
+private:
+    MappedFile file_;
+    TerrainMeshBuffers buffers_;
+    HeightmapView grid_;
+};
+
+// Writes the baked mesh and the grid it was built from (width x height
+// samples matching mesh.gridWidth x mesh.gridHeight). The file is written
+// under a temporary name and renamed into place, so readers never see a
+// partial cache.
+bool writeTerrainCache(const std::string& path, const TerrainCacheKey& key, const TerrainMesh& mesh,
+                       const HeightmapView& grid, std::string& error);
@@ -0,0 +1,266 @@
+#include "terrain_collision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace {
+
+// Smaller root of a t^2 + b t + c = 0 if it lies in [0, limit): the time the
+// sphere starts touching, given it does not touch at t = 0
+bool firstContact(float a, float b, float c, float limit, float& root)
+{
+    if (std::abs(a) < 1.0e-12f)
+        return false;
+    float discriminant = b * b - 4.0f * a * c;
+    if (discriminant < 0.0f)
+        return false;
+    float sqrtDiscriminant = std::sqrt(discriminant);
+    float r0 = (-b - sqrtDiscriminant) / (2.0f * a);
+    float r1 = (-b + sqrtDiscriminant) / (2.0f * a);
+    root = std::min(r0, r1);
+    return root >= 0.0f && root < limit;
+}
+
+glm::vec3 closestOnSegment(const glm::vec3& point, const glm::vec3& a, const glm::vec3& b)
+{
+    glm::vec3 edge = b - a;
+    float f = glm::dot(point - a, edge) / glm::dot(edge, edge);
+    return a + edge * std::max(0.0f, std::min(f, 1.0f));
+}
+
+// Whether a point on the triangle's plane lies inside it
+bool insideTriangle(const glm::vec3& point, const glm::vec3& p0, const glm::vec3& p1,
+                    const glm::vec3& p2, const glm::vec3& normal)
+{
+    return glm::dot(glm::cross(p1 - p0, point - p0), normal) >= 0.0f &&
+           glm::dot(glm::cross(p2 - p1, point - p1), normal) >= 0.0f &&
+           glm::dot(glm::cross(p0 - p2, point - p2), normal) >= 0.0f;
+}
+
+// Sphere at center moving by motion (t in 0..1) against one triangle: the
+// face first, then its edges and corners, which can only be reached once
+// the sphere is within the radius of the plane. Updates bestT and normal
+// if contact comes before bestT.
+bool sweepTriangle(const glm::vec3& center, const glm::vec3& motion, float radius,
+                   const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2,
+                   float& bestT, glm::vec3& contactNormal)
+{
+    glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+    if (normal.y < 0.0f)
+        normal = -normal;
+
+    // Moving along or away from the face never closes in on it
+    float approach = glm::dot(normal, motion);
+    if (approach >= -1.0e-9f)
+        return false;
+    float distance = glm::dot(normal, center - p0);
+    if (distance < -radius)
+        return false;   // Behind the triangle, below the surface it is part of
+
+    float planeT = distance <= radius ? 0.0f : (radius - distance) / approach;
+    if (planeT >= bestT)
+        return false;
+
+    glm::vec3 planeCenter = center + motion * planeT;
+    glm::vec3 onPlane = planeCenter - normal * glm::dot(normal, planeCenter - p0);
+    if (insideTriangle(onPlane, p0, p1, p2, normal))
+    {
+        bestT = planeT;
+        contactNormal = normal;
+        return true;
+    }
+
+    // Edges and corners. One the sphere already overlaps stops it at once
+    // if the motion heads into it.
+    const float radiusSq = radius * radius;
+    const float motionSq = glm::dot(motion, motion);
+    const glm::vec3 corners[3] = { p0, p1, p2 };
+    bool found = false;
+    for (int e = 0; e < 3; ++e)
+    {
+        const glm::vec3& a = corners[e];
+        const glm::vec3& b = corners[(e + 1) % 3];
+
+        glm::vec3 nearest = closestOnSegment(center, a, b);
+        glm::vec3 away = center - nearest;
+        if (glm::dot(away, away) < radiusSq)
+        {
+            if (glm::dot(away, motion) < 0.0f && bestT > 0.0f)
+            {
+                bestT = 0.0f;
+                contactNormal = glm::normalize(away);
+                found = true;
+            }
+            continue;
+        }
+
+        // Corner: |center + t motion - a| = radius
+        float t;
+        glm::vec3 toCenter = center - a;
+        if (firstContact(motionSq, 2.0f * glm::dot(motion, toCenter),
+                         glm::dot(toCenter, toCenter) - radiusSq, bestT, t))
+        {
+            bestT = t;
+            contactNormal = glm::normalize(center + motion * t - a);
+            found = true;
+        }
+
+        // Edge: distance from the line through a and b equals the radius,
+        // with the nearest point between a and b
+        glm::vec3 edge = b - a;
+        glm::vec3 base = a - center;
+        float edgeSq = glm::dot(edge, edge);
+        float edgeDotMotion = glm::dot(edge, motion);
+        float edgeDotBase = glm::dot(edge, base);
+        if (firstContact(edgeSq * -motionSq + edgeDotMotion * edgeDotMotion,
+                         edgeSq * 2.0f * glm::dot(motion, base) - 2.0f * edgeDotMotion * edgeDotBase,
+                         edgeSq * (radiusSq - glm::dot(base, base)) + edgeDotBase * edgeDotBase,
+                         bestT, t))
+        {
+            float f = (edgeDotMotion * t - edgeDotBase) / edgeSq;
+            if (f >= 0.0f && f <= 1.0f)
+            {
+                bestT = t;
+                contactNormal = glm::normalize(center + motion * t - (a + edge * f));
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+} // namespace
+
+bool sweepSphere(const CollisionGrid& grid, const glm::vec3& start, const glm::vec3& motion,
+                 float radius, TerrainSweepHit& hit)
+{
+    if (!grid.isValid() || motion == glm::vec3(0.0f))
+        return false;
+
+    const int cellsX = grid.width() - 1;
+    const int cellsZ = grid.height() - 1;
+    const float cellSizeX = 60.0f / cellsX;
+    const float cellSizeZ = 60.0f / cellsZ;
+    auto vertex = [&](int x, int z) {
+        return glm::vec3(x * cellSizeX - 30.0f, grid.sampleHeight(x, z), z * cellSizeZ - 30.0f);
+    };
+
+    // Cells within this many of the centre's cell can be touched
+    const int reachX = static_cast<int>(std::ceil(radius / cellSizeX));
+    const int reachZ = static_cast<int>(std::ceil(radius / cellSizeZ));
+
+    float bestT = 1.0f;
+    glm::vec3 bestNormal(0.0f, 1.0f, 0.0f);
+    bool found = false;
+    auto testCell = [&](int x, int z) {
+        if (x < 0 || z < 0 || x >= cellsX || z >= cellsZ)
+            return;
+        const glm::vec3 topLeft = vertex(x, z);
+        const glm::vec3 bottomLeft = vertex(x, z + 1);
+        const glm::vec3 topRight = vertex(x + 1, z);
+        const glm::vec3 bottomRight = vertex(x + 1, z + 1);
+        found |= sweepTriangle(start, motion, radius, topLeft, bottomLeft, topRight, bestT, bestNormal);
+        found |= sweepTriangle(start, motion, radius, topRight, bottomLeft, bottomRight, bestT, bestNormal);
+    };
+
+    // 2D DDA over the cells under the centre's path. Each step tests the
+    // block of cells around the new cell that the previous block missed.
+    const glm::vec3 end = start + motion;
+    int cx = static_cast<int>(std::floor((start.x + 30.0f) / cellSizeX));
+    int cz = static_cast<int>(std::floor((start.z + 30.0f) / cellSizeZ));
+    const int endX = static_cast<int>(std::floor((end.x + 30.0f) / cellSizeX));
+    const int endZ = static_cast<int>(std::floor((end.z + 30.0f) / cellSizeZ));
+    const int steps = std::abs(endX - cx) + std::abs(endZ - cz);
+
+    const float never = std::numeric_limits<float>::max();
+    const int stepX = endX > cx ? 1 : -1;
+    const int stepZ = endZ > cz ? 1 : -1;
+    float tNextX = endX != cx
+        ? ((cx + (stepX > 0 ? 1 : 0)) * cellSizeX - 30.0f - start.x) / motion.x : never;
+    float tNextZ = endZ != cz
+        ? ((cz + (stepZ > 0 ? 1 : 0)) * cellSizeZ - 30.0f - start.z) / motion.z : never;
+    const float tDeltaX = endX != cx ? cellSizeX / std::abs(motion.x) : never;
+    const float tDeltaZ = endZ != cz ? cellSizeZ / std::abs(motion.z) : never;
+
+    int previousX = 0, previousZ = 0;
+    for (int step = 0; step <= steps; ++step)
+    {
+        for (int z = cz - reachZ; z <= cz + reachZ; ++z)
+        {
+            for (int x = cx - reachX; x <= cx + reachX; ++x)
+            {
+                if (step > 0 && std::abs(x - previousX) <= reachX && std::abs(z - previousZ) <= reachZ)
+                    continue;
+                testCell(x, z);
+            }
+        }
+        previousX = cx;
+        previousZ = cz;
+
+        // Any contact before the centre leaves this cell is within reach of
+        // a cell already tested
+        if (found && bestT <= std::min(tNextX, tNextZ))
+            break;
+        if ((tNextX < tNextZ && cx != endX) || cz == endZ)
+        {
+            cx += stepX;
+            tNextX += tDeltaX;
+        }
+        else
+        {
+            cz += stepZ;
+            tNextZ += tDeltaZ;
+        }
+    }
+
+    if (!found)
+        return false;
+    hit.fraction = bestT;
+    hit.position = start + motion * bestT;
+    hit.normal = bestNormal;
+    return true;
+}
+
+glm::vec3 moveSphere(const CollisionGrid& grid, const glm::vec3& start, const glm::vec3& motion,
+                     float radius)
+{
+    glm::vec3 position = start;
+    glm::vec3 remaining = motion;
+    glm::vec3 previousNormal(0.0f);
+    for (int i = 0; i < TERRAIN_SLIDE_ITERATIONS; ++i)
+    {
+        float length = glm::length(remaining);
+        if (length < 1.0e-6f)
+            break;
+
+        TerrainSweepHit hit;
+        if (!sweepSphere(grid, position, remaining, radius, hit))
+        {
+            position += remaining;
+            break;
+        }
+
+        // Stop just short of the contact, then keep the part of the rest of
+        // the motion that runs along the surface
+        float travel = std::max(0.0f, hit.fraction * length - TERRAIN_CONTACT_SKIN);
+        position += remaining * (travel / length);
+        remaining *= 1.0f - hit.fraction;
+        remaining -= hit.normal * glm::dot(remaining, hit.normal);
+
+        // In a crease, sliding off one face runs into the other; follow the
+        // line where they meet instead of bouncing between them
+        if (i > 0 && glm::dot(remaining, previousNormal) < 0.0f)
+        {
+            glm::vec3 crease = glm::cross(previousNormal, hit.normal);
+            float creaseLength = glm::length(crease);
+            if (creaseLength < 1.0e-6f)
+                break;
+            crease /= creaseLength;
+            remaining = crease * glm::dot(remaining, crease);
+        }
+        previousNormal = hit.normal;
+    }
+    return position;
+}
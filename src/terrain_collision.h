@@ -0,0 +1,40 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "collision_grid.h"
+
+// ============================================================================
+// SWEEP SETTINGS
+// ============================================================================
+
+// Contacts handled per move. Each one removes the motion into the surface
+// and sweeps what is left along it, so two cover sliding into a crease.
+const int TERRAIN_SLIDE_ITERATIONS = 3;
+
+// Distance kept from the surface after a contact, so the next sweep does not
+// start touching it
+const float TERRAIN_CONTACT_SKIN = 1.0e-3f;
+
+// ============================================================================
+// SWEPT-SPHERE COLLISION
+// ============================================================================
+
+struct TerrainSweepHit
+{
+    float fraction = 1.0f;      // Of the motion travelled before contact
+    glm::vec3 position{0.0f};   // Sphere centre at contact
+    glm::vec3 normal{0.0f, 1.0f, 0.0f};   // Away from the surface at the contact
+};
+
+// First contact of a sphere moving from start by motion with the collision
+// grid's surface, triangulated as the mesh is. Only the cells the motion
+// crosses are tested, plus those within the radius of them, so the cost
+// follows the distance moved rather than a fixed number of substeps. A
+// sphere already touching the surface only collides if it moves further in.
+bool sweepSphere(const CollisionGrid& grid, const glm::vec3& start, const glm::vec3& motion,
+                 float radius, TerrainSweepHit& hit);
+
+// Moves a sphere by motion, stopping at the surface and sliding along it
+// with the rest of the motion. Returns the final centre.
+glm::vec3 moveSphere(const CollisionGrid& grid, const glm::vec3& start, const glm::vec3& motion,
+                     float radius);
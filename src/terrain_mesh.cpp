@@ -0,0 +1,355 @@
+#include "terrain_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "sample_rows.h"
+#include "terrain_normals.h"
+
+// ============================================================================
+// PARALLEL MESH GENERATION
+// ============================================================================
+
+namespace {
+
+// Per-thread scratch reused across chunks
+struct ChunkScratch
+{
+    std::vector<float> heights;
+    std::vector<float> normalX;
+    std::vector<float> normalY;
+    std::vector<float> normalZ;
+};
+
+// Fills in the vertices and bounds of one chunk. The scratch tile holds the
+// chunk's heights plus a one-vertex halo ring, clamped to the grid so the
+// halo reproduces the edge clamping of the serial normal pass.
+template <typename Sample>
+void buildMeshChunk(TerrainMesh& mesh, TerrainChunk& chunk,
+                    const Sample* heightmapData, int imgWidth, int step, SampleRange range,
+                    ChunkScratch& scratch)
+{
+    const int gridWidth = mesh.gridWidth;
+    const int gridHeight = mesh.gridHeight;
+    const int tileWidth = TERRAIN_CHUNK_SIZE + 2;
+    const int rows = chunk.quadsZ + 1;
+
+    scratch.heights.resize(static_cast<size_t>(rows + 2) * tileWidth);
+    scratch.normalX.resize(tileWidth);
+    scratch.normalY.resize(tileWidth);
+    scratch.normalZ.resize(tileWidth);
+
+    // Tile (c, r) holds grid vertex (originX - 1 + c, originZ - 1 + r).
+    // Columns inside the grid are converted straight from the samples,
+    // every step-th one; halo columns past the grid edge copy the edge.
+    const int firstColumn = chunk.originX == 0 ? 1 : 0;
+    const int endColumn = std::min(tileWidth, gridWidth - chunk.originX + 1);
+    for (int r = 0; r < rows + 2; ++r)
+    {
+        int j = std::max(0, std::min(chunk.originZ - 1 + r, gridHeight - 1));
+        const Sample* samples = heightmapData + static_cast<size_t>(j) * step * imgWidth +
+                                static_cast<size_t>(chunk.originX - 1 + firstColumn) * step;
+        float* row = &scratch.heights[static_cast<size_t>(r) * tileWidth];
+        convertSampleRow(samples, step, endColumn - firstColumn, range, HEIGHT_SCALE,
+                         row + firstColumn);
+        for (int c = 0; c < firstColumn; ++c)
+            row[c] = row[firstColumn];
+        for (int c = endColumn; c < tileWidth; ++c)
+            row[c] = row[endColumn - 1];
+    }
+
+    float minHeight = scratch.heights[static_cast<size_t>(tileWidth) + 1];
+    float maxHeight = minHeight;
+
+    for (int lj = 0; lj < rows; ++lj)
+    {
+        const float* rowDown = &scratch.heights[static_cast<size_t>(lj) * tileWidth];
+        const float* rowHere = rowDown + tileWidth;
+        const float* rowUp   = rowHere + tileWidth;
+
+        // Tile columns 1..TERRAIN_CHUNK_SIZE are the chunk's vertices, so
+        // the kernel's clamped border columns are never used
+        float* normalX = scratch.normalX.data();
+        float* normalY = scratch.normalY.data();
+        float* normalZ = scratch.normalZ.data();
+        computeNormalRow(rowDown, rowHere, rowUp, tileWidth, normalX, normalY, normalZ);
+
+        for (int li = 0; li <= chunk.quadsX; ++li)
+        {
+            minHeight = std::min(minHeight, rowHere[li + 1]);
+            maxHeight = std::max(maxHeight, rowHere[li + 1]);
+        }
+
+        size_t rowStart = chunk.baseVertex + static_cast<size_t>(lj) * TERRAIN_CHUNK_SIZE;
+        int j = chunk.originZ + lj;
+
+        if (mesh.format == TerrainVertexFormat::Compact)
+        {
+            CompactTerrainVertex* out = &mesh.compactVertices[rowStart];
+            for (int li = 0; li < TERRAIN_CHUNK_SIZE; ++li)
+            {
+                float normalizedHeight = rowHere[li + 1] / HEIGHT_SCALE;
+                out[li].height = static_cast<uint16_t>(
+                    std::lround(std::max(0.0f, std::min(normalizedHeight, 1.0f)) * 65535.0f));
+                out[li].padding = 0;
+                encodeOctNormal(glm::vec3(normalX[li + 1], normalY[li + 1], normalZ[li + 1]),
+                                out[li].octNormal);
+            }
+            continue;
+        }
+
+        TerrainVertex* out = &mesh.vertices[rowStart];
+        float z = (static_cast<float>(j) / (gridHeight - 1)) * 60.0f - 30.0f;
+        float v = static_cast<float>(j) / (gridHeight - 1);
+
+        for (int li = 0; li < TERRAIN_CHUNK_SIZE; ++li)
+        {
+            int i = std::min(chunk.originX + li, gridWidth - 1);
+            float x = (static_cast<float>(i) / (gridWidth - 1)) * 60.0f - 30.0f;
+            float u = static_cast<float>(i) / (gridWidth - 1);
+
+            out[li].position = glm::vec3(x, rowHere[li + 1], z);
+            out[li].normal = glm::vec3(normalX[li + 1], normalY[li + 1], normalZ[li + 1]);
+            out[li].texCoord = glm::vec2(u, v);
+        }
+    }
+
+    chunk.minHeight = minHeight;
+    chunk.maxHeight = maxHeight;
+    chunk.boundsMin = glm::vec3(
+        (static_cast<float>(chunk.originX) / (gridWidth - 1)) * 60.0f - 30.0f,
+        minHeight,
+        (static_cast<float>(chunk.originZ) / (gridHeight - 1)) * 60.0f - 30.0f);
+    chunk.boundsMax = glm::vec3(
+        (static_cast<float>(chunk.originX + chunk.quadsX) / (gridWidth - 1)) * 60.0f - 30.0f,
+        maxHeight,
+        (static_cast<float>(chunk.originZ + chunk.quadsZ) / (gridHeight - 1)) * 60.0f - 30.0f);
+}
+
+} // namespace
+
+void encodeOctNormal(const glm::vec3& normal, int16_t out[2])
+{
+    float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    float px = normal.x / l1;
+    float pz = normal.z / l1;
+    if (normal.y < 0.0f)
+    {
+        // Fold the lower hemisphere over the diagonals
+        float fx = (1.0f - std::abs(pz)) * (px >= 0.0f ? 1.0f : -1.0f);
+        float fz = (1.0f - std::abs(px)) * (pz >= 0.0f ? 1.0f : -1.0f);
+        px = fx;
+        pz = fz;
+    }
+    out[0] = static_cast<int16_t>(std::lround(std::max(-1.0f, std::min(px, 1.0f)) * 32767.0f));
+    out[1] = static_cast<int16_t>(std::lround(std::max(-1.0f, std::min(pz, 1.0f)) * 32767.0f));
+}
+
+glm::vec3 decodeOctNormal(const int16_t encoded[2])
+{
+    // Mirrors the decode in vertex_compact.glsl
+    float px = encoded[0] / 32767.0f;
+    float pz = encoded[1] / 32767.0f;
+    glm::vec3 n(px, 1.0f - std::abs(px) - std::abs(pz), pz);
+    if (n.y < 0.0f)
+    {
+        n.x = (1.0f - std::abs(pz)) * (px >= 0.0f ? 1.0f : -1.0f);
+        n.z = (1.0f - std::abs(px)) * (pz >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(n);
+}
+
+std::vector<uint16_t> buildTerrainChunkIndices()
+{
+    std::vector<uint16_t> indices(static_cast<size_t>(TERRAIN_CHUNK_QUADS) * TERRAIN_CHUNK_QUADS * 6);
+    uint16_t* out = indices.data();
+    for (int j = 0; j < TERRAIN_CHUNK_QUADS; ++j)
+    {
+        for (int i = 0; i < TERRAIN_CHUNK_QUADS; ++i)
+        {
+            uint16_t topLeft     = static_cast<uint16_t>(j * TERRAIN_CHUNK_SIZE + i);
+            uint16_t topRight    = static_cast<uint16_t>(j * TERRAIN_CHUNK_SIZE + (i + 1));
+            uint16_t bottomLeft  = static_cast<uint16_t>((j + 1) * TERRAIN_CHUNK_SIZE + i);
+            uint16_t bottomRight = static_cast<uint16_t>((j + 1) * TERRAIN_CHUNK_SIZE + (i + 1));
+
+            // First triangle (top-left, bottom-left, top-right)
+            out[0] = topLeft;
+            out[1] = bottomLeft;
+            out[2] = topRight;
+
+            // Second triangle (top-right, bottom-left, bottom-right)
+            out[3] = topRight;
+            out[4] = bottomLeft;
+            out[5] = bottomRight;
+            out += 6;
+        }
+    }
+    return indices;
+}
+
+template <typename Sample>
+TerrainMesh generateTerrainMesh(const Sample* heightmapData,
+                                int imgWidth, int imgHeight, int step,
+                                TerrainVertexFormat format, ThreadPool& pool,
+                                SampleRange range)
+{
+    TerrainMesh mesh;
+
+    mesh.format = format;
+    mesh.gridWidth = imgWidth / step;
+    mesh.gridHeight = imgHeight / step;
+    mesh.chunksX = std::max(1, (mesh.gridWidth - 1 + TERRAIN_CHUNK_QUADS - 1) / TERRAIN_CHUNK_QUADS);
+    mesh.chunksZ = std::max(1, (mesh.gridHeight - 1 + TERRAIN_CHUNK_QUADS - 1) / TERRAIN_CHUNK_QUADS);
+
+    // Lay out the chunks; each one only stores the vertex rows it uses
+    size_t vertexCount = 0;
+    mesh.chunks.resize(static_cast<size_t>(mesh.chunksX) * mesh.chunksZ);
+    for (int cz = 0; cz < mesh.chunksZ; ++cz)
+    {
+        for (int cx = 0; cx < mesh.chunksX; ++cx)
+        {
+            TerrainChunk& chunk = mesh.chunks[cz * mesh.chunksX + cx];
+            chunk.originX = cx * TERRAIN_CHUNK_QUADS;
+            chunk.originZ = cz * TERRAIN_CHUNK_QUADS;
+            chunk.quadsX = std::min(TERRAIN_CHUNK_QUADS, mesh.gridWidth - 1 - chunk.originX);
+            chunk.quadsZ = std::min(TERRAIN_CHUNK_QUADS, mesh.gridHeight - 1 - chunk.originZ);
+            chunk.baseVertex = static_cast<unsigned int>(vertexCount);
+            chunk.indexCount = static_cast<unsigned int>(chunk.quadsZ * TERRAIN_CHUNK_QUADS * 6);
+            vertexCount += static_cast<size_t>(chunk.quadsZ + 1) * TERRAIN_CHUNK_SIZE;
+        }
+    }
+
+    // Sized up front so every chunk can write straight into its own range
+    if (format == TerrainVertexFormat::Compact)
+        mesh.compactVertices.resize(vertexCount);
+    else
+        mesh.vertices.resize(vertexCount);
+    mesh.indices = buildTerrainChunkIndices();
+
+    pool.parallelFor(static_cast<int>(mesh.chunks.size()), [&](int c) {
+        thread_local ChunkScratch scratch;
+        buildMeshChunk(mesh, mesh.chunks[c], heightmapData, imgWidth, step, range, scratch);
+    });
+
+    return mesh;
+}
+
+template TerrainMesh generateTerrainMesh<uint8_t>(const uint8_t*, int, int, int,
+                                                  TerrainVertexFormat, ThreadPool&, SampleRange);
+template TerrainMesh generateTerrainMesh<uint16_t>(const uint16_t*, int, int, int,
+                                                   TerrainVertexFormat, ThreadPool&, SampleRange);
+template TerrainMesh generateTerrainMesh<float>(const float*, int, int, int,
+                                                TerrainVertexFormat, ThreadPool&, SampleRange);
+
+TerrainMesh generateTerrainMesh(const HeightmapView& heightmap, int step,
+                                TerrainVertexFormat format, ThreadPool& pool)
+{
+    switch (heightmap.format)
+    {
+    case HeightmapFormat::U16:
+        return generateTerrainMesh(heightmap.samples<uint16_t>(), heightmap.width, heightmap.height,
+                                   step, format, pool, heightmap.range);
+    case HeightmapFormat::F32:
+        return generateTerrainMesh(heightmap.samples<float>(), heightmap.width, heightmap.height,
+                                   step, format, pool, heightmap.range);
+    default:
+        return generateTerrainMesh(heightmap.samples<uint8_t>(), heightmap.width, heightmap.height,
+                                   step, format, pool, heightmap.range);
+    }
+}
+
+// ============================================================================
+// SERIAL REFERENCE
+// ============================================================================
+
+ReferenceTerrainMesh generateTerrainMeshSerial(const unsigned char* heightmapData,
+                                               int imgWidth, int imgHeight, int step)
+{
+    ReferenceTerrainMesh mesh;
+
+    mesh.gridWidth = imgWidth / step;
+    mesh.gridHeight = imgHeight / step;
+
+    // Reserve space for vertices
+    mesh.vertices.resize(mesh.gridWidth * mesh.gridHeight);
+
+    // Generate vertex positions and UVs
+    for (int j = 0; j < mesh.gridHeight; ++j)
+    {
+        for (int i = 0; i < mesh.gridWidth; ++i)
+        {
+            // Sample heightmap
+            int imgX = i * step;
+            int imgY = j * step;
+            int imgIndex = imgY * imgWidth + imgX;
+            unsigned char heightByte = heightmapData[imgIndex];
+            float normalizedHeight = static_cast<float>(heightByte) / 255.0f;
+
+            // Map grid position to 3D X, Z coordinates
+            // World: -30 to 30 (60x60 world)
+            float x = (static_cast<float>(i) / (mesh.gridWidth - 1)) * 60.0f - 30.0f;
+            float z = (static_cast<float>(j) / (mesh.gridHeight - 1)) * 60.0f - 30.0f;
+            float y = normalizedHeight * HEIGHT_SCALE;
+
+            // Calculate UV coordinates (0 to 1)
+            float u = static_cast<float>(i) / (mesh.gridWidth - 1);
+            float v = static_cast<float>(j) / (mesh.gridHeight - 1);
+
+            // Store vertex data
+            int vertexIndex = j * mesh.gridWidth + i;
+            mesh.vertices[vertexIndex].position = glm::vec3(x, y, z);
+            mesh.vertices[vertexIndex].texCoord = glm::vec2(u, v);
+        }
+    }
+
+    // Compute normals using height differences
+    for (int j = 0; j < mesh.gridHeight; ++j)
+    {
+        for (int i = 0; i < mesh.gridWidth; ++i)
+        {
+            auto getHeight = [&](int gi, int gj) -> float {
+                gi = std::max(0, std::min(gi, mesh.gridWidth - 1));
+                gj = std::max(0, std::min(gj, mesh.gridHeight - 1));
+                return mesh.vertices[gj * mesh.gridWidth + gi].position.y;
+            };
+
+            float hLeft  = getHeight(i - 1, j);
+            float hRight = getHeight(i + 1, j);
+            float hDown  = getHeight(i, j - 1);
+            float hUp    = getHeight(i, j + 1);
+
+            glm::vec3 tangentX = glm::vec3(2.0f, hRight - hLeft, 0.0f);
+            glm::vec3 tangentZ = glm::vec3(0.0f, hUp - hDown, 2.0f);
+            glm::vec3 normal = glm::normalize(glm::cross(tangentZ, tangentX));
+
+            int vertexIndex = j * mesh.gridWidth + i;
+            mesh.vertices[vertexIndex].normal = normal;
+        }
+    }
+
+    // Generate indices for triangle mesh
+    mesh.indices.reserve((mesh.gridWidth - 1) * (mesh.gridHeight - 1) * 6);
+
+    for (int j = 0; j < mesh.gridHeight - 1; ++j)
+    {
+        for (int i = 0; i < mesh.gridWidth - 1; ++i)
+        {
+            unsigned int topLeft     = j * mesh.gridWidth + i;
+            unsigned int topRight    = j * mesh.gridWidth + (i + 1);
+            unsigned int bottomLeft  = (j + 1) * mesh.gridWidth + i;
+            unsigned int bottomRight = (j + 1) * mesh.gridWidth + (i + 1);
+
+            // First triangle (top-left, bottom-left, top-right)
+            mesh.indices.push_back(topLeft);
+            mesh.indices.push_back(bottomLeft);
+            mesh.indices.push_back(topRight);
+
+            // Second triangle (top-right, bottom-left, bottom-right)
+            mesh.indices.push_back(topRight);
+            mesh.indices.push_back(bottomLeft);
+            mesh.indices.push_back(bottomRight);
+        }
+    }
+
+    return mesh;
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "heightmap.h"
+#include "thread_pool.h"
+
+// ============================================================================
+// TERRAIN SETTINGS
+// ============================================================================
+
+const int HEIGHTMAP_STEP = 5;        // Reduced from 8 for more detail
+const float HEIGHT_SCALE = 3.0f;     // Increased for taller peaks
+
+// Largest vertical offset tess_eval.glsl adds on top of the mesh height
+// (fbm detail noise < 1.0 times 0.01). Bounds and culling pad by this.
+const float TERRAIN_DISPLACEMENT_BOUND = 0.01f;
+
+// Vertices per chunk side. 256 x 256 vertices is the most a chunk can hold
+// with 16-bit indices; neighbouring chunks share their border vertices.
+const int TERRAIN_CHUNK_SIZE = 256;
+const int TERRAIN_CHUNK_QUADS = TERRAIN_CHUNK_SIZE - 1;
+
+// ============================================================================
+// TERRAIN MESH
+// ============================================================================
+
+struct TerrainVertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+// 8-byte vertex: X, Z and UV are rebuilt from gl_VertexID and the grid size
+// in vertex_compact.glsl, so only the height and the normal are stored
+struct CompactTerrainVertex
+{
+    uint16_t height;         // 0..65535 maps to 0..HEIGHT_SCALE
+    uint16_t padding;        // Keeps the normal 4-byte aligned
+    int16_t octNormal[2];    // Octahedral normal, -32767..32767 maps to -1..1
+};
+static_assert(sizeof(CompactTerrainVertex) == 8, "CompactTerrainVertex must stay 8 bytes");
+
+enum class TerrainVertexFormat
+{
+    Full,       // TerrainVertex, 32 bytes
+    Compact     // CompactTerrainVertex, 8 bytes
+};
+
+// A chunk covers up to TERRAIN_CHUNK_QUADS x TERRAIN_CHUNK_QUADS quads. Its
+// vertices are stored row by row with a fixed stride of TERRAIN_CHUNK_SIZE,
+// so every chunk can be drawn with the one shared index buffer. Chunks on
+// the right edge pad their rows with copies of the last column; those quads
+// are degenerate.
+struct TerrainChunk
+{
+    int originX;                // Grid coordinate of local vertex (0, 0)
+    int originZ;
+    int quadsX;                 // Real quads in this chunk
+    int quadsZ;
+    unsigned int baseVertex;    // First vertex of the chunk in the VBO
+    unsigned int indexCount;    // Shared indices to draw (quadsZ full quad rows)
+    float minHeight;
+    float maxHeight;
+    glm::vec3 boundsMin;        // World-space AABB
+    glm::vec3 boundsMax;
+};
+
+// Non-owning view of everything the GPU upload and chunk culling need, so a
+// mesh can be drawn straight from a mapped cache file as well as from a
+// TerrainMesh
+struct TerrainMeshBuffers
+{
+    TerrainVertexFormat format = TerrainVertexFormat::Full;
+    const void* vertexData = nullptr;
+    size_t vertexBytes = 0;
+    const uint16_t* indices = nullptr;
+    size_t indexCount = 0;
+    const TerrainChunk* chunks = nullptr;
+    size_t chunkCount = 0;
+    int gridWidth = 0;
+    int gridHeight = 0;
+};
+
+struct TerrainMesh
+{
+    TerrainVertexFormat format = TerrainVertexFormat::Full;
+    std::vector<TerrainVertex> vertices;                // Full format only
+    std::vector<CompactTerrainVertex> compactVertices;  // Compact format only
+    std::vector<uint16_t> indices;                      // Shared by all chunks
+    std::vector<TerrainChunk> chunks;                   // Row-major, chunksX per row
+    int chunksX;
+    int chunksZ;
+    int gridWidth;
+    int gridHeight;
+
+    size_t vertexCount() const {
+        return format == TerrainVertexFormat::Compact ? compactVertices.size() : vertices.size();
+    }
+
+    size_t vertexBytes() const {
+        return format == TerrainVertexFormat::Compact
+            ? compactVertices.size() * sizeof(CompactTerrainVertex)
+            : vertices.size() * sizeof(TerrainVertex);
+    }
+
+    size_t triangleCount() const {
+        size_t triangles = 0;
+        for (const TerrainChunk& chunk : chunks)
+            triangles += static_cast<size_t>(chunk.quadsX) * chunk.quadsZ * 2;
+        return triangles;
+    }
+
+    // VBO index of grid vertex (i, j)
+    size_t vertexIndex(int i, int j) const {
+        int cx = std::min(i / TERRAIN_CHUNK_QUADS, chunksX - 1);
+        int cz = std::min(j / TERRAIN_CHUNK_QUADS, chunksZ - 1);
+        const TerrainChunk& chunk = chunks[cz * chunksX + cx];
+        return chunk.baseVertex +
+               static_cast<size_t>(j - chunk.originZ) * TERRAIN_CHUNK_SIZE + (i - chunk.originX);
+    }
+
+    // World-space height of a vertex in either format
+    float vertexHeight(size_t index) const {
+        if (format == TerrainVertexFormat::Compact)
+            return compactVertices[index].height * (HEIGHT_SCALE / 65535.0f);
+        return vertices[index].position.y;
+    }
+
+    float heightAt(int i, int j) const {
+        return vertexHeight(vertexIndex(i, j));
+    }
+
+    TerrainMeshBuffers buffers() const {
+        TerrainMeshBuffers view;
+        view.format = format;
+        view.vertexData = format == TerrainVertexFormat::Compact
+            ? static_cast<const void*>(compactVertices.data())
+            : static_cast<const void*>(vertices.data());
+        view.vertexBytes = vertexBytes();
+        view.indices = indices.data();
+        view.indexCount = indices.size();
+        view.chunks = chunks.data();
+        view.chunkCount = chunks.size();
+        view.gridWidth = gridWidth;
+        view.gridHeight = gridHeight;
+        return view;
+    }
+};
+
+// Flat single-buffer mesh with 32-bit indices, as produced by the original
+// generator
+struct ReferenceTerrainMesh
+{
+    std::vector<TerrainVertex> vertices;
+    std::vector<unsigned int> indices;
+    int gridWidth;
+    int gridHeight;
+};
+
+// Octahedral encoding around +Y (terrain normals almost always point up)
+void encodeOctNormal(const glm::vec3& normal, int16_t out[2]);
+glm::vec3 decodeOctNormal(const int16_t encoded[2]);
+
+// Index pattern for one full chunk, quad rows in order so that a chunk with
+// fewer quad rows just draws a prefix
+std::vector<uint16_t> buildTerrainChunkIndices();
+
+// Builds the chunked terrain mesh on the given pool, one chunk per work item.
+// Each chunk samples its heights plus a one-vertex halo ring, so positions,
+// normals and bounds all come out of a single cache-blocked pass. The result
+// does not depend on the number of threads. Samples are read in place at
+// their stored width, so a memory-mapped heightmap is never copied, and are
+// only widened to float one tile row at a time (see sample_rows.h).
+// Instantiated for uint8_t, uint16_t and float.
+template <typename Sample>
+TerrainMesh generateTerrainMesh(const Sample* heightmapData,
+                                int imgWidth, int imgHeight, int step,
+                                TerrainVertexFormat format, ThreadPool& pool,
+                                SampleRange range = defaultSampleRange(HeightmapSampleTraits<Sample>::format));
+
+// Dispatches on the view's sample format
+TerrainMesh generateTerrainMesh(const HeightmapView& heightmap, int step,
+                                TerrainVertexFormat format, ThreadPool& pool);
+
+// Original single-threaded three-pass generator, kept as the reference the
+// parallel path is checked against
+ReferenceTerrainMesh generateTerrainMeshSerial(const unsigned char* heightmapData,
+                                               int imgWidth, int imgHeight, int step);
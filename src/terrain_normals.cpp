@@ -0,0 +1,186 @@
+#include "terrain_normals.h"
+
+#include <glm/glm.hpp>
+
+#include "cpu_features.h"
+
+namespace {
+
+inline void writeNormal(float hLeft, float hRight, float hDown, float hUp,
+                        float* outX, float* outY, float* outZ, int i)
+{
+    glm::vec3 tangentX = glm::vec3(2.0f, hRight - hLeft, 0.0f);
+    glm::vec3 tangentZ = glm::vec3(0.0f, hUp - hDown, 2.0f);
+    glm::vec3 normal = glm::normalize(glm::cross(tangentZ, tangentX));
+    outX[i] = normal.x;
+    outY[i] = normal.y;
+    outZ[i] = normal.z;
+}
+
+// First and last column clamp their left/right neighbour; everything in
+// between is handled by the branch-free interior loops below
+inline void normalRowBorders(const float* rowDown, const float* rowHere, const float* rowUp,
+                             int width, float* outX, float* outY, float* outZ)
+{
+    if (width == 1)
+    {
+        writeNormal(rowHere[0], rowHere[0], rowDown[0], rowUp[0], outX, outY, outZ, 0);
+        return;
+    }
+    int last = width - 1;
+    writeNormal(rowHere[0], rowHere[1], rowDown[0], rowUp[0], outX, outY, outZ, 0);
+    writeNormal(rowHere[last - 1], rowHere[last], rowDown[last], rowUp[last],
+                outX, outY, outZ, last);
+}
+
+inline void normalRowInteriorScalar(const float* rowDown, const float* rowHere, const float* rowUp,
+                                    int begin, int end, float* outX, float* outY, float* outZ)
+{
+    for (int i = begin; i < end; ++i)
+        writeNormal(rowHere[i - 1], rowHere[i + 1], rowDown[i], rowUp[i], outX, outY, outZ, i);
+}
+
+void normalRowScalar(const float* rowDown, const float* rowHere, const float* rowUp,
+                     int width, float* outX, float* outY, float* outZ)
+{
+    normalRowBorders(rowDown, rowHere, rowUp, width, outX, outY, outZ);
+    normalRowInteriorScalar(rowDown, rowHere, rowUp, 1, width - 1, outX, outY, outZ);
+}
+
+#if TERRAIN_X86
+
+// The vector kernels spell out glm::cross/glm::normalize term by term
+// (including the multiplications by zero, which decide the sign of zero
+// components) so the results match the scalar path exactly.
+
+TERRAIN_TARGET("sse4.2")
+void normalRowSSE42(const float* rowDown, const float* rowHere, const float* rowUp,
+                    int width, float* outX, float* outY, float* outZ)
+{
+    normalRowBorders(rowDown, rowHere, rowUp, width, outX, outY, outZ);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 crossY = _mm_set1_ps(2.0f * 2.0f - 0.0f * 0.0f);
+    const __m128 crossYSq = _mm_mul_ps(crossY, crossY);
+
+    int i = 1;
+    for (; i + 4 <= width - 1; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(rowHere + i + 1), _mm_loadu_ps(rowHere + i - 1));
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(rowUp + i), _mm_loadu_ps(rowDown + i));
+
+        __m128 cx = _mm_sub_ps(_mm_mul_ps(dz, zero), _mm_mul_ps(dx, two));
+        __m128 cz = _mm_sub_ps(_mm_mul_ps(zero, dx), _mm_mul_ps(two, dz));
+
+        __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), crossYSq),
+                                     _mm_mul_ps(cz, cz));
+        __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+
+        _mm_storeu_ps(outX + i, _mm_mul_ps(cx, invLength));
+        _mm_storeu_ps(outY + i, _mm_mul_ps(crossY, invLength));
+        _mm_storeu_ps(outZ + i, _mm_mul_ps(cz, invLength));
+    }
+    normalRowInteriorScalar(rowDown, rowHere, rowUp, i, width - 1, outX, outY, outZ);
+}
+
+TERRAIN_TARGET("avx2")
+void normalRowAVX2(const float* rowDown, const float* rowHere, const float* rowUp,
+                   int width, float* outX, float* outY, float* outZ)
+{
+    normalRowBorders(rowDown, rowHere, rowUp, width, outX, outY, outZ);
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 crossY = _mm256_set1_ps(2.0f * 2.0f - 0.0f * 0.0f);
+    const __m256 crossYSq = _mm256_mul_ps(crossY, crossY);
+
+    int i = 1;
+    for (; i + 8 <= width - 1; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(rowHere + i + 1), _mm256_loadu_ps(rowHere + i - 1));
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(rowUp + i), _mm256_loadu_ps(rowDown + i));
+
+        // No FMA here on purpose: fused rounding would break bit-exactness
+        __m256 cx = _mm256_sub_ps(_mm256_mul_ps(dz, zero), _mm256_mul_ps(dx, two));
+        __m256 cz = _mm256_sub_ps(_mm256_mul_ps(zero, dx), _mm256_mul_ps(two, dz));
+
+        __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), crossYSq),
+                                        _mm256_mul_ps(cz, cz));
+        __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSq));
+
+        _mm256_storeu_ps(outX + i, _mm256_mul_ps(cx, invLength));
+        _mm256_storeu_ps(outY + i, _mm256_mul_ps(crossY, invLength));
+        _mm256_storeu_ps(outZ + i, _mm256_mul_ps(cz, invLength));
+    }
+    normalRowInteriorScalar(rowDown, rowHere, rowUp, i, width - 1, outX, outY, outZ);
+}
+
+#endif // TERRAIN_X86
+
+using NormalRowFn = void (*)(const float*, const float*, const float*, int,
+                             float*, float*, float*);
+
+NormalRowFn kernelFunction(NormalKernel kernel)
+{
+    switch (kernel)
+    {
+#if TERRAIN_X86
+    case NormalKernel::AVX2:  return normalRowAVX2;
+    case NormalKernel::SSE42: return normalRowSSE42;
+#endif
+    default:                  return normalRowScalar;
+    }
+}
+
+NormalKernel detectNormalKernel()
+{
+    if (cpuHasAVX2())  return NormalKernel::AVX2;
+    if (cpuHasSSE42()) return NormalKernel::SSE42;
+    return NormalKernel::Scalar;
+}
+
+const NormalKernel g_activeKernel = detectNormalKernel();
+const NormalRowFn g_activeRowFn = kernelFunction(g_activeKernel);
+
+} // namespace
+
+NormalKernel activeNormalKernel()
+{
+    return g_activeKernel;
+}
+
+bool normalKernelSupported(NormalKernel kernel)
+{
+    switch (kernel)
+    {
+    case NormalKernel::AVX2:  return cpuHasAVX2();
+    case NormalKernel::SSE42: return cpuHasSSE42();
+    default:                  return true;
+    }
+}
+
+const char* normalKernelName(NormalKernel kernel)
+{
+    switch (kernel)
+    {
+    case NormalKernel::AVX2:  return "AVX2";
+    case NormalKernel::SSE42: return "SSE4.2";
+    default:                  return "scalar";
+    }
+}
+
+void computeNormalRow(const float* rowDown, const float* rowHere, const float* rowUp,
+                      int width, float* outX, float* outY, float* outZ)
+{
+    g_activeRowFn(rowDown, rowHere, rowUp, width, outX, outY, outZ);
+}
+
+void computeNormalRowWith(NormalKernel kernel,
+                          const float* rowDown, const float* rowHere, const float* rowUp,
+                          int width, float* outX, float* outY, float* outZ)
+{
+    kernelFunction(kernel)(rowDown, rowHere, rowUp, width, outX, outY, outZ);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// Central-difference normal kernels over a contiguous height array.
+//
+// For grid vertex i of a row the normal is
+//     normalize(cross((0, up - down, 2), (2, right - left, 0)))
+// with the same clamping at the borders as the original getHeight lambda.
+// The SIMD kernels use exact sqrt/div, so all three produce the same bits.
+
+enum class NormalKernel
+{
+    Scalar,
+    SSE42,
+    AVX2
+};
+
+// Kernel picked at startup for this CPU
+NormalKernel activeNormalKernel();
+bool normalKernelSupported(NormalKernel kernel);
+const char* normalKernelName(NormalKernel kernel);
+
+// Writes the normals of one grid row as three SoA arrays. rowDown/rowUp are
+// the neighbouring rows (pass rowHere again at the top/bottom edge).
+void computeNormalRow(const float* rowDown, const float* rowHere, const float* rowUp,
+                      int width, float* outX, float* outY, float* outZ);
+
+// Same as above with an explicit kernel, for benchmarks and accuracy checks
+void computeNormalRowWith(NormalKernel kernel,
+                          const float* rowDown, const float* rowHere, const float* rowUp,
+                          int width, float* outX, float* outY, float* outZ);
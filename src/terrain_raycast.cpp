@@ -0,0 +1,347 @@
+#include "terrain_raycast.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+int ceilDiv(int value, int divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+// Deep enough for any pyramid: each level leaves at most three siblings on
+// the stack besides the node being expanded
+const int MAX_TRAVERSAL_STACK = 4 * 32;
+
+// Parametric range of the ray inside an axis-aligned box, clipped to
+// [tMin, tMax]. invDirection components are never infinite, so rays parallel
+// to a slab need no special case.
+bool rayBoxRange(const glm::vec3& origin, const glm::vec3& invDirection,
+                 const glm::vec3& boxMin, const glm::vec3& boxMax, float tMin, float tMax,
+                 float& tEnter, float& tExit)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float t0 = (boxMin[axis] - origin[axis]) * invDirection[axis];
+        float t1 = (boxMax[axis] - origin[axis]) * invDirection[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMin > tMax)
+            return false;
+    }
+    tEnter = tMin;
+    tExit = tMax;
+    return true;
+}
+
+// Möller–Trumbore, two-sided. Edges are widened a little so rays through a
+// shared edge or corner cannot slip between neighbouring triangles.
+bool rayTriangle(const glm::vec3& origin, const glm::vec3& direction,
+                 const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t)
+{
+    const float edgeTolerance = 1.0e-5f;
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::abs(determinant) < 1.0e-12f)
+        return false;
+    float invDeterminant = 1.0f / determinant;
+    glm::vec3 s = origin - v0;
+    float u = glm::dot(s, p) * invDeterminant;
+    if (u < -edgeTolerance || u > 1.0f + edgeTolerance)
+        return false;
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q) * invDeterminant;
+    if (v < -edgeTolerance || u + v > 1.0f + edgeTolerance)
+        return false;
+    t = glm::dot(edge2, q) * invDeterminant;
+    return t >= 0.0f;
+}
+
+} // namespace
+
+TerrainRaycaster::TerrainRaycaster(const CollisionGrid& grid)
+    : grid_(grid),
+      cellsX_(grid.width() - 1),
+      cellsZ_(grid.height() - 1),
+      cellSizeX_(grid.width() > 1 ? 60.0f / (grid.width() - 1) : 0.0f),
+      cellSizeZ_(grid.height() > 1 ? 60.0f / (grid.height() - 1) : 0.0f)
+{
+    if (grid.isValid())
+        buildPyramid();
+}
+
+// ============================================================================
+// PYRAMID
+// ============================================================================
+
+void TerrainRaycaster::buildPyramid()
+{
+    int nodeCells = RAYCAST_LEAF_CELLS;
+    while (true)
+    {
+        Level level;
+        level.nodeCells = nodeCells;
+        level.nodesX = ceilDiv(cellsX_, nodeCells);
+        level.nodesZ = ceilDiv(cellsZ_, nodeCells);
+        level.minMax.resize(static_cast<size_t>(level.nodesX) * level.nodesZ * 2);
+        levels_.push_back(std::move(level));
+        if (nodeCells >= cellsX_ && nodeCells >= cellsZ_)
+            break;
+        nodeCells *= 2;
+    }
+
+    // Leaves take every sample of their cells, far edges included, since
+    // those are corners of the last row of triangles
+    Level& leaves = levels_[0];
+    for (int nz = 0; nz < leaves.nodesZ; ++nz)
+    {
+        const int z0 = nz * RAYCAST_LEAF_CELLS;
+        const int z1 = std::min(z0 + RAYCAST_LEAF_CELLS, cellsZ_);
+        for (int nx = 0; nx < leaves.nodesX; ++nx)
+        {
+            const int x0 = nx * RAYCAST_LEAF_CELLS;
+            const int x1 = std::min(x0 + RAYCAST_LEAF_CELLS, cellsX_);
+            uint16_t lo = 65535;
+            uint16_t hi = 0;
+            for (int z = z0; z <= z1; ++z)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    uint16_t sample = grid_.samples()[grid_.sampleIndex(x, z)];
+                    lo = std::min(lo, sample);
+                    hi = std::max(hi, sample);
+                }
+            }
+            uint16_t* node = &leaves.minMax[(static_cast<size_t>(nz) * leaves.nodesX + nx) * 2];
+            node[0] = lo;
+            node[1] = hi;
+        }
+    }
+
+    // Parents combine their (up to four) children
+    for (size_t l = 1; l < levels_.size(); ++l)
+    {
+        const Level& child = levels_[l - 1];
+        Level& parent = levels_[l];
+        for (int nz = 0; nz < parent.nodesZ; ++nz)
+        {
+            for (int nx = 0; nx < parent.nodesX; ++nx)
+            {
+                uint16_t lo = 65535;
+                uint16_t hi = 0;
+                for (int q = 0; q < 4; ++q)
+                {
+                    int cx = nx * 2 + (q & 1);
+                    int cz = nz * 2 + (q >> 1);
+                    if (cx >= child.nodesX || cz >= child.nodesZ)
+                        continue;
+                    const uint16_t* c = &child.minMax[(static_cast<size_t>(cz) * child.nodesX + cx) * 2];
+                    lo = std::min(lo, c[0]);
+                    hi = std::max(hi, c[1]);
+                }
+                uint16_t* p = &parent.minMax[(static_cast<size_t>(nz) * parent.nodesX + nx) * 2];
+                p[0] = lo;
+                p[1] = hi;
+            }
+        }
+    }
+}
+
+size_t TerrainRaycaster::bytes() const
+{
+    size_t bytes = 0;
+    for (const Level& level : levels_)
+        bytes += level.minMax.size() * sizeof(uint16_t);
+    return bytes;
+}
+
+glm::vec3 TerrainRaycaster::vertex(int x, int z) const
+{
+    return glm::vec3(x * cellSizeX_ - 30.0f, grid_.sampleHeight(x, z), z * cellSizeZ_ - 30.0f);
+}
+
+// ============================================================================
+// TRAVERSAL
+// ============================================================================
+
+bool TerrainRaycaster::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                               TerrainRayHit& hit) const
+{
+    if (levels_.empty() || direction == glm::vec3(0.0f))
+        return false;
+
+    // A zero component becomes a huge reciprocal instead of infinity, which
+    // keeps the slab test free of 0 * inf
+    glm::vec3 invDirection;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float d = std::abs(direction[axis]) > 1.0e-20f ? direction[axis] : 1.0e-20f;
+        invDirection[axis] = 1.0f / d;
+    }
+
+    struct Node
+    {
+        int level;
+        int x;
+        int z;
+        float tEnter;
+        float tExit;
+    };
+
+    // Box of a node in world space; its cell range includes the far edge
+    auto nodeRange = [&](int level, int x, int z, float tMax, Node& node) {
+        const Level& l = levels_[level];
+        const uint16_t* minMax = &l.minMax[(static_cast<size_t>(z) * l.nodesX + x) * 2];
+        int x0 = x * l.nodeCells;
+        int z0 = z * l.nodeCells;
+        int x1 = std::min(x0 + l.nodeCells, cellsX_);
+        int z1 = std::min(z0 + l.nodeCells, cellsZ_);
+        glm::vec3 boxMin(x0 * cellSizeX_ - 30.0f, minMax[0] * grid_.scale() + grid_.offset(),
+                         z0 * cellSizeZ_ - 30.0f);
+        glm::vec3 boxMax(x1 * cellSizeX_ - 30.0f, minMax[1] * grid_.scale() + grid_.offset(),
+                         z1 * cellSizeZ_ - 30.0f);
+        node.level = level;
+        node.x = x;
+        node.z = z;
+        return rayBoxRange(origin, invDirection, boxMin, boxMax, 0.0f, tMax, node.tEnter, node.tExit);
+    };
+
+    float bestT = maxDistance;
+    bool found = false;
+
+    Node stack[MAX_TRAVERSAL_STACK];
+    int stackSize = 0;
+    const int top = levelCount() - 1;
+    for (int z = 0; z < levels_[top].nodesZ; ++z)
+        for (int x = 0; x < levels_[top].nodesX; ++x)
+            if (nodeRange(top, x, z, bestT, stack[stackSize]))
+                ++stackSize;
+
+    while (stackSize > 0)
+    {
+        Node node = stack[--stackSize];
+        if (node.tEnter >= bestT)
+            continue;   // A closer hit was found since this node was pushed
+
+        if (node.level == 0)
+        {
+            if (raycastLeaf(node.x, node.z, origin, direction, node.tEnter,
+                            std::min(node.tExit, bestT), bestT, hit))
+                found = true;
+            continue;
+        }
+
+        // Children the ray passes through, nearest pushed last so it is
+        // expanded first
+        const Level& child = levels_[node.level - 1];
+        Node children[4];
+        int childCount = 0;
+        for (int q = 0; q < 4; ++q)
+        {
+            int cx = node.x * 2 + (q & 1);
+            int cz = node.z * 2 + (q >> 1);
+            if (cx >= child.nodesX || cz >= child.nodesZ)
+                continue;
+            Node candidate;
+            if (!nodeRange(node.level - 1, cx, cz, bestT, candidate))
+                continue;
+            int slot = childCount++;
+            while (slot > 0 && children[slot - 1].tEnter < candidate.tEnter)
+            {
+                children[slot] = children[slot - 1];
+                --slot;
+            }
+            children[slot] = candidate;
+        }
+        for (int c = 0; c < childCount; ++c)
+            stack[stackSize++] = children[c];
+    }
+    return found;
+}
+
+// Walks the leaf's cells along the ray from where it enters the leaf. Cells
+// are visited in ray order, so the first one hit holds the nearest hit.
+bool TerrainRaycaster::raycastLeaf(int x, int z, const glm::vec3& origin, const glm::vec3& direction,
+                                   float tEnter, float tExit, float& bestT, TerrainRayHit& hit) const
+{
+    const int x0 = x * RAYCAST_LEAF_CELLS;
+    const int z0 = z * RAYCAST_LEAF_CELLS;
+    const int x1 = std::min(x0 + RAYCAST_LEAF_CELLS, cellsX_);
+    const int z1 = std::min(z0 + RAYCAST_LEAF_CELLS, cellsZ_);
+
+    glm::vec3 entry = origin + direction * tEnter;
+    int cx = std::max(x0, std::min(static_cast<int>(std::floor((entry.x + 30.0f) / cellSizeX_)), x1 - 1));
+    int cz = std::max(z0, std::min(static_cast<int>(std::floor((entry.z + 30.0f) / cellSizeZ_)), z1 - 1));
+
+    const float never = std::numeric_limits<float>::max();
+    int stepX = direction.x > 0.0f ? 1 : (direction.x < 0.0f ? -1 : 0);
+    int stepZ = direction.z > 0.0f ? 1 : (direction.z < 0.0f ? -1 : 0);
+    float tNextX = stepX != 0
+        ? ((cx + (stepX > 0 ? 1 : 0)) * cellSizeX_ - 30.0f - origin.x) / direction.x : never;
+    float tNextZ = stepZ != 0
+        ? ((cz + (stepZ > 0 ? 1 : 0)) * cellSizeZ_ - 30.0f - origin.z) / direction.z : never;
+    const float tDeltaX = stepX != 0 ? cellSizeX_ / std::abs(direction.x) : never;
+    const float tDeltaZ = stepZ != 0 ? cellSizeZ_ / std::abs(direction.z) : never;
+
+    while (true)
+    {
+        if (intersectCell(cx, cz, origin, direction, bestT, hit))
+            return true;
+        if (std::min(tNextX, tNextZ) > tExit)
+            return false;
+        if (tNextX < tNextZ)
+        {
+            cx += stepX;
+            tNextX += tDeltaX;
+            if (cx < x0 || cx >= x1)
+                return false;
+        }
+        else
+        {
+            cz += stepZ;
+            tNextZ += tDeltaZ;
+            if (cz < z0 || cz >= z1)
+                return false;
+        }
+    }
+}
+
+// The cell's two triangles as the mesh splits them: (topLeft, bottomLeft,
+// topRight) and (topRight, bottomLeft, bottomRight)
+bool TerrainRaycaster::intersectCell(int x, int z, const glm::vec3& origin, const glm::vec3& direction,
+                                     float& bestT, TerrainRayHit& hit) const
+{
+    const glm::vec3 topLeft = vertex(x, z);
+    const glm::vec3 bottomLeft = vertex(x, z + 1);
+    const glm::vec3 topRight = vertex(x + 1, z);
+    const glm::vec3 bottomRight = vertex(x + 1, z + 1);
+
+    bool found = false;
+    float t;
+    if (rayTriangle(origin, direction, topLeft, bottomLeft, topRight, t) && t < bestT)
+    {
+        bestT = t;
+        hit.normal = glm::normalize(glm::cross(bottomLeft - topLeft, topRight - topLeft));
+        found = true;
+    }
+    if (rayTriangle(origin, direction, topRight, bottomLeft, bottomRight, t) && t < bestT)
+    {
+        bestT = t;
+        hit.normal = glm::normalize(glm::cross(bottomLeft - topRight, bottomRight - topRight));
+        found = true;
+    }
+    if (found)
+    {
+        hit.distance = bestT;
+        hit.position = origin + direction * bestT;
+        hit.cellX = x;
+        hit.cellZ = z;
+    }
+    return found;
+}
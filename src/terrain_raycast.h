@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "collision_grid.h"
+
+// ============================================================================
+// RAYCAST SETTINGS
+// ============================================================================
+
+// Grid cells per side of a pyramid leaf. Rays walk the cells of a leaf they
+// reach one by one, so smaller leaves prune more but cost more memory.
+const int RAYCAST_LEAF_CELLS = 4;
+
+// ============================================================================
+// TERRAIN RAYCASTS
+// ============================================================================
+
+struct TerrainRayHit
+{
+    float distance = 0.0f;      // Along the ray, in units of its direction
+    glm::vec3 position{0.0f};
+    glm::vec3 normal{0.0f, 1.0f, 0.0f};   // Of the triangle hit, facing up
+    int cellX = 0;              // Grid cell the hit lies in
+    int cellZ = 0;
+};
+
+// Ray intersection against the collision grid, triangulated the same way as
+// the terrain mesh. A min/max height pyramid over the grid lets a ray skip
+// every region it passes above or below, so only the cells near the hit are
+// tested triangle by triangle. The pyramid stores 16-bit grid samples, about
+// a sixth of the grid's own size. Built once, then safe to query from any
+// number of threads.
+class TerrainRaycaster
+{
+public:
+    // Keeps a reference to the grid, which must outlive the raycaster
+    explicit TerrainRaycaster(const CollisionGrid& grid);
+
+    bool isValid() const { return !levels_.empty(); }
+    int levelCount() const { return static_cast<int>(levels_.size()); }
+    size_t bytes() const;
+
+    // Nearest hit within maxDistance along origin + t * direction. The
+    // direction need not be normalized; distances are in its units.
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                 TerrainRayHit& hit) const;
+
+private:
+    struct Level
+    {
+        int nodeCells;                  // Grid cells per node side
+        int nodesX;
+        int nodesZ;
+        std::vector<uint16_t> minMax;   // Interleaved min, max grid sample per node
+    };
+
+    void buildPyramid();
+    bool raycastLeaf(int x, int z, const glm::vec3& origin, const glm::vec3& direction,
+                     float tEnter, float tExit, float& bestT, TerrainRayHit& hit) const;
+    bool intersectCell(int x, int z, const glm::vec3& origin, const glm::vec3& direction,
+                       float& bestT, TerrainRayHit& hit) const;
+    glm::vec3 vertex(int x, int z) const;
+
+    const CollisionGrid& grid_;
+    int cellsX_;
+    int cellsZ_;
+    float cellSizeX_;       // World size of one grid cell
+    float cellSizeZ_;
+    std::vector<Level> levels_;   // Leaves first, a single root last
+};
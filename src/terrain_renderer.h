@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <glm/glm.hpp>
+
+#include "frustum_culling.h"
+
+// ============================================================================
+// TERRAIN BACKENDS
+// ============================================================================
+
+enum class TerrainBackend
+{
+    Mesh,       // Baked chunked mesh + tessellation (generateTerrainMesh)
+    CDLOD,      // Quadtree of grid patches displaced from a height texture
+    Clipmap,    // Nested camera-centred grids over toroidal height textures
+    Displaced   // Mesh backend's grid + tessellation, heights from a texture
+};
+
+// Per-frame inputs shared by all terrain backends
+struct TerrainFrame
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 cameraPos;
+    Frustum frustum;                // From projection * view
+    int viewportWidth;
+    int viewportHeight;
+    bool patchCulling;              // Tessellation backends only
+    bool screenSpaceTessellation;   // Tessellation backends only
+    float targetPixelsPerEdge;      // Screen-space tessellation target
+};
+
+class TerrainRenderer
+{
+public:
+    virtual ~TerrainRenderer() = default;
+
+    // False if GPU resources or shaders failed to load
+    virtual bool isValid() const = 0;
+
+    virtual void render(const TerrainFrame& frame) = 0;
+
+    // Short per-frame counters for the window title
+    virtual std::string stats() const = 0;
+};
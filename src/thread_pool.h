@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads.
+// A pool of size 1 runs everything inline on the calling thread, which is
+// the serial path used for comparisons.
+class ThreadPool {
+public:
+    // threadCount = 0 picks std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        threadCount_ = threadCount;
+
+        // The calling thread takes part in parallelFor, so spawn one fewer
+        for (unsigned int t = 1; t < threadCount_; ++t)
+            workers_.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeWorkers_.notify_all();
+        for (std::thread& worker : workers_)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int size() const {
+        return threadCount_;
+    }
+
+    // Runs body(i) for every i in [0, count) and returns when all are done.
+    // Items are handed out dynamically, so uneven items balance themselves.
+    void parallelFor(int count, const std::function<void(int)>& body)
+    {
+        if (count <= 0)
+            return;
+
+        if (workers_.empty() || count == 1)
+        {
+            for (int i = 0; i < count; ++i)
+                body(i);
+            return;
+        }
+
+        // Shared so that helpers which only get scheduled after the work is
+        // finished can still safely look at the counters and bail out
+        struct ForState {
+            std::atomic<int> nextItem{0};
+            std::atomic<int> completedItems{0};
+            std::mutex doneMutex;
+            std::condition_variable doneCondition;
+        };
+        auto state = std::make_shared<ForState>();
+        const std::function<void(int)>* bodyPtr = &body;
+
+        auto runner = [state, bodyPtr, count]() {
+            int finished = 0;
+            for (int i = state->nextItem.fetch_add(1); i < count; i = state->nextItem.fetch_add(1))
+            {
+                (*bodyPtr)(i);
+                ++finished;
+            }
+            if (finished > 0 && state->completedItems.fetch_add(finished) + finished == count)
+            {
+                std::lock_guard<std::mutex> lock(state->doneMutex);
+                state->doneCondition.notify_one();
+            }
+        };
+
+        int helperCount = std::min<int>(static_cast<int>(workers_.size()), count - 1);
+        for (int t = 0; t < helperCount; ++t)
+            submit(runner);
+
+        runner();
+
+        std::unique_lock<std::mutex> lock(state->doneMutex);
+        state->doneCondition.wait(lock, [&] { return state->completedItems.load() == count; });
+    }
+
+    // Queues a task to run on a worker thread (inline for a size-1 pool)
+    void submit(std::function<void()> task)
+    {
+        if (workers_.empty())
+        {
+            task();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push(std::move(task));
+        }
+        wakeWorkers_.notify_one();
+    }
+
+private:
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeWorkers_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (stopping_ && tasks_.empty())
+                    return;
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+            task();
+        }
+    }
+
+    unsigned int threadCount_ = 1;
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wakeWorkers_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,385 @@
+#include "tile_streamer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "terrain_mesh.h"
+
+TileStreamer::TileStreamer(size_t memoryBudget)
+    : budget_(memoryBudget)
+{
+}
+
+TileStreamer::~TileStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    if (ioThread_.joinable())
+        ioThread_.join();
+}
+
+bool TileStreamer::open(const char* path)
+{
+    if (!tiles_.open(path))
+    {
+        error_ = tiles_.error();
+        return false;
+    }
+
+    // The coarsest level is what every missing tile falls back to
+    const int top = levelCount() - 1;
+    for (int tz = 0; tz < tiles_.levelTilesZ(top); ++tz)
+    {
+        for (int tx = 0; tx < tiles_.levelTilesX(top); ++tx)
+        {
+            std::unique_ptr<Tile> tile = decode(packKey(top, tx, tz));
+            if (!tile->ok)
+            {
+                error_ = "corrupt tile data";
+                return false;
+            }
+            insert(std::move(tile), true);
+        }
+    }
+
+    ioThread_ = std::thread([this] { ioLoop(); });
+    return true;
+}
+
+// ============================================================================
+// TILE CACHE
+// ============================================================================
+
+uint64_t TileStreamer::packKey(int level, int tx, int tz)
+{
+    return (static_cast<uint64_t>(level) << 56) | (static_cast<uint64_t>(tz) << 28) |
+           static_cast<uint64_t>(tx);
+}
+
+TileStreamer::TileKey TileStreamer::unpackKey(uint64_t key)
+{
+    const uint64_t mask = (uint64_t(1) << 28) - 1;
+    return { static_cast<int>(key >> 56), static_cast<int>(key & mask),
+             static_cast<int>((key >> 28) & mask) };
+}
+
+// Runs on the I/O thread (and in open)
+std::unique_ptr<TileStreamer::Tile> TileStreamer::decode(uint64_t key) const
+{
+    TileKey location = unpackKey(key);
+    const int size = tiles_.tileSize();
+    auto tile = std::make_unique<Tile>();
+    tile->key = key;
+    tile->width = std::min(size, tiles_.levelWidth(location.level) - location.tx * size);
+    tile->height = std::min(size, tiles_.levelHeight(location.level) - location.tz * size);
+    tile->samples.resize(static_cast<size_t>(tile->width) * tile->height *
+                         heightmapSampleBytes(tiles_.format()));
+    tile->ok = tiles_.decodeTile(location.level, location.tx, location.tz, tile->samples.data(),
+                                 static_cast<size_t>(tile->width));
+    return tile;
+}
+
+void TileStreamer::insert(std::unique_ptr<Tile> tile, bool pinned)
+{
+    uint64_t key = tile->key;
+    residentBytes_ += tile->samples.size();
+    std::lock_guard<std::mutex> lock(entriesMutex_);
+    Entry& entry = entries_[key];
+    entry.tile = std::move(tile);
+    entry.lastUsedFrame = frame_;
+    entry.pinned = pinned;
+    if (!pinned)
+    {
+        lru_.push_front(key);
+        entry.lruPosition = lru_.begin();
+    }
+}
+
+const TileStreamer::Tile* TileStreamer::acquire(int level, int tx, int tz)
+{
+    uint64_t key = packKey(level, tx, tz);
+    auto found = entries_.find(key);
+    if (found == entries_.end())
+    {
+        if (!inFlight_.count(key) && !failed_.count(key))
+            wanted_.insert(key);
+        return nullptr;
+    }
+
+    Entry& entry = found->second;
+    entry.lastUsedFrame = frame_;
+    if (!entry.pinned)
+        lru_.splice(lru_.begin(), lru_, entry.lruPosition);
+    return entry.tile.get();
+}
+
+const TileStreamer::Tile* TileStreamer::find(int level, int tx, int tz) const
+{
+    auto found = entries_.find(packKey(level, tx, tz));
+    return found == entries_.end() ? nullptr : found->second.tile.get();
+}
+
+// ============================================================================
+// FRAME
+// ============================================================================
+
+void TileStreamer::beginFrame(float cameraTexelX, float cameraTexelZ)
+{
+    ++frame_;
+    cameraTexelX_ = cameraTexelX;
+    cameraTexelZ_ = cameraTexelZ;
+    arrived_.clear();
+    wanted_.clear();
+
+    std::unique_ptr<Tile> tile;
+    while (completed_.pop(tile))
+    {
+        uint64_t key = tile->key;
+        inFlight_.erase(key);
+        if (!tile->ok)
+        {
+            failed_.insert(key);
+            continue;
+        }
+        insert(std::move(tile), false);
+        arrived_.push_back(unpackKey(key));
+        ++tilesLoaded_;
+    }
+}
+
+void TileStreamer::endFrame()
+{
+    // Coarse levels first (they cover the most screen and back every finer
+    // fallback), then nearest to the camera
+    std::vector<uint64_t> wanted(wanted_.begin(), wanted_.end());
+    auto distance = [this](uint64_t key) {
+        TileKey location = unpackKey(key);
+        float span = static_cast<float>(tiles_.tileSize() << location.level);
+        float dx = (location.tx + 0.5f) * span - cameraTexelX_;
+        float dz = (location.tz + 0.5f) * span - cameraTexelZ_;
+        return dx * dx + dz * dz;
+    };
+    std::sort(wanted.begin(), wanted.end(), [&](uint64_t a, uint64_t b) {
+        int levelA = static_cast<int>(a >> 56), levelB = static_cast<int>(b >> 56);
+        if (levelA != levelB)
+            return levelA > levelB;
+        return distance(a) < distance(b);
+    });
+
+    bool sent = false;
+    for (uint64_t key : wanted)
+    {
+        if (inFlight_.size() >= static_cast<size_t>(TILE_STREAM_MAX_IN_FLIGHT) || !requests_.push(key))
+            break;
+        inFlight_.insert(key);
+        wanted_.erase(key);
+        sent = true;
+    }
+    if (sent)
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            signalled_ = true;
+        }
+        wake_.notify_one();
+    }
+
+    // Least recently used first, never a tile this frame needed
+    std::lock_guard<std::mutex> lock(entriesMutex_);
+    while (residentBytes_ > budget_ && !lru_.empty())
+    {
+        auto oldest = entries_.find(lru_.back());
+        if (oldest->second.lastUsedFrame == frame_)
+            break;
+        residentBytes_ -= oldest->second.tile->samples.size();
+        entries_.erase(oldest);
+        lru_.pop_back();
+        ++tilesEvicted_;
+    }
+}
+
+void TileStreamer::ioLoop()
+{
+    for (;;)
+    {
+        uint64_t key;
+        while (requests_.pop(key))
+        {
+            // Never full: at most TILE_STREAM_MAX_IN_FLIGHT tiles are outstanding
+            completed_.push(decode(key));
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wake_.wait(lock, [this] { return signalled_ || stopping_; });
+        if (stopping_)
+            return;
+        signalled_ = false;
+    }
+}
+
+// ============================================================================
+// SAMPLING
+// ============================================================================
+
+template <typename Sample>
+Sample TileStreamer::fallbackSample(int level, int x, int z, std::vector<TileLookup>& lookups) const
+{
+    const int size = tiles_.tileSize();
+    for (int l = level + 1; l < levelCount(); ++l)
+    {
+        x = std::min(x >> 1, tiles_.levelWidth(l) - 1);
+        z = std::min(z >> 1, tiles_.levelHeight(l) - 1);
+        uint64_t key = packKey(l, x / size, z / size);
+        if (lookups[l].key != key)
+            lookups[l] = { key, find(l, x / size, z / size) };
+        const Tile* tile = lookups[l].tile;
+        if (tile)
+            return reinterpret_cast<const Sample*>(tile->samples.data())
+                [static_cast<size_t>(z % size) * tile->width + (x % size)];
+    }
+    return 0;
+}
+
+template <typename Sample>
+void TileStreamer::gatherTexels(int level, int x0, int z0, int columns, int rows, Sample* out)
+{
+    const int size = tiles_.tileSize();
+    const int top = levelCount() - 1;
+
+    // Past the pyramid: every 2^(level - top)-th texel of the pinned top
+    if (level > top)
+    {
+        const int shift = level - top;
+        const int64_t lastX = tiles_.levelWidth(top) - 1;
+        const int64_t lastZ = tiles_.levelHeight(top) - 1;
+        for (int r = 0; r < rows; ++r)
+        {
+            int sz = static_cast<int>(std::min(static_cast<int64_t>(std::max(0, z0 + r)) << shift, lastZ));
+            for (int c = 0; c < columns; ++c)
+            {
+                int sx = static_cast<int>(std::min(static_cast<int64_t>(std::max(0, x0 + c)) << shift, lastX));
+                const Tile* tile = find(top, sx / size, sz / size);
+                *out++ = reinterpret_cast<const Sample*>(tile->samples.data())
+                    [static_cast<size_t>(sz % size) * tile->width + (sx % size)];
+            }
+        }
+        return;
+    }
+
+    const int width = tiles_.levelWidth(level);
+    const int height = tiles_.levelHeight(level);
+    lookups_.assign(levelCount(), TileLookup());
+    for (int r = 0; r < rows; ++r)
+    {
+        const int sz = std::max(0, std::min(z0 + r, height - 1));
+        const int tz = sz / size;
+        for (int c = 0; c < columns; )
+        {
+            // Runs of texels inside one tile, or clamped to the same edge texel
+            const int x = x0 + c;
+            const int sx = std::max(0, std::min(x, width - 1));
+            const int tx = sx / size;
+            int run;
+            if (x < 0)
+                run = std::min(columns - c, -x);
+            else if (x >= width)
+                run = columns - c;
+            else
+                run = std::min(columns - c, std::min((tx + 1) * size, width) - x);
+
+            Sample* dst = out + static_cast<size_t>(r) * columns + c;
+            const Tile* tile = acquire(level, tx, tz);
+            if (tile)
+            {
+                const Sample* src = reinterpret_cast<const Sample*>(tile->samples.data()) +
+                                    static_cast<size_t>(sz - tz * size) * tile->width + (sx - tx * size);
+                if (x < 0 || x >= width)
+                    std::fill(dst, dst + run, *src);
+                else
+                    std::memcpy(dst, src, run * sizeof(Sample));
+            }
+            else
+            {
+                for (int k = 0; k < run; ++k)
+                    dst[k] = fallbackSample<Sample>(level, std::max(0, std::min(x + k, width - 1)), sz, lookups_);
+            }
+            c += run;
+        }
+    }
+}
+
+void TileStreamer::gather(int level, int x0, int z0, int columns, int rows, void* out)
+{
+    if (format() == HeightmapFormat::U16)
+        gatherTexels(level, x0, z0, columns, rows, static_cast<uint16_t*>(out));
+    else
+        gatherTexels(level, x0, z0, columns, rows, static_cast<uint8_t*>(out));
+}
+
+void TileStreamer::require(int level, int x0, int z0, int columns, int rows)
+{
+    if (level >= levelCount())
+        return;
+    const int size = tiles_.tileSize();
+    const int width = tiles_.levelWidth(level);
+    const int height = tiles_.levelHeight(level);
+    const int tx0 = std::max(0, std::min(x0, width - 1)) / size;
+    const int tx1 = std::max(0, std::min(x0 + columns - 1, width - 1)) / size;
+    const int tz0 = std::max(0, std::min(z0, height - 1)) / size;
+    const int tz1 = std::max(0, std::min(z0 + rows - 1, height - 1)) / size;
+    for (int tz = tz0; tz <= tz1; ++tz)
+        for (int tx = tx0; tx <= tx1; ++tx)
+            acquire(level, tx, tz);
+}
+
+bool TileStreamer::residentSample(int level, int x, int z, float& sample) const
+{
+    const int size = tiles_.tileSize();
+    x = std::min(x, tiles_.levelWidth(level) - 1);
+    z = std::min(z, tiles_.levelHeight(level) - 1);
+    const Tile* tile = find(level, x / size, z / size);
+    if (!tile)
+        return false;
+    size_t index = static_cast<size_t>(z % size) * tile->width + (x % size);
+    if (format() == HeightmapFormat::U16)
+        sample = reinterpret_cast<const uint16_t*>(tile->samples.data())[index];
+    else
+        sample = tile->samples[index];
+    return true;
+}
+
+float TileStreamer::heightAt(float worldX, float worldZ) const
+{
+    if (levelCount() == 0)
+        return 0.0f;
+
+    float texelX = (worldX + 30.0f) / 60.0f * (width() - 1);
+    float texelZ = (worldZ + 30.0f) / 60.0f * (height() - 1);
+    if (texelX < 0 || texelX >= width() - 1 || texelZ < 0 || texelZ >= height() - 1)
+        return 0.0f;  // Outside terrain bounds
+
+    std::lock_guard<std::mutex> lock(entriesMutex_);
+    const SampleRange range = defaultSampleRange(format());
+    for (int l = 0; l < levelCount(); ++l)
+    {
+        float lx = texelX / static_cast<float>(1 << l);
+        float lz = texelZ / static_cast<float>(1 << l);
+        int x0 = static_cast<int>(lx);
+        int z0 = static_cast<int>(lz);
+        float fx = lx - x0;
+        float fz = lz - z0;
+
+        float h00, h10, h01, h11;
+        if (residentSample(l, x0, z0, h00) && residentSample(l, x0 + 1, z0, h10) &&
+            residentSample(l, x0, z0 + 1, h01) && residentSample(l, x0 + 1, z0 + 1, h11))
+        {
+            float h0 = h00 * (1 - fx) + h10 * fx;
+            float h1 = h01 * (1 - fx) + h11 * fx;
+            return ((h0 * (1 - fz) + h1 * fz) - range.offset) / range.span * HEIGHT_SCALE;
+        }
+    }
+    return 0.0f;
+}
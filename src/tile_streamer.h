@@ -0,0 +1,175 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "heightmap.h"
+#include "spsc_queue.h"
+#include "tiled_heightmap.h"
+
+// ============================================================================
+// TILE STREAMING SETTINGS
+// ============================================================================
+
+// Decoded tiles kept in memory by default (--tile-budget=MB)
+const size_t TILE_STREAM_DEFAULT_BUDGET = size_t(256) << 20;
+
+// Tile requests handed to the I/O thread at once. Small, so requests are
+// re-prioritised every frame instead of queueing up behind stale ones.
+const int TILE_STREAM_MAX_IN_FLIGHT = 32;
+
+// ============================================================================
+// OUT-OF-CORE TILE STREAMER
+// ============================================================================
+
+// Pages tiles of a .hmt pyramid in and out of memory, so maps far larger
+// than RAM can be rendered. Tiles are decoded on a background I/O thread;
+// the render thread only ever touches tiles that are already decoded and
+// never waits on the disk.
+//
+// Per frame, on the render thread:
+//   beginFrame()    collect tiles the I/O thread finished (arrived() lists them)
+//   gather()        read level texels; missing tiles are requested and
+//                   stood in for by the nearest coarser resident level
+//   require()       keep tiles resident / request them without reading
+//   endFrame()      send the most urgent requests (coarse levels first, then
+//                   nearest to the camera) and evict least recently used
+//                   tiles beyond the memory budget
+//
+// Requests and finished tiles cross between the threads through lock-free
+// single-producer queues; a mutex is only used to park the I/O thread while
+// it has nothing to do. heightAt() may also be called from another thread
+// (camera collision runs on the simulation thread): it takes the tile map's
+// lock, which the render thread only holds while beginFrame() adds tiles and
+// endFrame() evicts them, never while gathering. The coarsest level is decoded up front and never
+// evicted, so there is always something to fall back to. Tiles used in the
+// current frame are not evicted either, so the budget is exceeded rather
+// than thrashing if it is smaller than one frame's working set.
+class TileStreamer {
+public:
+    explicit TileStreamer(size_t memoryBudget = TILE_STREAM_DEFAULT_BUDGET);
+    ~TileStreamer();
+
+    TileStreamer(const TileStreamer&) = delete;
+    TileStreamer& operator=(const TileStreamer&) = delete;
+
+    // Opens the pyramid, decodes its coarsest level and starts the I/O
+    // thread. Returns false with error() set otherwise.
+    bool open(const char* path);
+    const std::string& error() const { return error_; }
+
+    int width() const { return tiles_.width(); }
+    int height() const { return tiles_.height(); }
+    int levelCount() const { return tiles_.levelCount(); }
+    int tileSize() const { return tiles_.tileSize(); }
+    HeightmapFormat format() const { return tiles_.format(); }
+
+    // Render thread only
+    struct TileKey
+    {
+        int level;
+        int tx;
+        int tz;
+    };
+    void beginFrame(float cameraTexelX, float cameraTexelZ);
+    const std::vector<TileKey>& arrived() const { return arrived_; }
+
+    // Copies level texels (x0, z0) .. (x0 + columns, z0 + rows), clamped to
+    // the level, to out at the samples' stored width. Levels past the
+    // pyramid are point-sampled from its coarsest level.
+    void gather(int level, int x0, int z0, int columns, int rows, void* out);
+    void require(int level, int x0, int z0, int columns, int rows);
+    void endFrame();
+
+    // Bilinear world-space height from the finest resident level, using the
+    // same -30..30 world mapping as heightmapHeightAt. Any thread; locks the
+    // tile map against beginFrame() and endFrame() itself.
+    float heightAt(float worldX, float worldZ) const;
+
+    size_t memoryBudget() const { return budget_; }
+    size_t residentBytes() const { return residentBytes_; }
+    size_t residentTiles() const { return entries_.size(); }
+    size_t pendingTiles() const { return inFlight_.size() + wanted_.size(); }
+    size_t tilesLoaded() const { return tilesLoaded_; }
+    size_t tilesEvicted() const { return tilesEvicted_; }
+
+private:
+    struct Tile
+    {
+        uint64_t key = 0;
+        int width = 0;
+        int height = 0;
+        bool ok = false;
+        std::vector<unsigned char> samples;
+    };
+
+    struct Entry
+    {
+        std::unique_ptr<Tile> tile;
+        std::list<uint64_t>::iterator lruPosition;
+        uint64_t lastUsedFrame = 0;
+        bool pinned = false;
+    };
+
+    static uint64_t packKey(int level, int tx, int tz);
+    static TileKey unpackKey(uint64_t key);
+
+    std::unique_ptr<Tile> decode(uint64_t key) const;
+    void insert(std::unique_ptr<Tile> tile, bool pinned);
+    const Tile* acquire(int level, int tx, int tz);
+    const Tile* find(int level, int tx, int tz) const;
+    bool residentSample(int level, int x, int z, float& sample) const;
+
+    // Last tile looked up per level, so fallback texels, which mostly share
+    // a coarser tile with their neighbours, skip the hash lookup
+    struct TileLookup
+    {
+        uint64_t key = UINT64_MAX;
+        const Tile* tile = nullptr;
+    };
+
+    template <typename Sample>
+    void gatherTexels(int level, int x0, int z0, int columns, int rows, Sample* out);
+    template <typename Sample>
+    Sample fallbackSample(int level, int x, int z, std::vector<TileLookup>& lookups) const;
+
+    void ioLoop();
+
+    TiledHeightmap tiles_;
+    size_t budget_;
+    std::string error_;
+
+    // Render thread state. entries_ is only changed under entriesMutex_,
+    // so heightAt() can read it from other threads.
+    std::unordered_map<uint64_t, Entry> entries_;
+    mutable std::mutex entriesMutex_;
+    std::list<uint64_t> lru_;                   // Unpinned tiles, most recent first
+    std::unordered_set<uint64_t> inFlight_;     // Sent to the I/O thread
+    std::unordered_set<uint64_t> wanted_;       // Missing this frame, not yet sent
+    std::unordered_set<uint64_t> failed_;       // Corrupt tiles, never retried
+    std::vector<TileKey> arrived_;
+    std::vector<TileLookup> lookups_;
+    uint64_t frame_ = 0;
+    float cameraTexelX_ = 0.0f;
+    float cameraTexelZ_ = 0.0f;
+    size_t residentBytes_ = 0;
+    size_t tilesLoaded_ = 0;
+    size_t tilesEvicted_ = 0;
+
+    // Between the threads
+    SpscQueue<uint64_t, 64> requests_;
+    SpscQueue<std::unique_ptr<Tile>, 64> completed_;
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    bool signalled_ = false;
+    bool stopping_ = false;
+    std::thread ioThread_;
+};
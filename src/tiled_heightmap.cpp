@@ -0,0 +1,563 @@
+#include "tiled_heightmap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace {
+
+const char TILED_MAGIC[4] = { 'H', 'M', 'T', 'L' };
+const uint32_t TILED_VERSION = 2;       // 1: single level, no levelCount field
+const int TILED_MAX_LEVELS = 24;
+const int RICE_BLOCK = 16;      // Residuals sharing one Rice parameter
+const int RICE_ESCAPE = 20;     // Unary length that announces a raw residual
+
+struct TiledHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t levelCount;        // Version 2 on
+    uint32_t reserved;
+};
+
+const size_t TILED_HEADER_V1_BYTES = 24;
+
+bool hostIsLittleEndian()
+{
+    const uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+inline int countTrailingZeros(uint64_t value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+template <typename Sample>
+struct TileCodec
+{
+    static constexpr int sampleBits = static_cast<int>(sizeof(Sample) * 8);
+    static constexpr uint32_t sampleMask = (1u << sampleBits) - 1;
+    static constexpr int parameterBits = sampleBits == 8 ? 4 : 5;  // Rice k in 0..sampleBits
+};
+
+inline int predictSample(int left, int up, int upLeft)
+{
+    // Median edge detector: picks the neighbour across an edge, otherwise
+    // the planar estimate
+    int low = std::min(left, up), high = std::max(left, up);
+    if (upLeft >= high)
+        return low;
+    if (upLeft <= low)
+        return high;
+    return left + up - upLeft;
+}
+
+// Residual wrapped to the sample width, then folded so small magnitudes of
+// either sign get small codes: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+template <typename Sample>
+inline uint32_t foldResidual(int sample, int prediction)
+{
+    const int shift = 32 - TileCodec<Sample>::sampleBits;
+    int32_t wrapped = static_cast<int32_t>(static_cast<uint32_t>(sample - prediction) << shift) >> shift;
+    return (static_cast<uint32_t>(wrapped) << 1) ^ static_cast<uint32_t>(wrapped >> 31);
+}
+
+inline int32_t unfoldResidual(uint32_t folded)
+{
+    return static_cast<int32_t>(folded >> 1) ^ -static_cast<int32_t>(folded & 1);
+}
+
+// ----------------------------------------------------------------------------
+// Bit I/O, least significant bit first
+// ----------------------------------------------------------------------------
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& bytes) : bytes_(bytes) {}
+
+    // value must fit in count (<= 32) bits
+    void write(uint32_t value, int count)
+    {
+        bits_ |= static_cast<uint64_t>(value) << count_;
+        count_ += count;
+        while (count_ >= 8)
+        {
+            bytes_.push_back(static_cast<uint8_t>(bits_));
+            bits_ >>= 8;
+            count_ -= 8;
+        }
+    }
+
+    void flush()
+    {
+        if (count_ > 0)
+            bytes_.push_back(static_cast<uint8_t>(bits_));
+        bits_ = 0;
+        count_ = 0;
+    }
+
+private:
+    std::vector<uint8_t>& bytes_;
+    uint64_t bits_ = 0;
+    int count_ = 0;
+};
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    // Tops the buffer up to at least 56 bits. Past the end of the data it
+    // shifts in zeros; overran() reports whether any of them were used.
+    void refill()
+    {
+        if (position_ + 8 <= size_)
+        {
+            uint64_t word;
+            std::memcpy(&word, data_ + position_, sizeof(word));
+            bits_ |= word << count_;
+            position_ += (63 - count_) >> 3;
+            count_ |= 56;
+            return;
+        }
+        while (count_ <= 56)
+        {
+            uint64_t byte = position_ < size_ ? data_[position_] : 0;
+            bits_ |= byte << count_;
+            ++position_;
+            count_ += 8;
+        }
+    }
+
+    uint32_t take(int count)
+    {
+        uint32_t value = static_cast<uint32_t>(bits_ & ((uint64_t(1) << count) - 1));
+        bits_ >>= count;
+        count_ -= count;
+        return value;
+    }
+
+    // Zeros up to the next one bit, capped at RICE_ESCAPE
+    int takeUnary()
+    {
+        int zeros = countTrailingZeros(bits_ | (uint64_t(1) << RICE_ESCAPE));
+        bits_ >>= zeros + 1;
+        count_ -= zeros + 1;
+        return zeros;
+    }
+
+    bool overran() const { return position_ * 8 - count_ > size_ * 8; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_ = 0;
+    uint64_t bits_ = 0;
+    int count_ = 0;
+};
+
+// ----------------------------------------------------------------------------
+// Tile codec
+// ----------------------------------------------------------------------------
+
+template <typename Sample>
+void encodeTile(const Sample* samples, size_t rowSamples, int width, int height,
+                std::vector<uint8_t>& out)
+{
+    using Codec = TileCodec<Sample>;
+
+    std::vector<uint32_t> residuals(static_cast<size_t>(width) * height);
+    for (int z = 0; z < height; ++z)
+    {
+        const Sample* row = samples + z * rowSamples;
+        const Sample* up = row - rowSamples;
+        uint32_t* folded = residuals.data() + static_cast<size_t>(z) * width;
+        folded[0] = foldResidual<Sample>(row[0], z > 0 ? up[0] : 0);
+        for (int x = 1; x < width; ++x)
+        {
+            int prediction = z > 0 ? predictSample(row[x - 1], up[x], up[x - 1]) : row[x - 1];
+            folded[x] = foldResidual<Sample>(row[x], prediction);
+        }
+    }
+
+    BitWriter writer(out);
+    for (size_t start = 0; start < residuals.size(); start += RICE_BLOCK)
+    {
+        size_t end = std::min(residuals.size(), start + RICE_BLOCK);
+
+        // Exact cost of each parameter for this block
+        int bestK = 0;
+        size_t bestBits = SIZE_MAX;
+        for (int k = 0; k <= Codec::sampleBits; ++k)
+        {
+            size_t bits = 0;
+            for (size_t r = start; r < end; ++r)
+            {
+                uint32_t quotient = residuals[r] >> k;
+                bits += quotient < RICE_ESCAPE ? quotient + 1 + k : RICE_ESCAPE + 1 + Codec::sampleBits;
+            }
+            if (bits < bestBits)
+            {
+                bestBits = bits;
+                bestK = k;
+            }
+        }
+
+        writer.write(static_cast<uint32_t>(bestK), Codec::parameterBits);
+        for (size_t r = start; r < end; ++r)
+        {
+            uint32_t quotient = residuals[r] >> bestK;
+            if (quotient < RICE_ESCAPE)
+            {
+                writer.write(1u << quotient, static_cast<int>(quotient) + 1);
+                writer.write(residuals[r] & ((1u << bestK) - 1), bestK);
+            }
+            else
+            {
+                writer.write(1u << RICE_ESCAPE, RICE_ESCAPE + 1);
+                writer.write(residuals[r], Codec::sampleBits);
+            }
+        }
+    }
+    writer.flush();
+}
+
+template <typename Sample>
+bool decodeTileData(const uint8_t* data, size_t size, int width, int height,
+                    Sample* out, size_t rowSamples)
+{
+    using Codec = TileCodec<Sample>;
+
+    BitReader reader(data, size);
+    int k = 0;
+    int blockLeft = 0;
+    auto nextResidual = [&]() -> int32_t {
+        reader.refill();
+        if (blockLeft == 0)
+        {
+            k = std::min<int>(reader.take(Codec::parameterBits), Codec::sampleBits);
+            blockLeft = RICE_BLOCK;
+        }
+        --blockLeft;
+        uint32_t quotient = static_cast<uint32_t>(reader.takeUnary());
+        uint32_t folded = quotient < RICE_ESCAPE ? (quotient << k) | reader.take(k)
+                                                 : reader.take(Codec::sampleBits);
+        return unfoldResidual(folded);
+    };
+
+    for (int z = 0; z < height; ++z)
+    {
+        Sample* row = out + z * rowSamples;
+        const Sample* up = row - rowSamples;
+        row[0] = static_cast<Sample>((static_cast<uint32_t>(z > 0 ? up[0] : 0) + nextResidual()) &
+                                     Codec::sampleMask);
+        if (z == 0)
+        {
+            for (int x = 1; x < width; ++x)
+                row[x] = static_cast<Sample>((static_cast<uint32_t>(row[x - 1]) + nextResidual()) &
+                                             Codec::sampleMask);
+            continue;
+        }
+        for (int x = 1; x < width; ++x)
+        {
+            int prediction = predictSample(row[x - 1], up[x], up[x - 1]);
+            row[x] = static_cast<Sample>((static_cast<uint32_t>(prediction) + nextResidual()) &
+                                         Codec::sampleMask);
+        }
+    }
+    return !reader.overran();
+}
+
+// Next pyramid level: sample i is the rounded mean of samples 2i - 1 and 2i
+// of the level below, on both axes and clipped to it, the blocks the box
+// downsampler uses for a step of 2. Level sizes follow tiledLevelSize.
+template <typename Sample>
+void halveLevel(const Sample* level, int width, int height, Sample* out, ThreadPool& pool)
+{
+    const int outWidth = tiledLevelSize(width, 1);
+    const int outHeight = tiledLevelSize(height, 1);
+    pool.parallelFor(outHeight, [&](int z) {
+        const int z0 = std::max(0, 2 * z - 1);
+        const int z1 = std::min(height - 1, 2 * z);
+        Sample* row = out + static_cast<size_t>(z) * outWidth;
+        for (int x = 0; x < outWidth; ++x)
+        {
+            const int x0 = std::max(0, 2 * x - 1);
+            const int x1 = std::min(width - 1, 2 * x);
+            uint32_t sum = 0;
+            for (int zz = z0; zz <= z1; ++zz)
+                for (int xx = x0; xx <= x1; ++xx)
+                    sum += level[static_cast<size_t>(zz) * width + xx];
+            const uint32_t count = static_cast<uint32_t>((x1 - x0 + 1) * (z1 - z0 + 1));
+            row[x] = static_cast<Sample>((sum + count / 2) / count);
+        }
+    });
+}
+
+} // namespace
+
+bool TiledHeightmap::open(const char* path)
+{
+    *this = TiledHeightmap();
+    if (!hostIsLittleEndian())
+    {
+        error_ = "tiled heightmaps are little-endian and cannot be read on this host";
+        return false;
+    }
+
+    MappedFile file;
+    TiledHeader header = {};
+    if (!file.open(path) || file.size() < TILED_HEADER_V1_BYTES)
+    {
+        error_ = "cannot map file";
+        return false;
+    }
+    std::memcpy(&header, file.data(), TILED_HEADER_V1_BYTES);
+    if (std::memcmp(header.magic, TILED_MAGIC, sizeof(TILED_MAGIC)) != 0 ||
+        header.version < 1 || header.version > TILED_VERSION)
+    {
+        error_ = "not a tiled heightmap, or from a newer version";
+        return false;
+    }
+    size_t headerBytes = TILED_HEADER_V1_BYTES;
+    header.levelCount = 1;
+    if (header.version >= 2)
+    {
+        if (file.size() < sizeof(header))
+        {
+            error_ = "truncated header";
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        headerBytes = sizeof(header);
+    }
+    if (header.format > 1 || header.width < 1 || header.height < 1 || header.tileSize < 1 ||
+        header.width > 1u << 30 || header.height > 1u << 30 || header.tileSize > 1u << 16 ||
+        header.levelCount < 1 || header.levelCount > TILED_MAX_LEVELS)
+    {
+        error_ = "bad tiled heightmap header";
+        return false;
+    }
+
+    const int tileSize = static_cast<int>(header.tileSize);
+    std::vector<Level> levels(header.levelCount);
+    size_t tileCount = 0;
+    for (size_t l = 0; l < levels.size(); ++l)
+    {
+        Level& level = levels[l];
+        level.width = tiledLevelSize(static_cast<int>(header.width), static_cast<int>(l));
+        level.height = tiledLevelSize(static_cast<int>(header.height), static_cast<int>(l));
+        level.tilesX = (level.width + tileSize - 1) / tileSize;
+        level.tilesZ = (level.height + tileSize - 1) / tileSize;
+        level.firstTile = tileCount;
+        tileCount += static_cast<size_t>(level.tilesX) * level.tilesZ;
+    }
+
+    const size_t indexCount = tileCount + 1;
+    const size_t dataStart = headerBytes + indexCount * sizeof(uint64_t);
+    if (dataStart > file.size())
+    {
+        error_ = "truncated tile index";
+        return false;
+    }
+
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(
+        static_cast<const unsigned char*>(file.data()) + headerBytes);
+    if (offsets[0] != dataStart || offsets[indexCount - 1] > file.size())
+    {
+        error_ = "tile index does not match the file";
+        return false;
+    }
+    for (size_t t = 1; t < indexCount; ++t)
+    {
+        if (offsets[t] < offsets[t - 1])
+        {
+            error_ = "tile index is not in order";
+            return false;
+        }
+    }
+
+    file_ = std::move(file);
+    offsets_ = offsets;
+    levels_ = std::move(levels);
+    tileSize_ = tileSize;
+    format_ = header.format == 1 ? HeightmapFormat::U16 : HeightmapFormat::U8;
+    return true;
+}
+
+bool TiledHeightmap::decodeTile(int level, int tx, int tz, void* out, size_t rowSamples) const
+{
+    if (level < 0 || level >= levelCount())
+        return false;
+    const Level& info = levels_[level];
+    if (tx < 0 || tz < 0 || tx >= info.tilesX || tz >= info.tilesZ)
+        return false;
+
+    const size_t tile = info.firstTile + static_cast<size_t>(tz) * info.tilesX + tx;
+    const uint8_t* data = static_cast<const uint8_t*>(file_.data()) + offsets_[tile];
+    const size_t size = offsets_[tile + 1] - offsets_[tile];
+    const int width = std::min(tileSize_, info.width - tx * tileSize_);
+    const int height = std::min(tileSize_, info.height - tz * tileSize_);
+
+    if (format_ == HeightmapFormat::U16)
+        return decodeTileData(data, size, width, height, static_cast<uint16_t*>(out), rowSamples);
+    return decodeTileData(data, size, width, height, static_cast<uint8_t*>(out), rowSamples);
+}
+
+bool TiledHeightmap::decodeTileRow(int tz, void* out, ThreadPool& pool) const
+{
+    const size_t sampleBytes = heightmapSampleBytes(format_);
+    std::atomic<bool> ok{ true };
+    pool.parallelFor(tilesX(), [&](int tx) {
+        void* tileOut = static_cast<unsigned char*>(out) +
+                        static_cast<size_t>(tx) * tileSize_ * sampleBytes;
+        if (!decodeTile(0, tx, tz, tileOut, static_cast<size_t>(width())))
+            ok = false;
+    });
+    return ok;
+}
+
+bool TiledHeightmap::decode(void* out, ThreadPool& pool) const
+{
+    const size_t sampleBytes = heightmapSampleBytes(format_);
+    std::atomic<bool> ok{ true };
+    pool.parallelFor(tilesX() * tilesZ(), [&](int tile) {
+        int tx = tile % tilesX(), tz = tile / tilesX();
+        size_t first = (static_cast<size_t>(tz) * tileSize_ * width() +
+                        static_cast<size_t>(tx) * tileSize_) * sampleBytes;
+        if (!decodeTile(0, tx, tz, static_cast<unsigned char*>(out) + first, static_cast<size_t>(width())))
+            ok = false;
+    });
+    return ok;
+}
+
+bool writeTiledHeightmap(const char* path, const HeightmapView& heightmap, int tileSize,
+                         ThreadPool& pool, std::string& error)
+{
+    if (heightmap.format == HeightmapFormat::F32)
+    {
+        error = "tiled heightmaps hold 8- or 16-bit samples";
+        return false;
+    }
+    if (!hostIsLittleEndian())
+    {
+        error = "tiled heightmaps are little-endian and cannot be written on this host";
+        return false;
+    }
+    tileSize = std::max(1, tileSize);
+
+    // Levels until a single tile covers the map
+    int levelCount = 1;
+    while (levelCount < TILED_MAX_LEVELS &&
+           (tiledLevelSize(heightmap.width, levelCount - 1) > tileSize ||
+            tiledLevelSize(heightmap.height, levelCount - 1) > tileSize))
+        ++levelCount;
+
+    size_t tileCount = 0;
+    for (int l = 0; l < levelCount; ++l)
+    {
+        size_t tilesX = (tiledLevelSize(heightmap.width, l) + tileSize - 1) / tileSize;
+        size_t tilesZ = (tiledLevelSize(heightmap.height, l) + tileSize - 1) / tileSize;
+        tileCount += tilesX * tilesZ;
+    }
+
+    TiledHeader header = {};
+    std::memcpy(header.magic, TILED_MAGIC, sizeof(TILED_MAGIC));
+    header.version = TILED_VERSION;
+    header.format = heightmap.format == HeightmapFormat::U16 ? 1 : 0;
+    header.width = static_cast<uint32_t>(heightmap.width);
+    header.height = static_cast<uint32_t>(heightmap.height);
+    header.tileSize = static_cast<uint32_t>(tileSize);
+    header.levelCount = static_cast<uint32_t>(levelCount);
+
+    // The index is written last, once every tile's size is known
+    std::vector<uint64_t> offsets(tileCount + 1);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(offsets.data()),
+              static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+    offsets[0] = sizeof(header) + offsets.size() * sizeof(uint64_t);
+
+    // Level 0 is read from the heightmap; each coarser level is averaged
+    // from the one before it and held only until the next is built
+    const size_t sampleBytes = heightmapSampleBytes(heightmap.format);
+    std::vector<unsigned char> levelSamples, nextSamples;
+    const unsigned char* levelData = static_cast<const unsigned char*>(heightmap.data);
+    size_t tile = 0;
+    for (int l = 0; l < levelCount && out; ++l)
+    {
+        const int levelWidth = tiledLevelSize(heightmap.width, l);
+        const int levelHeight = tiledLevelSize(heightmap.height, l);
+        const int tilesX = (levelWidth + tileSize - 1) / tileSize;
+        const int tilesZ = (levelHeight + tileSize - 1) / tileSize;
+        if (l > 0)
+        {
+            const int belowWidth = tiledLevelSize(heightmap.width, l - 1);
+            const int belowHeight = tiledLevelSize(heightmap.height, l - 1);
+            nextSamples.resize(static_cast<size_t>(levelWidth) * levelHeight * sampleBytes);
+            if (heightmap.format == HeightmapFormat::U16)
+                halveLevel(reinterpret_cast<const uint16_t*>(levelData), belowWidth, belowHeight,
+                           reinterpret_cast<uint16_t*>(nextSamples.data()), pool);
+            else
+                halveLevel(levelData, belowWidth, belowHeight, nextSamples.data(), pool);
+            levelSamples.swap(nextSamples);
+            levelData = levelSamples.data();
+        }
+
+        std::vector<std::vector<uint8_t>> row(tilesX);
+        for (int tz = 0; tz < tilesZ && out; ++tz)
+        {
+            pool.parallelFor(tilesX, [&](int tx) {
+                int tileWidth = std::min(tileSize, levelWidth - tx * tileSize);
+                int tileHeight = std::min(tileSize, levelHeight - tz * tileSize);
+                const unsigned char* first = levelData +
+                    (static_cast<size_t>(tz) * tileSize * levelWidth +
+                     static_cast<size_t>(tx) * tileSize) * sampleBytes;
+                row[tx].clear();
+                if (heightmap.format == HeightmapFormat::U16)
+                    encodeTile(reinterpret_cast<const uint16_t*>(first), static_cast<size_t>(levelWidth),
+                               tileWidth, tileHeight, row[tx]);
+                else
+                    encodeTile(first, static_cast<size_t>(levelWidth), tileWidth, tileHeight, row[tx]);
+            });
+
+            for (const std::vector<uint8_t>& encoded : row)
+            {
+                out.write(reinterpret_cast<const char*>(encoded.data()),
+                          static_cast<std::streamsize>(encoded.size()));
+                offsets[tile + 1] = offsets[tile] + encoded.size();
+                ++tile;
+            }
+        }
+    }
+
+    out.seekp(sizeof(header));
+    out.write(reinterpret_cast<const char*>(offsets.data()),
+              static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+    if (!out)
+    {
+        error = std::string("cannot write ") + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "heightmap.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+// ============================================================================
+// TILED HEIGHTMAPS
+// ============================================================================
+
+// Default edge length of a tile in samples
+const int TILED_HEIGHTMAP_TILE_SIZE = 256;
+
+// A .hmt file: 8- or 16-bit samples cut into square tiles, each compressed on
+// its own, behind a tile index. Unlike a PNG, whose single deflate stream
+// has to be inflated front to back, tiles decode in parallel or one at a time
+// for random access.
+//
+// The file holds a pyramid of levels, a quadtree of tiles. Level l keeps
+// every 2^l-th sample of the map (the last row and column always end on the
+// map's edge), exactly what the clipmap's level l samples, and the levels go
+// on until one tile covers the whole map.
+//
+// Layout (little-endian):
+//   header      magic "HMTL", version, format (0 = 8-bit, 1 = 16-bit),
+//               width, height, tile size, level count
+//   index       one byte offset per tile plus an end offset; tile t is
+//               [off[t], off[t+1]). Levels follow each other, finest first,
+//               tiles row-major within a level.
+//   tiles
+//
+// Within a tile every sample is predicted from its left, upper and
+// upper-left neighbours (the LOCO-I median predictor; left only on the first
+// row, upper only in the first column), and the residuals are Rice coded in
+// blocks of 16, each block with its own parameter. Rice codes are cheap to
+// decode and close to optimal for the small, two-sided residuals of smooth
+// terrain.
+class TiledHeightmap {
+public:
+    // Maps the file and checks the header and tile index. Returns false with
+    // error() set otherwise.
+    bool open(const char* path);
+
+    // Full-resolution map (level 0)
+    int width() const { return levelWidth(0); }
+    int height() const { return levelHeight(0); }
+    int tilesX() const { return levelTilesX(0); }
+    int tilesZ() const { return levelTilesZ(0); }
+
+    int levelCount() const { return static_cast<int>(levels_.size()); }
+    int levelWidth(int level) const { return levels_[level].width; }
+    int levelHeight(int level) const { return levels_[level].height; }
+    int levelTilesX(int level) const { return levels_[level].tilesX; }
+    int levelTilesZ(int level) const { return levels_[level].tilesZ; }
+
+    int tileSize() const { return tileSize_; }
+    HeightmapFormat format() const { return format_; }
+    size_t fileBytes() const { return file_.size(); }
+
+    // Decodes tile (tx, tz) of a level to out, whose rows are rowSamples
+    // samples apart. Safe to call from several threads at once. Returns
+    // false if the tile data is corrupt.
+    bool decodeTile(int level, int tx, int tz, void* out, size_t rowSamples) const;
+
+    // Decodes the level 0 tile row tz (tileSize rows, fewer at the bottom
+    // edge) to a width-sample wide band, one tile per work item
+    bool decodeTileRow(int tz, void* out, ThreadPool& pool) const;
+
+    // Decodes level 0 to width x height samples, one tile per work item
+    bool decode(void* out, ThreadPool& pool) const;
+
+    const std::string& error() const { return error_; }
+
+private:
+    struct Level
+    {
+        int width;
+        int height;
+        int tilesX;
+        int tilesZ;
+        size_t firstTile;   // Index entry of tile (0, 0)
+    };
+
+    MappedFile file_;
+    const uint64_t* offsets_ = nullptr;
+    std::vector<Level> levels_;
+    int tileSize_ = 0;
+    HeightmapFormat format_ = HeightmapFormat::U8;
+    std::string error_;
+};
+
+// Samples per side of pyramid level l for a map of size samples per side
+inline int tiledLevelSize(int size, int level)
+{
+    return (size - 1 + (1 << level) - 1) / (1 << level) + 1;
+}
+
+// Compresses a U8 or U16 heightmap and its pyramid into a .hmt file, one row
+// of tiles at a time with one tile per work item, so only a row of
+// compressed tiles is held in memory besides the pyramid. The heightmap may
+// be memory-mapped. Each pyramid level is a 2x2 box average of the one
+// below, held in memory while it and the next are built: a third of the
+// map's size at most.
+// Sample ranges other than the format's default are not stored, so F32 maps
+// are rejected.
+bool writeTiledHeightmap(const char* path, const HeightmapView& heightmap, int tileSize,
+                         ThreadPool& pool, std::string& error);